@@ -0,0 +1,108 @@
+// BLE Advertisement Scanner app
+//
+// Scans continuously and prints the manufacturer data advertised by a set of
+// peers. The scanner library filters reports by address with a hash table,
+// so the set can grow to hundreds of robots, and holds back payloads that
+// haven't changed.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "app_util.h"
+#include "nrf.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+#include "ble_scanner.h"
+#include "rtc_time.h"
+#include "simple_ble.h"
+
+// Print scanner statistics every 10 s
+#define STATS_PERIOD_US 10000000
+
+// BLE configuration
+// This is mostly irrelevant since we are scanning only
+static simple_ble_config_t ble_config = {
+        // BLE address is c0:98:e5:49:00:00
+        .platform_id       = 0x49,    // used as 4th octet in device BLE address
+        .device_id         = 0x0000,  // Last two octets of device address
+        .adv_name          = "EE149", // irrelevant in this example
+        .adv_interval      = MSEC_TO_UNITS(1000, UNIT_0_625_MS), // irrelevant if scanning only
+        .min_conn_interval = MSEC_TO_UNITS(500, UNIT_1_25_MS), // irrelevant if scanning only
+        .max_conn_interval = MSEC_TO_UNITS(1000, UNIT_1_25_MS), // irrelevant if scanning only
+};
+simple_ble_app_t* simple_ble_app;
+
+// hand SoftDevice events to the BLE libraries this app uses
+BLE_SCANNER_DEF(scanner);
+
+static void on_report(const ble_scanner_report_t* report) {
+  // addresses are stored least significant byte first
+  printf("%02X:%02X:%02X:%02X:%02X:%02X %d dBm:",
+      report->addr[5], report->addr[4], report->addr[3],
+      report->addr[2], report->addr[1], report->addr[0], report->rssi);
+
+  // skip the two byte company ID and print the rest as text
+  for (uint8_t i = 2; i < report->len; i++) {
+    char c = (char)report->data[i];
+    printf("%c", (c >= ' ' && c <= '~') ? c : '.');
+  }
+  printf("\n");
+}
+
+int main(void) {
+  ret_code_t error_code = NRF_SUCCESS;
+
+  // initialize RTT library
+  error_code = NRF_LOG_INIT(NULL);
+  APP_ERROR_CHECK(error_code);
+  NRF_LOG_DEFAULT_BACKENDS_INIT();
+  printf("Log initialized\n");
+
+  // Setup BLE, scanning only
+  simple_ble_app = simple_ble_init(&ble_config);
+  advertising_stop();
+
+  // Listen all the time, and print unchanged payloads again every 5 s
+  ble_scanner_config_t scanner_config = {
+    .interval = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+    .window = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+    .active = false,
+    .repeat_ms = 5000,
+    .handler = on_report,
+  };
+  error_code = ble_scanner_init(&scanner_config);
+  APP_ERROR_CHECK(error_code);
+
+  // The robot from the listening exercise, C0:98:E5:49:FF:FD
+  const uint8_t robot[BLE_SCANNER_ADDR_LEN] = {0xFD, 0xFF, 0x49, 0xE5, 0x98, 0xC0};
+  error_code = ble_scanner_add(robot);
+  APP_ERROR_CHECK(error_code);
+
+  // and a class worth of Buckler addresses, c0:98:e5:49:00:00 to 00:ff
+  for (uint16_t id = 0; id < 0x100 && ble_scanner_count() < 150; id++) {
+    const uint8_t buckler[BLE_SCANNER_ADDR_LEN] = {id & 0xFF, 0x00, 0x49, 0xE5, 0x98, 0xC0};
+    error_code = ble_scanner_add(buckler);
+    APP_ERROR_CHECK(error_code);
+  }
+  printf("Listening for %u peers\n", ble_scanner_count());
+
+  error_code = ble_scanner_start();
+  APP_ERROR_CHECK(error_code);
+
+  uint64_t next_stats_us = rtc_time_us() + STATS_PERIOD_US;
+  while (1) {
+    // Sleep while SoftDevice handles BLE
+    power_manage();
+
+    if (rtc_time_us() >= next_stats_us) {
+      next_stats_us += STATS_PERIOD_US;
+      const ble_scanner_stats_t* stats = ble_scanner_stats();
+      printf("reports %lu, filtered %lu, duplicates %lu, delivered %lu, malformed %lu\n",
+          stats->reports, stats->filtered, stats->duplicates, stats->delivered, stats->malformed);
+    }
+  }
+}
@@ -25,6 +25,7 @@
 #include "kobukiSensorTypes.h"
 #include "kobukiUtilities.h"
 #include "lsm9ds1.h"
+#include "ble_adv_data.h"
 #include "simple_ble.h"
 
 #include "states.h"
@@ -35,13 +36,16 @@ NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
 // global variables
 KobukiSensors_t sensors = {0};
 
+// Advertisements go out every 100 ms, so new data is only useful that often
+#define ADV_INTERVAL_MS 100
+
 // Intervals for advertising and connections
 static simple_ble_config_t ble_config = {
         // c0:98:e5:49:xx:xx
         .platform_id       = 0x49,    // used as 4th octect in device BLE address
         .device_id         = 0x0000, // TODO: replace with your lab bench number
         .adv_name          = "KOBUKI", // used in advertisements if there is room
-        .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+        .adv_interval      = MSEC_TO_UNITS(ADV_INTERVAL_MS, UNIT_0_625_MS),
         .min_conn_interval = MSEC_TO_UNITS(100, UNIT_1_25_MS),
         .max_conn_interval = MSEC_TO_UNITS(200, UNIT_1_25_MS),
 };
@@ -74,6 +78,11 @@ int main(void) {
   // Start Advertising
   simple_ble_adv_only_name();
 
+  // Data posted from the loop replaces the advertising data at most once per
+  // advertisement
+  error_code = ble_adv_data_init(ADV_INTERVAL_MS, true);
+  APP_ERROR_CHECK(error_code);
+
   // initialize LEDs
   nrf_gpio_pin_dir_set(23, NRF_GPIO_PIN_DIR_OUTPUT);
   nrf_gpio_pin_dir_set(24, NRF_GPIO_PIN_DIR_OUTPUT);
@@ -118,6 +127,9 @@ int main(void) {
     // read sensors from robot
     kobukiSensorPoll(&sensors);
 
+    // send out a change that was posted too soon after the last one
+    ble_adv_data_process();
+
     // TODO: complete state machine
     switch(state) {
       case OFF: {
@@ -146,7 +158,7 @@ int main(void) {
           // perform state-specific actions here
           uint16_t encoder = sensors.leftWheelEncoder;
           float angle = lsm9ds1_read_gyro_integration().z_axis;
-          simple_ble_adv_manuf_data((uint8_t*) &angle, sizeof(angle));
+          ble_adv_data_post((uint8_t*) &angle, sizeof(angle));
           kobukiDriveDirect(0, 100);
         }
         break; // each case needs to end with break!
@@ -0,0 +1,291 @@
+// BLE Robot Telemetry app
+//
+// Streams the Kobuki's state over BLE while it drives. Every control step
+// records a telemetry sample with odometry, encoders, bumpers, IMU readings
+// and the step time, and the telemetry service sends them in batches. Run
+// telemetry_reader.py to receive them.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_gpio.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+#include "nrf_drv_spi.h"
+
+#include "buckler.h"
+#include "control_loop.h"
+#include "display.h"
+#include "kobukiActuator.h"
+#include "kobukiSensorPoll.h"
+#include "kobukiSensorTypes.h"
+#include "kobukiUtilities.h"
+#include "lsm9ds1.h"
+#include "rtc_time.h"
+#include "ble_throughput.h"
+#include "simple_ble.h"
+#include "telemetry.h"
+#include "telemetry_ble.h"
+
+// I2C manager
+NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
+
+typedef enum {
+  OFF,
+  DRIVING,
+  BACKING_UP,
+} robot_state_t;
+
+#define SPEED 100
+
+// Run at the 50 Hz rate the Kobuki sends sensor packets, sending every step
+#define CONTROL_PERIOD_US 20000
+#define DECIMATION 1
+
+// Print loop and telemetry statistics every 10 s
+#define STATS_PERIOD_STEPS 500
+
+// Kobuki geometry
+#define METERS_PER_TICK 0.00008529f
+#define WHEEL_BASE 0.230f
+
+#define BACKUP_DISTANCE 0.1f
+
+// Intervals for advertising and connections
+static simple_ble_config_t ble_config = {
+        // c0:98:e5:49:xx:xx
+        .platform_id       = 0x49,    // used as 4th octect in device BLE address
+        .device_id         = 0x0000, // TODO: replace with your lab bench number
+        .adv_name          = "KOBUKI", // used in advertisements if there is room
+        .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+        .min_conn_interval = MSEC_TO_UNITS(15, UNIT_1_25_MS),
+        .max_conn_interval = MSEC_TO_UNITS(30, UNIT_1_25_MS),
+};
+
+simple_ble_app_t* simple_ble_app;
+
+// hand SoftDevice events to the BLE libraries this app uses
+BLE_THROUGHPUT_DEF(link);
+TELEMETRY_BLE_DEF(telemetry);
+
+static robot_state_t state = OFF;
+static KobukiSensors_t sensors = {0};
+
+// odometry, in meters and radians from where the robot started
+static float x;
+static float y;
+static float heading;
+static float distance; // travelled along the path, either way
+static uint16_t previous_left;
+static uint16_t previous_right;
+
+static float backup_start;
+static uint32_t step_start;
+static uint32_t step_us;
+
+static void show(const char* text, uint8_t row) {
+  if (!control_loop_degraded()) {
+    display_write(text, row);
+  }
+}
+
+// Integrate wheel travel since the last step into the pose
+static void update_odometry(void) {
+  // signed differences of the wrapping counts
+  float left = (int16_t)(sensors.leftWheelEncoder - previous_left) * METERS_PER_TICK;
+  float right = (int16_t)(sensors.rightWheelEncoder - previous_right) * METERS_PER_TICK;
+  previous_left = sensors.leftWheelEncoder;
+  previous_right = sensors.rightWheelEncoder;
+
+  float turn = (right - left) / WHEEL_BASE;
+  float forward = (left + right) / 2;
+  x += forward * cosf(heading + turn / 2);
+  y += forward * sinf(heading + turn / 2);
+  distance += fabsf(forward);
+  heading = remainderf(heading + turn, 2 * (float)M_PI);
+}
+
+static int16_t clamp16(float value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)lroundf(value);
+}
+
+static void record_sample(void) {
+  lsm9ds1_measurement_t gyro = lsm9ds1_read_gyro();
+  lsm9ds1_measurement_t accel = lsm9ds1_read_accelerometer();
+  const KobukiBumps_WheelDrops_t* bumps = &sensors.bumps_wheelDrops;
+
+  telemetry_sample_t sample = {
+    .time_ms = (uint32_t)(rtc_time_us() / 1000),
+    .x_mm = clamp16(x * 1000),
+    .y_mm = clamp16(y * 1000),
+    .heading_cdeg = clamp16(heading * 18000 / (float)M_PI),
+    .left_encoder = sensors.leftWheelEncoder,
+    .right_encoder = sensors.rightWheelEncoder,
+    .gyro_z_ddps = clamp16(gyro.z_axis * 10),
+    .accel_mg = {clamp16(accel.x_axis * 1000), clamp16(accel.y_axis * 1000), clamp16(accel.z_axis * 1000)},
+    .loop_us = step_us > UINT16_MAX ? UINT16_MAX : step_us, // previous step, this one is still running
+    .bumps = (bumps->bumpLeft ? TELEMETRY_BUMP_LEFT : 0) |
+             (bumps->bumpCenter ? TELEMETRY_BUMP_CENTER : 0) |
+             (bumps->bumpRight ? TELEMETRY_BUMP_RIGHT : 0) |
+             (bumps->wheeldropLeft ? TELEMETRY_WHEELDROP_LEFT : 0) |
+             (bumps->wheeldropRight ? TELEMETRY_WHEELDROP_RIGHT : 0) |
+             (sensors.cliffLeft || sensors.cliffCenter || sensors.cliffRight ? TELEMETRY_CLIFF : 0),
+    .state = state,
+  };
+  telemetry_record(&sample);
+}
+
+static void print_stats(void) {
+  const telemetry_stats_t* stats = telemetry_stats();
+  control_loop_print_stats();
+  printf("telemetry: %lu recorded, %lu dropped, %lu notifications\n",
+      stats->recorded, stats->dropped, telemetry_ble_sent());
+}
+
+// one iteration of the state machine
+static void control_step(void) {
+  step_start = control_loop_now();
+
+  uint32_t steps = control_loop_stats()->steps;
+  if (steps > 0 && steps % STATS_PERIOD_STEPS == 0) {
+    print_stats();
+  }
+
+  // read sensors from robot
+  kobukiSensorPoll(&sensors);
+  update_odometry();
+
+  const KobukiBumps_WheelDrops_t* bumps = &sensors.bumps_wheelDrops;
+  bool bumped = bumps->bumpLeft || bumps->bumpCenter || bumps->bumpRight;
+
+  switch(state) {
+    case OFF: {
+      if (is_button_pressed(&sensors)) {
+        state = DRIVING;
+        kobukiDriveDirect(SPEED, SPEED);
+      } else {
+        show("OFF", DISPLAY_LINE_0);
+      }
+      break;
+    }
+
+    case DRIVING: {
+      if (is_button_pressed(&sensors)) {
+        state = OFF;
+        kobukiDriveDirect(0, 0);
+      } else if (bumped) {
+        state = BACKING_UP;
+        backup_start = distance;
+        kobukiDriveDirect(-SPEED, -SPEED);
+      } else {
+        show("DRIVING", DISPLAY_LINE_0);
+      }
+      break;
+    }
+
+    case BACKING_UP: {
+      float moved = distance - backup_start;
+      if (is_button_pressed(&sensors)) {
+        state = OFF;
+        kobukiDriveDirect(0, 0);
+      } else if (moved >= BACKUP_DISTANCE) {
+        // curve away from the obstacle
+        state = DRIVING;
+        kobukiDriveDirect(SPEED, SPEED / 2);
+      } else {
+        show("BACKING_UP", DISPLAY_LINE_0);
+      }
+      break;
+    }
+  }
+
+  record_sample();
+  telemetry_ble_send();
+
+  step_us = control_loop_now() - step_start;
+}
+
+static void degraded_handler(bool degraded) {
+  printf(degraded ? "Control loop over budget, pausing display\n" : "Control loop recovered\n");
+}
+
+int main(void) {
+  ret_code_t error_code = NRF_SUCCESS;
+
+  // initialize RTT library
+  error_code = NRF_LOG_INIT(NULL);
+  APP_ERROR_CHECK(error_code);
+  NRF_LOG_DEFAULT_BACKENDS_INIT();
+  printf("Log initialized!\n");
+
+  // Setup BLE
+  simple_ble_app = simple_ble_init(&ble_config);
+  ble_throughput_init();
+  telemetry_ble_init(DECIMATION);
+
+  // Start Advertising
+  simple_ble_adv_only_name();
+
+  // initialize display
+  nrf_drv_spi_t spi_instance = NRF_DRV_SPI_INSTANCE(1);
+  nrf_drv_spi_config_t spi_config = {
+    .sck_pin = BUCKLER_LCD_SCLK,
+    .mosi_pin = BUCKLER_LCD_MOSI,
+    .miso_pin = BUCKLER_LCD_MISO,
+    .ss_pin = BUCKLER_LCD_CS,
+    .irq_priority = NRFX_SPI_DEFAULT_CONFIG_IRQ_PRIORITY,
+    .orc = 0,
+    .frequency = NRF_DRV_SPI_FREQ_4M,
+    .mode = NRF_DRV_SPI_MODE_2,
+    .bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST
+  };
+  error_code = nrf_drv_spi_init(&spi_instance, &spi_config, display_spi_evt_handler, NULL);
+  APP_ERROR_CHECK(error_code);
+  display_init_async(&spi_instance, NULL, NULL);
+  printf("Display initialized!\n");
+
+  // initialize i2c master (two wire interface)
+  nrf_drv_twi_config_t i2c_config = NRF_DRV_TWI_DEFAULT_CONFIG;
+  i2c_config.scl = BUCKLER_SENSORS_SCL;
+  i2c_config.sda = BUCKLER_SENSORS_SDA;
+  i2c_config.frequency = NRF_TWIM_FREQ_100K;
+  error_code = nrf_twi_mngr_init(&twi_mngr_instance, &i2c_config);
+  APP_ERROR_CHECK(error_code);
+  lsm9ds1_init(&twi_mngr_instance);
+  printf("IMU initialized!\n");
+
+  // timebase for sample times
+  error_code = rtc_time_init();
+  APP_ERROR_CHECK(error_code);
+
+  // initialize Kobuki
+  kobukiInit();
+  printf("Kobuki initialized!\n");
+
+  // start odometry from the current encoder counts
+  kobukiSensorPoll(&sensors);
+  previous_left = sensors.leftWheelEncoder;
+  previous_right = sensors.rightWheelEncoder;
+
+  // run the state machine at a fixed rate forever
+  control_loop_config_t loop_config = {
+    .period_us = CONTROL_PERIOD_US,
+    .budget_us = 0,
+    .step = control_step,
+    .degraded = degraded_handler,
+  };
+  error_code = control_loop_init(&loop_config);
+  APP_ERROR_CHECK(error_code);
+  control_loop_run();
+}
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+
+import struct
+import time
+from bluepy.btle import Peripheral, DefaultDelegate
+import argparse
+
+parser = argparse.ArgumentParser(description='Print telemetry streamed from a Kobuki')
+parser.add_argument('addr', metavar='A', type=str, help='Address of the form XX:XX:XX:XX:XX:XX')
+parser.add_argument('--decimation', type=int, help='Keep one in this many control steps')
+parser.add_argument('--quiet', action='store_true', help='Only print rates')
+parser.add_argument('--record', type=str, help='Save samples to a trace for telemetry_tool')
+args = parser.parse_args()
+addr = args.addr.lower()
+if len(addr) != 17:
+    raise ValueError("Invalid address supplied")
+
+TELEMETRY_SERVICE_UUID    = "5e2a0001-1e49-4f6e-8d7a-6c2b9e7f0c31"
+TELEMETRY_DATA_UUID       = "5e2a0002-1e49-4f6e-8d7a-6c2b9e7f0c31"
+TELEMETRY_DECIMATION_UUID = "5e2a0003-1e49-4f6e-8d7a-6c2b9e7f0c31"
+
+# telemetry_sample_t and telemetry_sample_schema, see libraries/telemetry
+SAMPLE = struct.Struct("<IhhhHHhhhhHBB")
+BITS, VALUE, DELTA, DELTA2 = range(4)
+SCHEMA = (
+    # name, bytes, signed, kind, bits
+    ("time_ms",       4, False, DELTA2, 1),
+    ("x_mm",          2, True,  DELTA2, 2),
+    ("y_mm",          2, True,  DELTA2, 2),
+    ("heading_cdeg",  2, True,  DELTA2, 2),
+    ("left_encoder",  2, False, DELTA2, 2),
+    ("right_encoder", 2, False, DELTA2, 2),
+    ("gyro_z_ddps",   2, True,  DELTA,  4),
+    ("accel_x_mg",    2, True,  DELTA,  5),
+    ("accel_y_mg",    2, True,  DELTA,  5),
+    ("accel_z_mg",    2, True,  DELTA,  5),
+    ("loop_us",       2, False, DELTA,  8),
+    ("bumps",         1, False, DELTA,  0),
+    ("state",         1, False, DELTA,  0),
+)
+HEADER_SIZE = 2
+
+
+def fit(value, size, signed):
+    """Cut a value down to a member's width, as telemetry_codec.c does"""
+    value &= (1 << (8 * size)) - 1
+    if signed and value >= 1 << (8 * size - 1):
+        value -= 1 << (8 * size)
+    return value
+
+
+def fit_change(value, size):
+    """Cut a change down to a member's width, always signed"""
+    return fit(value, size, True)
+
+
+class RecordDecoder():
+    """Decodes telemetry_codec.c records of SCHEMA"""
+
+    def __init__(self):
+        self.sequence = 0
+        self.synced = False
+        self.previous = [0] * len(SCHEMA)
+        self.change = [0] * len(SCHEMA)
+        self.bit_field_size = (sum(max(f[4], 1) for f in SCHEMA) + 7) // 8
+
+    def decode(self, buf):
+        """Returns (sample or None if waiting for a keyframe, bytes used), or
+        None if buf doesn't hold a whole record"""
+        if len(buf) < 1 + self.bit_field_size:
+            return None
+        keyframe = buf[0] & 1
+        sequence = buf[0] >> 1
+        if sequence != self.sequence:
+            self.synced = False
+        decode = keyframe or self.synced
+
+        bit_field = int.from_bytes(buf[1:1 + self.bit_field_size], "little")
+        offset = 1 + self.bit_field_size
+        coded = []
+        for name, size, signed, kind, bits in SCHEMA:
+            width = max(bits, 1)
+            escape = (1 << width) - 1
+            value = bit_field & escape
+            bit_field >>= width
+            if kind != BITS and value == escape:
+                # the varint holds how far past the escape code it is
+                value = shift = 0
+                while True:
+                    if offset >= len(buf):
+                        return None
+                    byte = buf[offset]
+                    offset += 1
+                    value |= (byte & 0x7F) << shift
+                    shift += 7
+                    if not byte & 0x80:
+                        break
+                value += escape
+            if kind != BITS:
+                value = (value >> 1) ^ -(value & 1)
+            coded.append(value)
+        self.sequence = (sequence + 1) & 0x7F
+
+        if not decode:
+            return None, offset
+
+        sample = {}
+        for i, (name, size, signed, kind, bits) in enumerate(SCHEMA):
+            value = coded[i]
+            if kind in (BITS, VALUE):
+                value = fit(value, size, signed)
+            elif keyframe:
+                value = fit(value, size, signed)
+                self.change[i] = 0
+            elif kind == DELTA:
+                value = fit(self.previous[i] + value, size, signed)
+            else:
+                self.change[i] = fit_change(self.change[i] + value, size)
+                value = fit(self.previous[i] + self.change[i], size, signed)
+            self.previous[i] = value
+            sample[name] = value
+        self.synced = True
+        return sample, offset
+
+
+class TelemetryDelegate(DefaultDelegate):
+    def __init__(self, record=None):
+        DefaultDelegate.__init__(self)
+        self.record = record
+        self.decoder = RecordDecoder()
+        self.buffer = b""
+        self.synced = False
+        self.next_sequence = None
+        self.samples = 0
+        self.packets = 0
+        self.lost = 0
+        self.bytes = 0
+
+    def handleNotification(self, handle, data):
+        sequence, first = data[0], data[1]
+        self.packets += 1
+        self.bytes += len(data)
+
+        if self.next_sequence is not None and sequence != self.next_sequence:
+            # a packet went missing, throw away the broken record
+            self.lost += (sequence - self.next_sequence) & 0xFF
+            self.synced = False
+        self.next_sequence = (sequence + 1) & 0xFF
+
+        if not self.synced:
+            if first == 0:
+                return
+            self.buffer = b""
+            self.synced = True
+            data = data[first:]
+        else:
+            data = data[HEADER_SIZE:]
+
+        self.buffer += data
+        while True:
+            result = self.decoder.decode(self.buffer)
+            if result is None:
+                break
+            sample, used = result
+            self.buffer = self.buffer[used:]
+            if sample is None:
+                continue
+            self.samples += 1
+            if self.record:
+                self.record.write(SAMPLE.pack(*sample.values()))
+            if not args.quiet:
+                print(sample)
+
+
+try:
+    print("connecting")
+    buckler = Peripheral(addr)
+    buckler.setMTU(247)
+
+    print("connected")
+
+    # Get service
+    sv = buckler.getServiceByUUID(TELEMETRY_SERVICE_UUID)
+    # Get characteristics
+    data_ch = sv.getCharacteristics(TELEMETRY_DATA_UUID)[0]
+    decimation_ch = sv.getCharacteristics(TELEMETRY_DECIMATION_UUID)[0]
+
+    if args.decimation:
+        decimation_ch.write(struct.pack("<H", args.decimation))
+    print("decimation", struct.unpack("<H", decimation_ch.read())[0])
+
+    delegate = TelemetryDelegate(open(args.record, "wb") if args.record else None)
+    buckler.setDelegate(delegate)
+
+    # Enable notifications through the descriptor after the value
+    buckler.writeCharacteristic(data_ch.getHandle() + 1, b"\x01\x00")
+
+    start = time.time()
+    while True:
+        buckler.waitForNotifications(1.0)
+        elapsed = time.time() - start
+        if elapsed >= 5:
+            print("{:.1f} samples/s, {:.1f} packets/s, {:.0f} bytes/s, {} packets lost".format(
+                delegate.samples / elapsed, delegate.packets / elapsed,
+                delegate.bytes / elapsed, delegate.lost))
+            delegate.samples = delegate.packets = delegate.bytes = 0
+            start = time.time()
+finally:
+    buckler.disconnect()
@@ -0,0 +1,132 @@
+// BLE Teleop app
+//
+// Drives the Kobuki with velocity commands written over BLE. The main loop
+// sleeps until a command arrives and sends it to the Kobuki straight away,
+// and stops the robot if commands stop coming. Run teleop_sender.py to
+// drive it and measure the command latency.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+#include "nrf_drv_spi.h"
+
+#include "buckler.h"
+#include "display.h"
+#include "kobukiActuator.h"
+#include "kobukiUtilities.h"
+#include "simple_ble.h"
+#include "teleop_ble.h"
+#include "virtual_timer.h"
+
+// Stop if no command arrives for this long
+#define TIMEOUT_MS 250
+
+// Wake up to check the timeout this often, even without BLE events
+#define WAKE_PERIOD_US 50000
+
+// Print statistics every 5 s
+#define STATS_PERIOD_US 5000000
+
+// Intervals for advertising and connections. The teleop service asks for
+// 7.5 to 15 ms as soon as a central connects.
+static simple_ble_config_t ble_config = {
+        // c0:98:e5:49:xx:xx
+        .platform_id       = 0x49,    // used as 4th octect in device BLE address
+        .device_id         = 0x0000, // TODO: replace with your lab bench number
+        .adv_name          = "KOBUKI", // used in advertisements if there is room
+        .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+        .min_conn_interval = TELEOP_BLE_MIN_CONN_INTERVAL,
+        .max_conn_interval = TELEOP_BLE_MAX_CONN_INTERVAL,
+};
+
+simple_ble_app_t* simple_ble_app;
+
+// hand SoftDevice events to the BLE libraries this app uses
+TELEOP_BLE_DEF(teleop);
+
+// nothing to do, waking the main loop is enough
+static void wake(void) {
+}
+
+static void print_stats(void) {
+  const teleop_stats_t* stats = teleop_stats();
+  uint32_t average_us = stats->applied ? stats->total_latency_us / stats->applied : 0;
+  printf("teleop: %lu received, %lu applied, %lu coalesced, %lu stale, %lu timeouts, "
+      "latency %lu us average, %lu us max, interval %u.%02u ms\n",
+      stats->received, stats->applied, stats->coalesced, stats->stale, stats->timeouts,
+      average_us, stats->max_latency_us,
+      teleop_ble_conn_interval() * 125 / 100, teleop_ble_conn_interval() * 125 % 100);
+}
+
+int main(void) {
+  ret_code_t error_code = NRF_SUCCESS;
+
+  // initialize RTT library
+  error_code = NRF_LOG_INIT(NULL);
+  APP_ERROR_CHECK(error_code);
+  NRF_LOG_DEFAULT_BACKENDS_INIT();
+  printf("Log initialized!\n");
+
+  // Setup BLE
+  simple_ble_app = simple_ble_init(&ble_config);
+  teleop_ble_init(TIMEOUT_MS);
+
+  // Start Advertising
+  simple_ble_adv_only_name();
+
+  // initialize display
+  nrf_drv_spi_t spi_instance = NRF_DRV_SPI_INSTANCE(1);
+  nrf_drv_spi_config_t spi_config = {
+    .sck_pin = BUCKLER_LCD_SCLK,
+    .mosi_pin = BUCKLER_LCD_MOSI,
+    .miso_pin = BUCKLER_LCD_MISO,
+    .ss_pin = BUCKLER_LCD_CS,
+    .irq_priority = NRFX_SPI_DEFAULT_CONFIG_IRQ_PRIORITY,
+    .orc = 0,
+    .frequency = NRF_DRV_SPI_FREQ_4M,
+    .mode = NRF_DRV_SPI_MODE_2,
+    .bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST
+  };
+  error_code = nrf_drv_spi_init(&spi_instance, &spi_config, NULL, NULL);
+  APP_ERROR_CHECK(error_code);
+  display_init(&spi_instance);
+  display_write("STOPPED", DISPLAY_LINE_0);
+  printf("Display initialized!\n");
+
+  // initialize Kobuki
+  kobukiInit();
+  kobukiDriveDirect(0, 0);
+  printf("Kobuki initialized!\n");
+
+  virtual_timer_init();
+  virtual_timer_start_repeated(WAKE_PERIOD_US, wake);
+
+  bool driving = false;
+  uint64_t next_stats_us = read_timer64() + STATS_PERIOD_US;
+  while (1) {
+    teleop_command_t cmd;
+    if (teleop_ble_next(&cmd)) {
+      kobukiDriveDirect(cmd.left, cmd.right);
+
+      // the display is slow, so it only changes with the mode
+      if (driving == teleop_stopped()) {
+        driving = !driving;
+        display_write(driving ? "DRIVING" : "STOPPED", DISPLAY_LINE_0);
+      }
+    }
+
+    if (read_timer64() >= next_stats_us) {
+      next_stats_us += STATS_PERIOD_US;
+      print_stats();
+    }
+
+    // Sleep until a command, a timer or another BLE event
+    power_manage();
+  }
+}
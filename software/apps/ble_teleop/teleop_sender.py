@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+import argparse
+import struct
+import time
+from bluepy.btle import Peripheral, DefaultDelegate
+
+parser = argparse.ArgumentParser(description='Drive a Kobuki over BLE and measure command latency')
+parser.add_argument('addr', metavar='A', type=str, help='Address of the form XX:XX:XX:XX:XX:XX')
+parser.add_argument('--left', type=int, default=100, help='Left wheel speed in mm/s')
+parser.add_argument('--right', type=int, default=100, help='Right wheel speed in mm/s')
+parser.add_argument('--rate', type=float, default=50, help='Commands per second')
+parser.add_argument('--duration', type=float, default=5, help='Seconds to drive for')
+args = parser.parse_args()
+addr = args.addr.lower()
+if len(addr) != 17:
+    raise ValueError("Invalid address supplied")
+
+TELEOP_SERVICE_UUID = "7e1e0001-5d3c-4b8a-9f61-2c4a8e0d7b15"
+TELEOP_COMMAND_UUID = "7e1e0002-5d3c-4b8a-9f61-2c4a8e0d7b15"
+TELEOP_STATUS_UUID  = "7e1e0003-5d3c-4b8a-9f61-2c4a8e0d7b15"
+
+# teleop.h and teleop_ble.h
+COMMAND = struct.Struct("<Hhh")
+STATUS = struct.Struct("<HI")
+
+
+class StatusDelegate(DefaultDelegate):
+    def __init__(self):
+        DefaultDelegate.__init__(self)
+        self.sent = {}
+        self.round_trips = []
+        self.robot = []
+
+    def handleNotification(self, handle, data):
+        seq, latency_us = STATUS.unpack(data)
+        sent = self.sent.pop(seq, None)
+        if sent is not None:
+            self.round_trips.append(time.perf_counter() - sent)
+            self.robot.append(latency_us / 1e6)
+
+
+def percentile(values, fraction):
+    return sorted(values)[min(len(values) - 1, int(len(values) * fraction))]
+
+
+try:
+    print("connecting")
+    buckler = Peripheral(addr)
+    print("connected")
+
+    sv = buckler.getServiceByUUID(TELEOP_SERVICE_UUID)
+    command_ch = sv.getCharacteristics(TELEOP_COMMAND_UUID)[0]
+    status_ch = sv.getCharacteristics(TELEOP_STATUS_UUID)[0]
+
+    delegate = StatusDelegate()
+    buckler.setDelegate(delegate)
+
+    # Enable notifications through the descriptor after the value
+    buckler.writeCharacteristic(status_ch.getHandle() + 1, b"\x01\x00")
+
+    seq = 0
+    period = 1 / args.rate
+    start = time.perf_counter()
+    next_send = start
+    while time.perf_counter() - start < args.duration:
+        seq = (seq + 1) & 0xFFFF
+        delegate.sent[seq] = time.perf_counter()
+        command_ch.write(COMMAND.pack(seq, args.left, args.right), withResponse=False)
+        next_send += period
+        # handle acknowledgements until the next command is due
+        while True:
+            remaining = next_send - time.perf_counter()
+            if remaining <= 0 or not buckler.waitForNotifications(remaining):
+                break
+
+    # stop, rather than waiting for the robot's timeout
+    seq = (seq + 1) & 0xFFFF
+    command_ch.write(COMMAND.pack(seq, 0, 0), withResponse=False)
+    buckler.waitForNotifications(0.5)
+
+    acked = len(delegate.round_trips)
+    sent = acked + len(delegate.sent)
+    print("{} commands sent, {} acknowledged, the rest coalesced or lost".format(sent, acked))
+    if acked:
+        ms = [t * 1000 for t in delegate.round_trips]
+        print("round trip: {:.1f} ms average, {:.1f} ms median, {:.1f} ms 99th percentile, {:.1f} ms max".format(
+            sum(ms) / acked, percentile(ms, 0.5), percentile(ms, 0.99), max(ms)))
+        print("waiting on the robot: {:.2f} ms average, {:.2f} ms max".format(
+            1000 * sum(delegate.robot) / acked, 1000 * max(delegate.robot)))
+finally:
+    buckler.disconnect()
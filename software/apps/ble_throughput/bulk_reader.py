@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+import argparse
+import struct
+import time
+from bluepy.btle import Peripheral, DefaultDelegate
+
+parser = argparse.ArgumentParser(description='Time a bulk transfer from a Buckler')
+parser.add_argument('addr', metavar='A', type=str, help='Address of the form XX:XX:XX:XX:XX:XX')
+parser.add_argument('--size', type=int, default=200000, help='Bytes to transfer')
+parser.add_argument('--timeout', type=float, default=30, help='Seconds to wait for the transfer')
+args = parser.parse_args()
+addr = args.addr.lower()
+if len(addr) != 17:
+    raise ValueError("Invalid address supplied")
+
+BULK_SERVICE_UUID = "9b3c0001-71d2-4e0a-b8f5-3a6d1c9e2f47"
+BULK_DATA_UUID    = "9b3c0002-71d2-4e0a-b8f5-3a6d1c9e2f47"
+BULK_CONTROL_UUID = "9b3c0003-71d2-4e0a-b8f5-3a6d1c9e2f47"
+BULK_RATE_UUID    = "9b3c0004-71d2-4e0a-b8f5-3a6d1c9e2f47"
+
+# ble_bulk.h
+HEADER = struct.Struct("<I")
+
+
+class BulkDelegate(DefaultDelegate):
+    def __init__(self):
+        DefaultDelegate.__init__(self)
+        self.received = 0
+        self.packets = 0
+        self.missing = 0
+        self.corrupt = 0
+        self.start = None
+        self.end = None
+
+    def handleNotification(self, handle, data):
+        now = time.perf_counter()
+        if self.start is None:
+            self.start = now
+        self.end = now
+
+        offset, = HEADER.unpack_from(data)
+        payload = data[HEADER.size:]
+        if offset > self.received:
+            self.missing += offset - self.received
+        # the robot sends a counting pattern
+        if any(b != (offset + i) & 0xFF for i, b in enumerate(payload)):
+            self.corrupt += 1
+        self.received = offset + len(payload)
+        self.packets += 1
+
+
+try:
+    print("connecting")
+    buckler = Peripheral(addr)
+    mtu = buckler.setMTU(247)
+    print("connected, MTU", mtu)
+
+    sv = buckler.getServiceByUUID(BULK_SERVICE_UUID)
+    data_ch = sv.getCharacteristics(BULK_DATA_UUID)[0]
+    control_ch = sv.getCharacteristics(BULK_CONTROL_UUID)[0]
+    rate_ch = sv.getCharacteristics(BULK_RATE_UUID)[0]
+
+    delegate = BulkDelegate()
+    buckler.setDelegate(delegate)
+
+    # Enable notifications through the descriptor after the value
+    buckler.writeCharacteristic(data_ch.getHandle() + 1, b"\x01\x00")
+    control_ch.write(struct.pack("<I", args.size), withResponse=True)
+
+    deadline = time.time() + args.timeout
+    while delegate.received < args.size and time.time() < deadline:
+        buckler.waitForNotifications(1.0)
+
+    if delegate.packets > 1:
+        elapsed = delegate.end - delegate.start
+        print("{} bytes in {} packets, {:.2f} s, {:.0f} bytes/s received".format(
+            delegate.received, delegate.packets, elapsed, delegate.received / elapsed))
+    print("{} bytes missing, {} packets corrupt".format(
+        delegate.missing + args.size - delegate.received, delegate.corrupt))
+
+    # the robot's own figure, from first packet queued to last sent
+    time.sleep(0.5)
+    print("robot measured {} bytes/s".format(struct.unpack("<I", rate_ch.read())[0]))
+finally:
+    buckler.disconnect()
@@ -0,0 +1,69 @@
+// BLE Throughput app
+//
+// Negotiates the largest MTU, data length extension and the 2M PHY with
+// whatever connects, and streams blocks of data on request to measure the
+// link. Run bulk_reader.py to request a block and time it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+
+#include "ble_bulk.h"
+#include "ble_throughput.h"
+#include "simple_ble.h"
+
+// Intervals for advertising and connections. Connection events stretch
+// while there is data, so a longer interval costs little throughput.
+static simple_ble_config_t ble_config = {
+        // c0:98:e5:49:xx:xx
+        .platform_id       = 0x49,    // used as 4th octect in device BLE address
+        .device_id         = 0x0000, // TODO: replace with your lab bench number
+        .adv_name          = "THROUGHPUT", // used in advertisements if there is room
+        .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+        .min_conn_interval = MSEC_TO_UNITS(15, UNIT_1_25_MS),
+        .max_conn_interval = MSEC_TO_UNITS(30, UNIT_1_25_MS),
+};
+
+simple_ble_app_t* simple_ble_app;
+
+// hand SoftDevice events to the BLE libraries this app uses
+BLE_THROUGHPUT_DEF(link);
+BLE_BULK_DEF(bulk);
+
+int main(void) {
+  ret_code_t error_code = NRF_SUCCESS;
+
+  // initialize RTT library
+  error_code = NRF_LOG_INIT(NULL);
+  APP_ERROR_CHECK(error_code);
+  NRF_LOG_DEFAULT_BACKENDS_INIT();
+  printf("Log initialized!\n");
+
+  // Setup BLE
+  simple_ble_app = simple_ble_init(&ble_config);
+  ble_throughput_init();
+  ble_bulk_init(NULL);
+
+  // Start Advertising
+  simple_ble_adv_only_name();
+
+  // print the link parameters whenever negotiation changes them
+  ble_throughput_link_t shown = {0};
+  while (1) {
+    // Sleep while SoftDevice handles BLE
+    power_manage();
+
+    const ble_throughput_link_t* link = ble_throughput_link();
+    if (memcmp(&shown, link, sizeof(shown)) != 0) {
+      shown = *link;
+      ble_throughput_print_link();
+    }
+  }
+}
@@ -18,31 +18,47 @@
 #include "nrf_serial.h"
 
 #include "buckler.h"
+#include "event_scheduler.h"
 
 // LED array
 static uint8_t LEDS[3] = {BUCKLER_LED0, BUCKLER_LED1, BUCKLER_LED2};
 
 
+// events posted by the GPIOTE interrupt, data is the new pin state
+enum {
+  EVENT_BUTTON,
+  EVENT_SWITCH,
+};
+
+void button_handler(uint32_t pressed) {
+  if (pressed) {
+    nrfx_gpiote_out_set(LEDS[0]);
+  } else {
+    nrfx_gpiote_out_clear(LEDS[0]);
+  }
+}
+
+void switch_handler(uint32_t on) {
+  if (on) {
+    nrfx_gpiote_out_set(LEDS[1]);
+    nrfx_gpiote_out_clear(LEDS[2]);
+  } else {
+    nrfx_gpiote_out_clear(LEDS[1]);
+    nrfx_gpiote_out_set(LEDS[2]);
+  }
+}
+
 // handler called whenever an input pin changes
+// Runs in interrupt context, so it only records the change for the main loop
 void pin_change_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
   switch(pin) {
     case BUCKLER_BUTTON0: {
-      if (nrfx_gpiote_in_is_set(BUCKLER_BUTTON0)) {
-        nrfx_gpiote_out_set(LEDS[0]);
-      } else {
-        nrfx_gpiote_out_clear(LEDS[0]);
-      }
+      event_post(EVENT_BUTTON, nrfx_gpiote_in_is_set(BUCKLER_BUTTON0));
       break;
     }
 
     case BUCKLER_SWITCH0: {
-      if (nrfx_gpiote_in_is_set(BUCKLER_SWITCH0)) {
-        nrfx_gpiote_out_set(LEDS[1]);
-        nrfx_gpiote_out_clear(LEDS[2]);
-      } else {
-        nrfx_gpiote_out_clear(LEDS[1]);
-        nrfx_gpiote_out_set(LEDS[2]);
-      }
+      event_post(EVENT_SWITCH, nrfx_gpiote_in_is_set(BUCKLER_SWITCH0));
       break;
     }
   }
@@ -51,9 +67,11 @@ void pin_change_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
 int main(void) {
   ret_code_t error_code = NRF_SUCCESS;
 
-  // initialize power management
-  error_code = nrf_pwr_mgmt_init();
+  // initialize the event scheduler, which also sets up power management
+  error_code = event_scheduler_init();
   APP_ERROR_CHECK(error_code);
+  event_register(EVENT_BUTTON, button_handler);
+  event_register(EVENT_SWITCH, switch_handler);
 
   // initialize GPIO driver
   if (!nrfx_gpiote_is_init()) {
@@ -82,18 +100,9 @@ int main(void) {
 
   // set initial states for LEDs
   nrfx_gpiote_out_set(LEDS[0]);
-  if (nrfx_gpiote_in_is_set(BUCKLER_SWITCH0)) {
-    nrfx_gpiote_out_set(LEDS[1]);
-    nrfx_gpiote_out_clear(LEDS[2]);
-  } else {
-    nrfx_gpiote_out_clear(LEDS[1]);
-    nrfx_gpiote_out_set(LEDS[2]);
-  }
-  
-  // loop forever
-  while (1) {
-    // enter sleep mode
-    nrf_pwr_mgmt_run();
-  }
+  switch_handler(nrfx_gpiote_in_is_set(BUCKLER_SWITCH0));
+
+  // handle pin changes as they come in, sleeping in between
+  event_scheduler_run();
 }
 
@@ -19,16 +19,71 @@
 #include "nrf_serial.h"
 
 #include "buckler.h"
+#include "event_scheduler.h"
 #include "kobukiActuator.h"
 #include "kobukiSensorTypes.h"
 #include "kobukiSensorPoll.h"
 #include "kobukiUtilities.h"
+#include "virtual_timer.h"
 
 typedef enum {
   DRIVING,
   TURNING
 } KobukiState_t;
 
+// events, posted by a timer
+enum {
+  EVENT_STEP,
+};
+
+// Check the state every 10 ms, sleeping in between
+#define STEP_PERIOD_US 10000
+
+static KobukiState_t state = DRIVING;
+static KobukiSensors_t initial_sensors;
+static uint8_t i = 0;
+
+// one step of the state machine
+static void step_handler(uint32_t data) {
+
+  // test current state
+  switch (state) {
+    case DRIVING: {
+      kobukiDriveDirect(100,100);
+
+      // continue driving until 200*10 = 2000 ms have passed
+      if (i >= 200) {
+        // transition to turning state
+        state = TURNING;
+        printf("Beginning turn. Polling sensors\n");
+        kobukiSensorPoll(&initial_sensors);
+        printf("Starting Angle: %d\n", initial_sensors.angle);
+      } else {
+        // continue driving
+        i++;
+      }
+
+      break;
+    }
+
+    case TURNING: {
+      kobukiDriveRadius(150,100);
+
+      // check angle to see if we've reached more than 85 degrees
+      KobukiSensors_t sensors;
+      kobukiSensorPoll(&sensors);
+      if (abs(sensors.angle - initial_sensors.angle) >= 8500) {
+        // transition to driving state
+        state = DRIVING;
+        printf("Driving! Longest step %lu us\n", event_stats(EVENT_STEP)->max_cycles / 64);
+        i = 0;
+      }
+
+      break;
+    }
+  };
+}
+
 int main(void) {
 
   // initialize Kobuki library
@@ -40,53 +95,16 @@ int main(void) {
   printf("Initialized RTT!\n");
 
   // initialize state
-  KobukiState_t state = DRIVING;
-  KobukiSensors_t initial_sensors;
   kobukiSensorPoll(&initial_sensors);
 
-  // loop forever
-  uint8_t i = 0;
-  while (1) {
-
-    // test current state
-    switch (state) {
-      case DRIVING: {
-        kobukiDriveDirect(100,100);
-
-        // continue driving until 200*10 = 2000 ms have passed
-        if (i >= 200) {
-          // transition to turning state
-          state = TURNING;
-          printf("Beginning turn. Polling sensors\n");
-          kobukiSensorPoll(&initial_sensors);
-          printf("Starting Angle: %d\n", initial_sensors.angle);
-        } else {
-          // continue driving
-          i++;
-        }
-
-        break;
-      }
-
-      case TURNING: {
-        kobukiDriveRadius(150,100);
-
-        // check angle to see if we've reached more than 85 degrees
-        KobukiSensors_t sensors;
-        kobukiSensorPoll(&sensors);
-        if (abs(sensors.angle - initial_sensors.angle) >= 8500) {
-          // transition to driving state
-          state = DRIVING;
-          printf("Driving!\n");
-          i = 0;
-        }
+  // step the state machine from a repeated timer event
+  ret_code_t error_code = event_scheduler_init();
+  APP_ERROR_CHECK(error_code);
+  virtual_timer_init();
+  event_register(EVENT_STEP, step_handler);
+  error_code = event_timer_start(EVENT_STEP, STEP_PERIOD_US, true, 0);
+  APP_ERROR_CHECK(error_code);
 
-        break;
-      }
-    };
-
-    // continue for 10 ms before checking state again
-    nrf_delay_ms(10);
-  }
+  // handle steps as they come in, sleeping in between
+  event_scheduler_run();
 }
-
@@ -20,6 +20,7 @@
 #include "nrf_twi_mngr.h"
 
 #include "buckler.h"
+#include "control_loop.h"
 #include "display.h"
 
 #include "kobukiActuator.h"
@@ -28,6 +29,7 @@
 #include "kobukiUtilities.h"
 
 #include "lsm9ds1.h"
+#include "numfmt.h"
 
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
@@ -38,6 +40,103 @@ typedef enum {
   TURNING
 } KobukiState_t;
 
+// Run the state machine at the 50 Hz rate the Kobuki sends sensor packets
+#define CONTROL_PERIOD_US 20000
+
+// Drive this long along each side of the square
+#define DRIVE_TIME_MS 2000
+
+// Steps between timing reports (10 s)
+#define STATS_PERIOD_STEPS 500
+
+static KobukiState_t state = OFF;
+static KobukiSensors_t sensors = {0};
+static uint8_t i = 0;
+// a full display line and its terminator
+static char display_buf[DISPLAY_COLUMNS + 1];
+
+// Blocking display writes are the slowest part of a step, so skip them while
+// the loop is running late
+static void show(const char* text, uint8_t row) {
+  if (!control_loop_degraded()) {
+    display_write(text, row);
+  }
+}
+
+static void degraded_handler(bool degraded) {
+  printf(degraded ? "Loop overran, display paused\n" : "Loop back in budget\n");
+}
+
+// one iteration of the state machine
+static void control_step(void) {
+  uint32_t steps = control_loop_stats()->steps;
+  if (steps > 0 && steps % STATS_PERIOD_STEPS == 0) {
+    control_loop_print_stats();
+  }
+
+  // read sensors from robot
+  kobukiSensorPoll(&sensors);
+
+  // test current state
+  switch(state) {
+    case OFF: {
+      kobukiDriveDirect(0,0);
+      // transition logic
+      if (is_button_pressed(&sensors)) {
+        state = DRIVING;
+      } else {
+        // perform state-specific actions here
+        show("OFF", DISPLAY_LINE_0);
+
+        state = OFF;
+      }
+      break; // each case needs to end with break!
+    }
+    case DRIVING: {
+      kobukiDriveDirect(75,75);
+
+      // continue driving until DRIVE_TIME_MS have passed
+      if (is_button_pressed(&sensors)) {
+        state = OFF;
+      }
+      else if (i >= DRIVE_TIME_MS * 1000 / CONTROL_PERIOD_US) {
+        state = TURNING;
+        printf("Beginning turn. Reading sensors\n");
+        lsm9ds1_start_gyro_integration();
+
+      } else {
+        // continue driving
+        show("DRIVING", DISPLAY_LINE_0);
+        i++;
+      }
+
+      break;
+    }
+    case TURNING: {
+      kobukiDriveDirect(75,-75);
+      // check angle to see if we've reached more than 85 degrees
+      lsm9ds1_measurement_t angle = lsm9ds1_read_gyro_integration();
+      if (is_button_pressed(&sensors)) {
+        state = OFF;
+      }
+      else if (abs(angle.z_axis) >= 85) {
+        // transition to driving state
+        lsm9ds1_stop_gyro_integration();
+        state = DRIVING;
+        printf("Driving!\n");
+        i = 0;
+      } else {
+        // an angle that doesn't fit on the line shows as NUMFMT_OVERFLOW
+        int len = numfmt_str(display_buf, sizeof(display_buf), "TURNING: ");
+        numfmt_float(display_buf + len, sizeof(display_buf) - len, angle.z_axis, 2, 0);
+        show(display_buf, DISPLAY_LINE_0);
+      }
+
+      break;
+    }
+  }
+}
+
 int main(void) {
 
   // initialize Kobuki library
@@ -48,10 +147,6 @@ int main(void) {
   NRF_LOG_DEFAULT_BACKENDS_INIT();
   printf("Initialized RTT!\n");
 
-  // initialize state
-  KobukiState_t state = OFF;
-  KobukiSensors_t sensors = {0};
-
   // initialize i2c master (two wire interface)
   nrf_drv_twi_config_t i2c_config = NRF_DRV_TWI_DEFAULT_CONFIG;
   i2c_config.scl = BUCKLER_SENSORS_SCL;
@@ -85,72 +180,14 @@ int main(void) {
   lsm9ds1_init(&twi_mngr_instance);
   printf("lsm9ds1 initialized\n");
 
-  // loop forever
-  static uint8_t i = 0;
-  static char display_buf[16];
-  while(1) {
-    // read sensors from robot
-    kobukiSensorPoll(&sensors);
-
-    // test current state
-    switch(state) {
-      case OFF: {
-        kobukiDriveDirect(0,0);
-        // transition logic
-        if (is_button_pressed(&sensors)) {
-          state = DRIVING;
-        } else {
-          // perform state-specific actions here
-          display_write("OFF", DISPLAY_LINE_0);
-
-          state = OFF;
-        }
-        break; // each case needs to end with break!
-      }
-      case DRIVING: {
-        kobukiDriveDirect(75,75);
-
-        // continue driving until 200*10 = 2000 ms have passed
-        if (is_button_pressed(&sensors)) {
-          state = OFF;
-        }
-        else if (i >= 200) {
-          state = TURNING;
-          printf("Beginning turn. Reading sensors\n");
-          lsm9ds1_start_gyro_integration();
-
-        } else {
-          // continue driving
-          display_write("DRIVING", DISPLAY_LINE_0);
-          i++;
-        }
-
-        break;
-      }
-      case TURNING: {
-        kobukiDriveDirect(75,-75);
-        // check angle to see if we've reached more than 85 degrees
-        lsm9ds1_measurement_t angle = lsm9ds1_read_gyro_integration();
-        if (is_button_pressed(&sensors)) {
-          state = OFF;
-        }
-        else if (abs(angle.z_axis) >= 85) {
-          // transition to driving state
-          lsm9ds1_stop_gyro_integration();
-          state = DRIVING;
-          printf("Driving!\n");
-          i = 0;
-        } else {
-          snprintf(display_buf, 16, "TURNING: %.2f", angle.z_axis);
-          display_write("TURNING: ", DISPLAY_LINE_0);
-        }
-
-        break;
-      }
-    };
-
-    // continue for 10 ms before checking state again
-    nrf_delay_ms(1);
-  }
+  // run the state machine at a fixed rate forever
+  control_loop_config_t loop_config = {
+    .period_us = CONTROL_PERIOD_US,
+    .budget_us = 0,
+    .step = control_step,
+    .degraded = degraded_handler,
+  };
+  error_code = control_loop_init(&loop_config);
+  APP_ERROR_CHECK(error_code);
+  control_loop_run();
 }
-
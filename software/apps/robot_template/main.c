@@ -19,12 +19,15 @@
 #include "nrf_drv_spi.h"
 
 #include "buckler.h"
+#include "control_loop.h"
 #include "display.h"
 #include "kobukiActuator.h"
 #include "kobukiSensorPoll.h"
 #include "kobukiSensorTypes.h"
 #include "kobukiUtilities.h"
 #include "lsm9ds1.h"
+#include "numfmt.h"
+#include "rtc_time.h"
 
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
@@ -42,6 +45,12 @@ typedef enum {
 
 #define SPEED 75
 
+// Run the state machine at the 50 Hz rate the Kobuki sends sensor packets
+#define CONTROL_PERIOD_US 20000
+
+// Print loop timing statistics every 10 s
+#define STATS_PERIOD_STEPS 500
+
 
 char buf[16];
 const float CONVERSION = 0.0006108;
@@ -52,9 +61,159 @@ static float measure_distance(uint16_t current_encoder,
   return CONVERSION*(current_encoder-previous_encoder);
 }
 
+// Display updates are optional, so they are dropped while the loop is over
+// its time budget
+static void show(const char* text, uint8_t row) {
+  if (!control_loop_degraded()) {
+    display_write(text, row);
+  }
+}
+
+static void degraded_handler(bool degraded) {
+  printf(degraded ? "Control loop over budget, pausing display\n" : "Control loop recovered\n");
+}
+
+static robot_state_t state = OFF;
+static KobukiSensors_t sensors = {0};
+
+static double distance;
+static uint8_t bumped;
+static uint16_t previous_encoder;
+
+// one iteration of the state machine
+static void control_step(void) {
+  uint32_t steps = control_loop_stats()->steps;
+  if (steps > 0 && steps % STATS_PERIOD_STEPS == 0) {
+    control_loop_print_stats();
+  }
+
+  // read sensors from robot
+  kobukiSensorPoll(&sensors);
+
+  // handle states
+  switch(state) {
+    case OFF: {
+      // transition logic
+      if (is_button_pressed(&sensors)) {
+        state = DRIVING;
+        previous_encoder = sensors.leftWheelEncoder;
+        kobukiDriveDirect(SPEED, SPEED);
+      } else {
+        // perform state-specific actions here
+        show("OFF", DISPLAY_LINE_0);
+      }
+      break; // each case needs to end with break!
+    }
+
+    case DRIVING: {
+      // transition logic
+
+      if (sensors.bumps_wheelDrops.bumpLeft)
+          bumped = 1;
+      else if (sensors.bumps_wheelDrops.bumpCenter)
+          bumped = 2;
+      else if (sensors.bumps_wheelDrops.bumpRight)
+          bumped = 3;
+      else
+          bumped = 0;
+
+      if (is_button_pressed(&sensors)) {
+        distance = 0;
+        state = OFF;
+        kobukiDriveDirect(0, 0);
+      } else if (bumped) {
+        distance = 0;
+        state = SWITCHING_COURSE;
+        kobukiDriveDirect(-SPEED, -SPEED);
+      } else if (distance >= .5) {
+        distance = 0;
+        state = TURNING;
+        lsm9ds1_start_gyro_integration();
+        kobukiDriveDirect(SPEED, -SPEED);
+      } else {
+        // perform state-specific actions here
+        show("DRIVING", DISPLAY_LINE_0);
+
+        distance += measure_distance(sensors.leftWheelEncoder, previous_encoder);
+        previous_encoder = sensors.leftWheelEncoder;
+        numfmt_float(buf, sizeof(buf), distance, 6, 0);
+        show(buf, DISPLAY_LINE_1);
+      }
+      break; // each case needs to end with break!
+    }
+
+    // add other cases here
+    case TURNING: {
+      float angle = lsm9ds1_read_gyro_integration().z_axis;
+      if (angle <= -90) {
+        lsm9ds1_stop_gyro_integration();
+        kobukiDriveDirect(SPEED, SPEED);
+        state = DRIVING;
+      } else {
+        show("TURNING", DISPLAY_LINE_0);
+        numfmt_float(buf, sizeof(buf), angle, 6, 0);
+        show(buf, DISPLAY_LINE_1);
+      }
+      break;
+    }
+
+    case SWITCHING_COURSE: {
+      if (measure_distance(sensors.leftWheelEncoder, previous_encoder) <= 0) {
+        state = BACKING_UP;
+      } else {
+        previous_encoder = sensors.leftWheelEncoder;
+      }
+      break;
+    }
+
+    case BACKING_UP: {
+      if (is_button_pressed(&sensors)) {
+        distance = 0;
+        state = OFF;
+        kobukiDriveDirect(0, 0);
+      } else if (distance <= -.1) {
+        distance = 0;
+        state = TURNING_AWAY;
+        lsm9ds1_start_gyro_integration();
+        if (bumped == 1)
+          kobukiDriveDirect(SPEED, -SPEED);
+        else
+          kobukiDriveDirect(-SPEED, SPEED);
+      } else {
+        // perform state-specific actions here
+        show("BACKING_UP", DISPLAY_LINE_0);
+
+        distance -= measure_distance(previous_encoder, sensors.leftWheelEncoder);
+        previous_encoder = sensors.leftWheelEncoder;
+        numfmt_float(buf, sizeof(buf), distance, 6, 0);
+        show(buf, DISPLAY_LINE_1);
+      }
+      break;
+    }
+
+    case TURNING_AWAY: {
+      float angle = lsm9ds1_read_gyro_integration().z_axis;
+      if (bumped == 1 && angle <= -45 || bumped != 1 && angle >= 45) {
+        lsm9ds1_stop_gyro_integration();
+        kobukiDriveDirect(SPEED, SPEED);
+        state = DRIVING;
+      } else {
+        show("TURNING_AWAY", DISPLAY_LINE_0);
+        numfmt_float(buf, sizeof(buf), angle, 6, 0);
+        show(buf, DISPLAY_LINE_1);
+      }
+      break;
+    }
+  }
+}
+
 int main(void) {
   ret_code_t error_code = NRF_SUCCESS;
 
+  // start the timebase first, so boot time is measured from here
+  error_code = rtc_time_init();
+  APP_ERROR_CHECK(error_code);
+
   // initialize RTT library
   error_code = NRF_LOG_INIT(NULL);
   APP_ERROR_CHECK(error_code);
@@ -79,9 +238,9 @@ int main(void) {
     .mode = NRF_DRV_SPI_MODE_2,
     .bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST
   };
-  error_code = nrf_drv_spi_init(&spi_instance, &spi_config, NULL, NULL);
+  error_code = nrf_drv_spi_init(&spi_instance, &spi_config, display_spi_evt_handler, NULL);
   APP_ERROR_CHECK(error_code);
-  display_init(&spi_instance);
+  display_init_async(&spi_instance, NULL, NULL);
   display_write("Hello, Human!", DISPLAY_LINE_0);
   printf("Display initialized!\n");
 
@@ -99,139 +258,15 @@ int main(void) {
   kobukiInit();
   printf("Kobuki initialized!\n");
 
-  // configure initial state
-  robot_state_t state = OFF;
-  KobukiSensors_t sensors = {0};
-
-  double distance;
-  uint8_t bumped;
-  uint16_t previous_encoder;
-
-  // loop forever, running state machine
-  while (1) {
-    // read sensors from robot
-    kobukiSensorPoll(&sensors);
-
-    // delay before continuing
-    // Note: removing this delay will make responses quicker, but will result
-    //  in printf's in this loop breaking JTAG
-    nrf_delay_ms(1);
-
-    // handle states
-    switch(state) {
-      case OFF: {
-        // transition logic
-        if (is_button_pressed(&sensors)) {
-          state = DRIVING;
-          previous_encoder = sensors.leftWheelEncoder;
-          kobukiDriveDirect(SPEED, SPEED);
-        } else {
-          // perform state-specific actions here
-          display_write("OFF", DISPLAY_LINE_0);
-        }
-        break; // each case needs to end with break!
-      }
-
-      case DRIVING: {
-        // transition logic
-
-        if (sensors.bumps_wheelDrops.bumpLeft)
-            bumped = 1;
-        else if (sensors.bumps_wheelDrops.bumpCenter)
-            bumped = 2;
-        else if (sensors.bumps_wheelDrops.bumpRight)
-            bumped = 3;
-        else
-            bumped = 0;
-
-        if (is_button_pressed(&sensors)) {
-          distance = 0;
-          state = OFF;
-          kobukiDriveDirect(0, 0);
-        } else if (bumped) {
-          distance = 0;
-          state = SWITCHING_COURSE;
-          kobukiDriveDirect(-SPEED, -SPEED);
-        } else if (distance >= .5) {
-          distance = 0;
-          state = TURNING;
-          lsm9ds1_start_gyro_integration();
-          kobukiDriveDirect(SPEED, -SPEED);
-        } else {
-          // perform state-specific actions here
-          display_write("DRIVING", DISPLAY_LINE_0);
-
-          distance += measure_distance(sensors.leftWheelEncoder, previous_encoder);
-          previous_encoder = sensors.leftWheelEncoder;
-          snprintf(buf, 16, "%f", distance);
-          display_write(buf, DISPLAY_LINE_1);
-        }
-        break; // each case needs to end with break!
-      }
-
-      // add other cases here
-      case TURNING: {
-        float angle = lsm9ds1_read_gyro_integration().z_axis;
-        if (angle <= -90) {
-          lsm9ds1_stop_gyro_integration();
-          kobukiDriveDirect(SPEED, SPEED);
-          state = DRIVING;
-        } else {
-          display_write("TURNING", DISPLAY_LINE_0);
-          snprintf(buf, 16, "%f", angle);
-          display_write(buf, DISPLAY_LINE_1);
-        }
-        break;
-      }
-
-      case SWITCHING_COURSE: {
-        if (measure_distance(sensors.leftWheelEncoder, previous_encoder) <= 0) {
-          state = BACKING_UP;
-        } else {
-          previous_encoder = sensors.leftWheelEncoder;
-        }
-        break;
-      }
-
-      case BACKING_UP: {
-        if (is_button_pressed(&sensors)) {
-          distance = 0;
-          state = OFF;
-          kobukiDriveDirect(0, 0);
-        } else if (distance <= -.1) {
-          distance = 0;
-          state = TURNING_AWAY;
-          lsm9ds1_start_gyro_integration();
-          if (bumped == 1)
-            kobukiDriveDirect(SPEED, -SPEED);
-          else
-            kobukiDriveDirect(-SPEED, SPEED);
-        } else {
-          // perform state-specific actions here
-          display_write("BACKING_UP", DISPLAY_LINE_0);
-
-          distance -= measure_distance(previous_encoder, sensors.leftWheelEncoder);
-          previous_encoder = sensors.leftWheelEncoder;
-          snprintf(buf, 16, "%f", distance);
-          display_write(buf, DISPLAY_LINE_1);
-        }
-        break;
-      }
-
-      case TURNING_AWAY: {
-        float angle = lsm9ds1_read_gyro_integration().z_axis;
-        if (bumped == 1 && angle <= -45 || bumped != 1 && angle >= 45) {
-          lsm9ds1_stop_gyro_integration();
-          kobukiDriveDirect(SPEED, SPEED);
-          state = DRIVING;
-        } else {
-          display_write("TURNING_AWAY", DISPLAY_LINE_0);
-          snprintf(buf, 16, "%f", angle);
-          display_write(buf, DISPLAY_LINE_1);
-        }
-        break;
-      }
-    }
-  }
+  // run the state machine at a fixed rate forever
+  control_loop_config_t loop_config = {
+    .period_us = CONTROL_PERIOD_US,
+    .budget_us = 0,
+    .step = control_step,
+    .degraded = degraded_handler,
+  };
+  error_code = control_loop_init(&loop_config);
+  APP_ERROR_CHECK(error_code);
+  printf("Boot took %lu us, display init %lu us\n", (uint32_t)rtc_time_us(), display_init_time_us());
+  control_loop_run();
 }
-
@@ -3,6 +3,7 @@
 #include "controller.h"
 #include "kobukiSensorTypes.h"
 #include "display.h"
+#include "numfmt.h"
 
 // configure initial state
 KobukiSensors_t sensors = {0};
@@ -31,7 +32,7 @@ robot_state_t controller(robot_state_t state) {
   //nrf_delay_ms(1);
 
   char buf[16];
-  snprintf(buf, 16, "%f", distance);
+  numfmt_float(buf, sizeof(buf), distance, 6, 0);
   display_write(buf, DISPLAY_LINE_1);
 
   // handle states
@@ -19,15 +19,16 @@
 #include "nrf_drv_spi.h"
 
 #include "buckler.h"
+#include "control_loop.h"
 #include "display.h"
 #include "kobukiActuator.h"
-#include "kobukiSensorPoll.h"
 #include "kobukiSensorTypes.h"
 #include "kobukiUtilities.h"
 #include "lsm9ds1.h"
 
 #include "pixy2_spi.h"
 #include "pid.h"
+#include "tracker.h"
 
 
 void check_status(int8_t code, const char *label) {
@@ -49,13 +50,27 @@ nrf_drv_spi_config_t spi_config = {
   .bit_order = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST
 };
 
+// uncomment to talk to Pixy over the I2C bus shared with the IMU instead of
+// SPI, which leaves the SPI bus free for the SD card
+//#define PIXY_USE_I2C
+
+// Run the control loop at 100 Hz, acting on predicted positions when no new
+// camera frame is ready (us)
+#define CONTROL_PERIOD_US 10000
+
+// Report loop timing after this many steps (10 s)
+#define STATS_PERIOD_STEPS 1000
+
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
 
 drv_pixy2_spi_t *pixy;
-pid_loop_t rotateLoop, translateLoop;
-int8_t focusIndex;
-KobukiSensors_t sensors = {0};
+tracker_t tracker;
+// rotate and translate loops, updated together
+#define ROTATE 0
+#define TRANSLATE 1
+pid_loop_t loops[2];
+int16_t focusIndex = -1;
 
 
 void setup() {
@@ -72,83 +87,97 @@ void setup() {
   lsm9ds1_init(&twi_mngr_instance);
   printf("IMU initialized!\n");
 
+#ifdef PIXY_USE_I2C
+  pixy_link_t link = pixy_link_i2c(&twi_mngr_instance, PIXY_I2C_DEFAULT_ADDR);
+#else
   // initialize spi master
   APP_ERROR_CHECK(nrf_drv_spi_init(&spi_instance, &spi_config, NULL, NULL));
+  pixy_link_t link = pixy_link_spi(&spi_instance);
+#endif
 
   // We need to initialize the pixy object 
-  check_status(pixy_init(&pixy, &spi_instance), "initialize");
-  print_version(pixy->version);
+  check_status(pixy_init_link(&pixy, &link), "initialize");
+  print_version(&pixy->version);
 
   // Use color connected components program for the pan tilt to track 
   check_status(changeProg(pixy, PIXY_PROG_COLOR_CODE), "change program");
 
   check_status(getResolution(pixy), "resolution");
 
-  pid_init(&rotateLoop, 1, 0, 0, false);
-  pid_init(&translateLoop, 1, 0, 0, false);
+  // learn the camera frame rate once instead of asking every loop
+  check_status(pixy_frame_sync_init(pixy), "frame sync");
+  if (pixy->m_framePeriod > 0)
+    printf("FPS %lu\n", 1000000/pixy->m_framePeriod);
+
+  // objects accelerate at up to a few hundred pixels/s^2, and Pixy's block
+  // centres jitter by a pixel or two
+  tracker_init(&tracker, 300.0f*300.0f, 2.0f);
+
+  pid_config_t loop_config = {
+    .kp = PID_GAIN(1),
+    .ki = 0,
+    .kd = 0,
+    .kt = 0,
+    .min = -100,
+    .max = 100,
+    .deadband = 0,
+    .d_filter_shift = 2,
+  };
+  pid_init(&loops[ROTATE], &loop_config);
+  pid_init(&loops[TRANSLATE], &loop_config);
 
   kobukiInit();
+  // drive commands go out over this UART. Nothing here reads the Kobuki's
+  // sensors, whose poll would block each step until the next 50 Hz packet
+  kobukiUARTInit();
 }
 
 
-// Take the biggest block (blocks[0]) that's been around for at least 30 frames (1/2 second)
-// and return its index, otherwise return -1
+// Take the biggest block (blocks[0]) and return its tracking index, otherwise
+// return -1
 int16_t acquireBlock() {
   if (pixy->numBlocks > 0)// && pixy->blocks[0].m_age > 50)
-    return pixy->blocks[0].m_signature;
+    return pixy->blocks[0].m_index;
 
   return -1;
 }
 
-// Find the block with the given index.  In other words, find the same object in the current
-// frame -- not the biggest object, but he object we've locked onto in acquireBlock()
-// If it's not in the current frame, return NULL
-block_t *trackBlock(int8_t index) {
-  uint8_t i;
-
-  for (i=0; i < pixy->numBlocks; i++) {
-    if (pixy->blocks[i].m_signature == index)
-      return &pixy->blocks[i];
-  }
-
-  return NULL;
-}
-
 
 void loop() {  
-  printf("FPS %d\n", getFPS(pixy));
+  uint32_t now = control_loop_now();
 
-  // get active blocks from Pixy
-  int8_t blocks = getBlocks(pixy, false, CCC_SIG_ALL, CCC_MAX_BLOCKS);
+  // get active blocks from Pixy once a new frame is ready and feed them to the
+  // tracker. Between frames we keep acting on predicted positions.
+  int8_t blocks = pixy_poll_blocks(pixy, now, CCC_SIG_ALL, CCC_MAX_BLOCKS);
+  if (blocks >= 0)
+    tracker_update(&tracker, pixy_blocks(pixy));
+  else if (blocks != PIXY_RESULT_BUSY)
+    check_status(blocks, "blocks");
 
-  check_status(blocks, "blocks");
-  if (blocks <= 0)
-    goto stop;
-  
-  block_t *block;
+  const track_t *track = NULL;
   if (focusIndex == -1) { // search....
-    printf("Searching for block...\n");
     focusIndex = acquireBlock();
     if (focusIndex >= 0)
       printf("Found block!\n");
   }
-  if (focusIndex != -1) // If we've found a block, find it, track it
-     block = trackBlock(focusIndex);
+  if (focusIndex != -1) // If we've found a block, follow its track
+    track = tracker_find(&tracker, focusIndex);
 
   // If we're able to track it, move motors
-  if (block != NULL) {          
-    // calculate pan and tilt "errors" with respect to first object (blocks[0]), 
-    // which is the biggest object (they are sorted by size).  
-    int32_t panOffset = (int32_t)pixy->frameWidth/2 - (int32_t)block->m_x;
-    int32_t tiltOffset = (int32_t)block->m_y - (int32_t)pixy->frameHeight/2;  
+  track_estimate_t target;
+  if (track != NULL && tracker_predict(track, now, &target)) {
+    // calculate the pan "error" with respect to where the object should
+    // be right now
+    int32_t panOffset = (int32_t)pixy->frameWidth/2 - (int32_t)target.x;
 
-    // update loops
-    pid_update(&rotateLoop, panOffset);
-    pid_update(&translateLoop, -tiltOffset);
+    // update loops, driving the object to the centre of the frame
+    int32_t setpoints[2] = {pixy->frameWidth/2, pixy->frameHeight/2};
+    int32_t measurements[2] = {(int32_t)target.x, (int32_t)target.y};
+    pid_update_batch(loops, 2, setpoints, measurements, now);
 
     // calculate left and right wheel velocities based on rotation and translation velocities
-    int8_t left = -rotateLoop.m_command + translateLoop.m_command;
-    int8_t right = rotateLoop.m_command + translateLoop.m_command;
+    int8_t left = -loops[ROTATE].command + loops[TRANSLATE].command;
+    int8_t right = loops[ROTATE].command + loops[TRANSLATE].command;
 
     // set wheel speeds
     if (panOffset < -20)
@@ -158,33 +187,43 @@ void loop() {
     else
       kobukiDriveDirect(0, 0);
 
-    printf("sig: %u area: %u age: %u offset: %ld numBlocks: %d\n", block->m_signature, block->m_width * block->m_height, block->m_age, panOffset, pixy->numBlocks);
+    // report once per camera frame, unless the loop is already running late
+    if (blocks >= 0 && !control_loop_degraded())
+      printf("sig: %u area: %ld age: %u offset: %ld vx: %ld numBlocks: %d\n", track->signature, (int32_t)(target.width * target.height), track->age, panOffset, (int32_t)target.vx, pixy->numBlocks);
 #if 0 // for debugging
-    printf("%ld %ld %ld %ld", rotateLoop.m_command, translateLoop.m_command, left, right);
+    printf("%ld %ld %d %d", loops[ROTATE].command, loops[TRANSLATE].command, left, right);
 #endif
 
   // no object detected, go into reset state
-  } else {
-    goto stop;
-  }
-  return;
-
-  stop:
-    pid_reset(&rotateLoop);
-    pid_reset(&translateLoop);
+  } else if (focusIndex != -1 || blocks >= 0) {
+    pid_reset(&loops[ROTATE]);
+    pid_reset(&loops[TRANSLATE]);
     kobukiDriveDirect(0, 0);
     focusIndex = -1;
+  }
 }
 
 
 
+// One fixed-rate step: track and steer
+void step() {
+  uint32_t steps = control_loop_stats()->steps;
+  if (steps > 0 && steps % STATS_PERIOD_STEPS == 0)
+    control_loop_print_stats();
+
+  loop();
+}
+
+
 int main(void) {
   setup();
 
-  while (1) {
-    // read sensors from robot
-    kobukiSensorPoll(&sensors);
-    loop();
-    nrf_delay_ms(200);
-  }
+  control_loop_config_t loop_config = {
+    .period_us = CONTROL_PERIOD_US,
+    .budget_us = 0,
+    .step = step,
+    .degraded = NULL,
+  };
+  APP_ERROR_CHECK(control_loop_init(&loop_config));
+  control_loop_run();
 }
\ No newline at end of file
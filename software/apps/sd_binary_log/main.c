@@ -0,0 +1,201 @@
+// SD Binary Log app
+//
+// Logs every Kobuki sensor frame and an IMU reading to the SD card at the
+// 50 Hz the Kobuki sends frames, as binary records in 512 byte blocks
+// instead of lines of text. Each step is encoded with the telemetry codec,
+// as changes from the step before. Full blocks are written between control
+// steps, so the card never holds up a step. Press a Kobuki button to finish
+// the log.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "nrf.h"
+#include "nrf_sdh.h"
+#include "nrfx_gpiote.h"
+#include "nrf_gpio.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+#include "nrf_log_default_backends.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrf_soc.h"
+
+#include "buckler.h"
+#include "control_loop.h"
+#include "kobukiActuator.h"
+#include "kobukiSensorPoll.h"
+#include "kobukiSensorTypes.h"
+#include "kobukiUtilities.h"
+#include "lsm9ds1.h"
+#include "rtc_time.h"
+#include "sd_log.h"
+#include "sd_log_fatfs.h"
+#include "telemetry.h"
+#include "telemetry_kobuki.h"
+
+// I2C manager
+NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
+
+#define CONTROL_PERIOD_US 20000
+
+// Room for an hour of records
+#define LOG_RECORDS (3600 * (1000000 / CONTROL_PERIOD_US))
+
+// Bytes a record takes in the log on average, with its length byte. Steps
+// encode to about 26 bytes on telemetry_tool's synthetic drive, and a full
+// log stops recording.
+#define LOG_RECORD_BYTES 32
+
+// Print log statistics every 10 s
+#define STATS_PERIOD_STEPS 500
+
+static telemetry_codec_t codec;
+static bool logging = true;
+
+static void print_stats(void) {
+  const sd_log_stats_t* stats = sd_log_stats();
+  printf("log: %lu records, %lu dropped, %lu blocks, %lu write errors%s\n",
+      stats->records, stats->dropped, stats->blocks, stats->write_errors,
+      stats->full ? ", full" : "");
+}
+
+static int16_t clamp16(float value) {
+  if (value > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (value < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)lroundf(value);
+}
+
+static void control_step(void) {
+  telemetry_kobuki_step_t record = {
+    .time_ms = (uint32_t)(rtc_time_us() / 1000),
+  };
+  kobukiSensorPoll(&record.sensors);
+  lsm9ds1_measurement_t accel = lsm9ds1_read_accelerometer();
+  lsm9ds1_measurement_t gyro = lsm9ds1_read_gyro();
+  record.accel_mg[0] = clamp16(accel.x_axis * 1000);
+  record.accel_mg[1] = clamp16(accel.y_axis * 1000);
+  record.accel_mg[2] = clamp16(accel.z_axis * 1000);
+  record.gyro_ddps[0] = clamp16(gyro.x_axis * 10);
+  record.gyro_ddps[1] = clamp16(gyro.y_axis * 10);
+  record.gyro_ddps[2] = clamp16(gyro.z_axis * 10);
+
+  if (!logging) {
+    return;
+  }
+  uint8_t encoded[SD_LOG_MAX_VARYING_SIZE];
+  uint16_t len = telemetry_codec_encode(&codec, &record, encoded);
+  if (!sd_log_record_varying(encoded, len)) {
+    // the records after a drop only decode from a keyframe, so send one next
+    telemetry_codec_reset(&codec);
+  }
+
+  uint32_t steps = control_loop_stats()->steps;
+  if (steps > 0 && steps % STATS_PERIOD_STEPS == 0) {
+    print_stats();
+  }
+
+  if (is_button_pressed(&record.sensors)) {
+    logging = false;
+    ret_code_t error_code = sd_log_flush();
+    printf("Log finished: %s\n", error_code == NRF_SUCCESS ? "ok" : "write failed");
+    print_stats();
+    nrf_gpio_pin_clear(BUCKLER_LED0);
+  }
+}
+
+int main(void) {
+  ret_code_t error_code = NRF_SUCCESS;
+
+  // initialize RTT library
+  error_code = NRF_LOG_INIT(NULL);
+  APP_ERROR_CHECK(error_code);
+  NRF_LOG_DEFAULT_BACKENDS_INIT();
+  printf("Log initialized!\n");
+
+  // Enable SoftDevice (used to get RTC running)
+  nrf_sdh_enable_request();
+
+  // Initialize GPIO driver
+  if (!nrfx_gpiote_is_init()) {
+    error_code = nrfx_gpiote_init();
+  }
+  APP_ERROR_CHECK(error_code);
+
+  // Configure GPIOs
+  nrf_gpio_cfg_output(BUCKLER_SD_ENABLE);
+  nrf_gpio_cfg_output(BUCKLER_SD_CS);
+  nrf_gpio_cfg_output(BUCKLER_SD_MOSI);
+  nrf_gpio_cfg_output(BUCKLER_SD_SCLK);
+  nrf_gpio_cfg_input(BUCKLER_SD_MISO, NRF_GPIO_PIN_NOPULL);
+
+  nrf_gpio_pin_set(BUCKLER_SD_ENABLE);
+  nrf_gpio_pin_set(BUCKLER_SD_CS);
+
+  nrf_gpio_cfg_output(BUCKLER_LED0);
+  nrf_gpio_pin_set(BUCKLER_LED0);
+
+  // Create the log file at full size, with a new id so that blocks left in
+  // its space by an earlier log aren't read as part of this one
+  uint32_t log_id;
+  do {
+    error_code = sd_rand_application_vector_get((uint8_t*)&log_id, sizeof(log_id));
+  } while (error_code == NRF_ERROR_SOC_RAND_NOT_ENOUGH_VALUES);
+  APP_ERROR_CHECK(error_code);
+  sd_log_config_t log_config = {
+    .record_size = 0,
+    .blocks = 1 + LOG_RECORDS * LOG_RECORD_BYTES / SD_LOG_MAX_RECORD_SIZE + 1,
+    .backend = sd_log_fatfs_backend("kobuki.bin"),
+    .name = "kobuki sensors + imu",
+    .log_id = log_id,
+  };
+  error_code = sd_log_init(&log_config);
+  APP_ERROR_CHECK(error_code);
+  printf("Log file created, %lu blocks\n", log_config.blocks);
+
+  // steps are encoded as changes, with a keyframe every 5 s to resync from
+  APP_ERROR_CHECK_BOOL(telemetry_codec_max_size(&telemetry_kobuki_step_schema) <= SD_LOG_MAX_VARYING_SIZE);
+  telemetry_codec_init(&codec, &telemetry_kobuki_step_schema, TELEMETRY_KEYFRAME_INTERVAL);
+
+  // initialize i2c master (two wire interface)
+  nrf_drv_twi_config_t i2c_config = NRF_DRV_TWI_DEFAULT_CONFIG;
+  i2c_config.scl = BUCKLER_SENSORS_SCL;
+  i2c_config.sda = BUCKLER_SENSORS_SDA;
+  i2c_config.frequency = NRF_TWIM_FREQ_100K;
+  error_code = nrf_twi_mngr_init(&twi_mngr_instance, &i2c_config);
+  APP_ERROR_CHECK(error_code);
+  lsm9ds1_init(&twi_mngr_instance);
+  printf("IMU initialized!\n");
+
+  // timebase for record times
+  error_code = rtc_time_init();
+  APP_ERROR_CHECK(error_code);
+
+  // initialize Kobuki
+  kobukiInit();
+  printf("Kobuki initialized!\n");
+
+  control_loop_config_t loop_config = {
+    .period_us = CONTROL_PERIOD_US,
+    .budget_us = 0,
+    .step = control_step,
+    .degraded = NULL,
+  };
+  error_code = control_loop_init(&loop_config);
+  APP_ERROR_CHECK(error_code);
+
+  // steps record, and the time between them goes to the card
+  while (1) {
+    control_loop_poll();
+    if (logging) {
+      sd_log_process();
+    }
+    nrf_pwr_mgmt_run();
+  }
+}
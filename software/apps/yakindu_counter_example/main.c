@@ -19,7 +19,24 @@
 
 #include "buckler.h"
 #include "point.h"
+#include "statechart_timer.h"
 #include "Test_geometry_sc.h"
+#include "virtual_timer.h"
+
+// Raise a tick this often
+#define TICK_PERIOD_MS 1000
+
+// the tick is an in-event rather than a time event, so it needs no event id
+static void raise_tick(void* handle, void* evid) {
+  test_geometry_scIface_raise_tick(handle);
+}
+
+static void print_status(Test_geometry_sc* sc_handle, uint32_t i) {
+  printf("Iteration: %lu\n", i);
+  printf("Count: %d\n", test_geometry_scIface_get_count(sc_handle));
+  Point newpoint = test_geometry_scIface_get_pointA(sc_handle);
+  printf("Point.x: %d\tPoint.y: %d\n", newpoint.x, newpoint.y);
+}
 
 int main(void) {
   ret_code_t error_code = NRF_SUCCESS;
@@ -30,6 +47,11 @@ int main(void) {
   NRF_LOG_DEFAULT_BACKENDS_INIT();
   printf("Log initialized!\n");
 
+  // initialize power management and timers
+  error_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(error_code);
+  virtual_timer_init();
+
   // start statechart
   Test_geometry_sc sc_handle;
   test_geometry_sc_init(&sc_handle);
@@ -43,21 +65,22 @@ int main(void) {
   };
   test_geometry_scIface_set_pointA(&sc_handle, point);
 
-  // loop forever
+  // raise a tick every second from the timer service
+  error_code = statechart_timer_set(&sc_handle, NULL, TICK_PERIOD_MS, true, raise_tick);
+  APP_ERROR_CHECK(error_code);
+
+  // loop forever, sleeping until a tick is due
   uint32_t i = 0;
+  print_status(&sc_handle, i++);
   while (1) {
-    // print status
-    printf("Iteration: %lu\n", i++);
-    printf("Count: %d\n", test_geometry_scIface_get_count(&sc_handle));
-    Point newpoint = test_geometry_scIface_get_pointA(&sc_handle);
-    printf("Point.x: %d\tPoint.y: %d\n", newpoint.x, newpoint.y);
-    nrf_delay_ms(1000);
-
-    // trigger a tick event on next `runCycle`
-    test_geometry_scIface_raise_tick(&sc_handle);
+    if (statechart_timer_dispatch() == 0) {
+      nrf_pwr_mgmt_run();
+      continue;
+    }
 
-    // iterate statechart
+    // iterate statechart with the tick raised
     test_geometry_sc_runCycle(&sc_handle);
+    print_status(&sc_handle, i++);
   }
 }
 
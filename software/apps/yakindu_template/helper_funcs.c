@@ -31,6 +31,7 @@
 #include "kobukiSensorTypes.h"
 #include "kobukiUtilities.h"
 #include "lsm9ds1.h"
+#include "numfmt.h"
 
 extern KobukiSensors_t sensors;
 
@@ -40,30 +41,6 @@ uint16_t read_encoder(){
   return sensors.leftWheelEncoder;
 }
 
-float update_dist(float dist, uint16_t prev_encoder, bool is_forward){
-  const float CONVERSION = 0.00008529;
-  uint16_t current_encoder = read_encoder();
-  float result = 0.0;
-  if (!is_forward){
-    uint16_t temp = current_encoder;
-    current_encoder = prev_encoder;
-    prev_encoder = temp;
-  }
-  if (current_encoder >= prev_encoder) {
-    // normal case
-    result = (float)current_encoder - (float)prev_encoder;
-  } else {
-    // account for wrap
-    result = (float)current_encoder + (0xFFFF - (float)prev_encoder);
-  }
-  result = result * CONVERSION;
-  if (result> 1.0 || result< -1.0){
-    return dist;
-  }else{
-    return dist +result;
-  }
-}
-
 void drive_kobuki(uint16_t left_wheel, uint16_t right_wheel){
   // Your code here
 }
@@ -118,13 +95,13 @@ float read_gyro(){
 
 void print_angle(float angle){
   char buf[16];
-  snprintf(buf, 16, "%f", angle);
+  numfmt_float(buf, sizeof(buf), angle, 6, 0);
   display_write(buf, DISPLAY_LINE_1);
 }
 
 void print_dist(float dist){
   char buf[16];
-  snprintf(buf, 16, "%f", dist);
+  numfmt_float(buf, sizeof(buf), dist, 6, 0);
   display_write(buf, DISPLAY_LINE_1);
 }
 
@@ -175,7 +152,3 @@ float read_tilt_psi(void){
   return 0.0;
 }
 
-float get_abs(float var){
-  return fabs(var);
-}
-
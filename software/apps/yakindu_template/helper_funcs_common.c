@@ -0,0 +1,37 @@
+// Helpers from helper_funcs.h with no hardware behind them
+//
+// Built into both the robot app and the statechart simulator in sim/, so the
+// chart sees the same arithmetic in both. Encoder readings come from whichever
+// read_encoder() the build provides.
+
+#include <math.h>
+
+#include "helper_funcs.h"
+
+float update_dist(float dist, uint16_t prev_encoder, bool is_forward){
+  const float CONVERSION = 0.00008529;
+  uint16_t current_encoder = read_encoder();
+  float result = 0.0;
+  if (!is_forward){
+    uint16_t temp = current_encoder;
+    current_encoder = prev_encoder;
+    prev_encoder = temp;
+  }
+  if (current_encoder >= prev_encoder) {
+    // normal case
+    result = (float)current_encoder - (float)prev_encoder;
+  } else {
+    // account for wrap
+    result = (float)current_encoder + (0xFFFF - (float)prev_encoder);
+  }
+  result = result * CONVERSION;
+  if (result> 1.0 || result< -1.0){
+    return dist;
+  }else{
+    return dist +result;
+  }
+}
+
+float get_abs(float var){
+  return fabs(var);
+}
@@ -25,6 +25,8 @@
 #include "kobukiSensorTypes.h"
 #include "kobukiUtilities.h"
 #include "lsm9ds1.h"
+#include "statechart_timer.h"
+#include "virtual_timer.h"
 
 #include "states.h"
 #include "helper_funcs.h"
@@ -33,9 +35,22 @@
 // I2C manager
 NRF_TWI_MNGR_DEF(twi_mngr_instance, 5, 0);
 
+// The chart is @CycleBased(200), so it runs a cycle every 200 ms, plus
+// whenever one of its own time events is raised
+#define CYCLE_PERIOD_MS 200
+
 // global variables
 KobukiSensors_t sensors = {0};
 
+// event id for the cycle timer, distinct from any generated time event
+static uint8_t cycle_event;
+
+static void raise_cycle(void* handle, void* evid) {
+  // nothing to raise, the cycle itself is the event
+}
+
+// Time events in the chart are served by statechart_timer too, see README
+
 int main(void) {
   ret_code_t error_code = NRF_SUCCESS;
 
@@ -83,6 +98,11 @@ int main(void) {
   kobukiInit();
   printf("Kobuki initialized!\n");
 
+  // initialize power management and timers for statechart time events
+  error_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(error_code);
+  virtual_timer_init();
+
   // initialize yakindu state machine
   // start statechart
   Robot_template sc_handle;
@@ -92,17 +112,18 @@ int main(void) {
   // intialize statechart variables
   // if needed
 
-  // loop forever, running state machine
-  while (1) {
-    // read sensors from robot
-    kobukiSensorPoll(&sensors);
+  error_code = statechart_timer_set(&sc_handle, &cycle_event, CYCLE_PERIOD_MS, true, raise_cycle);
+  APP_ERROR_CHECK(error_code);
 
-    // delay before continuing
-    // Note: removing this delay will make responses quicker, but will result
-    //  in printf's in this loop breaking JTAG
-    nrf_delay_ms(1);
+  // loop forever, sleeping until the cycle or a time event is due
+  while (1) {
+    if (statechart_timer_dispatch() == 0) {
+      nrf_pwr_mgmt_run();
+      continue;
+    }
 
-    // iterate statechart
+    // read sensors from robot, then iterate statechart
+    kobukiSensorPoll(&sensors);
     robot_template_runCycle(&sc_handle);
   }
 }
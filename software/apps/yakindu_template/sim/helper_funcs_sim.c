@@ -0,0 +1,116 @@
+// Host implementation of helper_funcs.h
+//
+// Stands in for ../helper_funcs.c, reading sensors from and driving the
+// simulated world instead of the Kobuki, IMU and display. Display output is
+// kept in display_lines so the harness can print it when asked. The helpers
+// with no hardware behind them come from ../helper_funcs_common.c, as on the
+// robot.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "helper_funcs.h"
+#include "states.h"
+#include "world.h"
+
+char display_lines[2][17];
+
+static bool gyro_running;
+static double gyro_start;
+
+static void display_write(const char* text, int line) {
+  snprintf(display_lines[line], sizeof(display_lines[line]), "%s", text);
+}
+
+uint16_t read_encoder(){
+  return world_left_encoder();
+}
+
+void drive_kobuki(uint16_t left_wheel, uint16_t right_wheel){
+  // the robot takes signed speeds through the same unsigned arguments
+  world.left_speed = (int16_t)left_wheel;
+  world.right_speed = (int16_t)right_wheel;
+}
+
+void stop_kobuki(){
+  world.left_speed = 0;
+  world.right_speed = 0;
+}
+
+// the arena floor has no edges
+bool is_left_cliff(){
+  return false;
+}
+
+bool is_center_cliff(){
+  return false;
+}
+
+bool is_right_cliff(){
+  return false;
+}
+
+bool is_left_bumper(){
+  return world.bump_left;
+}
+
+bool is_right_bumper(){
+  return world.bump_right;
+}
+
+bool is_center_bumper(){
+  return world.bump_center;
+}
+
+bool is_button_press(){
+  return world.button;
+}
+
+void start_gyro(){
+  gyro_running = true;
+  gyro_start = world.rotation;
+}
+
+void stop_gyro(){
+  gyro_running = false;
+}
+
+// degrees turned since start_gyro(), counter-clockwise positive
+float read_gyro(){
+  if (!gyro_running) {
+    return 0;
+  }
+  return world.rotation - gyro_start;
+}
+
+void print_angle(float angle){
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%f", angle);
+  display_write(buf, 1);
+}
+
+void print_dist(float dist){
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%f", dist);
+  display_write(buf, 1);
+}
+
+void print_state(states current_state){
+  static const char* names[] = {"OFF", "DRIVING", "BACKUP", "RIGHT", "LEFT", "REORIENT"};
+  display_write(names[current_state], 0);
+}
+
+void print_turn(turns current_turn){
+  static const char* names[] = {"LEFT TURN", "RIGHT TURN", "STRAIGHT"};
+  display_write(names[current_turn], 0);
+}
+
+// the simulated floor is level
+float read_tilt_theta(void){
+  return 0.0;
+}
+
+float read_tilt_psi(void){
+  return 0.0;
+}
@@ -0,0 +1,177 @@
+// Host harness for the Yakindu template statechart
+//
+// Runs the generated robot_template_runCycle() against the simulated world
+// as fast as the host allows, one cycle per 200 ms of simulated time as the
+// chart's @CycleBased(200) asks. At the end it reports which states were
+// active, which transitions between them were taken, and how long cycles
+// took on the host.
+//
+// usage: sim [seconds] [seed]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Robot_template.h"
+#include "world.h"
+
+#define CYCLE_PERIOD_S 0.2f
+
+// World steps per statechart cycle
+#define STEPS_PER_CYCLE 20
+
+// Seconds between button presses are random up to this
+#define MAX_PRESS_INTERVAL_S 600
+
+// States to cover, update after regenerating the chart
+static const struct {
+  Robot_templateStates state;
+  const char* name;
+} states[] = {
+  {Robot_template_main_region_StateA, "StateA"},
+};
+#define NUM_STATES (sizeof(states) / sizeof(states[0]))
+
+#define MAX_TRANSITIONS 64
+
+// a change in the set of active states between two cycles
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+  uint32_t count;
+} transition_t;
+
+static transition_t transitions[MAX_TRANSITIONS];
+static uint16_t num_transitions;
+static uint32_t state_cycles[NUM_STATES];
+
+extern char display_lines[2][17];
+
+// Bit per active state in the states table
+static uint32_t active_states(const Robot_template* handle) {
+  uint32_t active = 0;
+  for (uint32_t i = 0; i < NUM_STATES; i++) {
+    if (robot_template_isStateActive(handle, states[i].state)) {
+      active |= 1UL << i;
+    }
+  }
+  return active;
+}
+
+static void record_transition(uint32_t from, uint32_t to) {
+  for (uint16_t i = 0; i < num_transitions; i++) {
+    if (transitions[i].from == from && transitions[i].to == to) {
+      transitions[i].count++;
+      return;
+    }
+  }
+  if (num_transitions < MAX_TRANSITIONS) {
+    transitions[num_transitions++] = (transition_t){from, to, 1};
+  }
+}
+
+static void print_states(uint32_t active) {
+  if (active == 0) {
+    printf("(none)");
+  }
+  for (uint32_t i = 0; i < NUM_STATES; i++) {
+    if (active & (1UL << i)) {
+      printf("%s%s", states[i].name, (active >> (i + 1)) ? "+" : "");
+    }
+  }
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  double duration = argc > 1 ? atof(argv[1]) : 3600;
+  srand(argc > 2 ? atoi(argv[2]) : 1);
+
+  world_init();
+
+  Robot_template sc_handle;
+  robot_template_init(&sc_handle);
+  robot_template_enter(&sc_handle);
+
+  uint64_t start = now_ns();
+  uint64_t cycles = 0;
+  uint64_t total_ns = 0;
+  uint64_t min_ns = UINT64_MAX;
+  uint64_t max_ns = 0;
+
+  // press the button a second in to start the robot, then at random
+  double next_press = 1.0;
+  uint32_t prev = 0;
+  record_transition(0, active_states(&sc_handle));
+
+  while (world.time < duration) {
+    for (int i = 0; i < STEPS_PER_CYCLE; i++) {
+      world_step(CYCLE_PERIOD_S / STEPS_PER_CYCLE);
+    }
+    world.button = world.time >= next_press;
+    if (world.button) {
+      next_press = world.time + 1 + rand() % MAX_PRESS_INTERVAL_S;
+    }
+
+    prev = active_states(&sc_handle);
+    uint64_t cycle_start = now_ns();
+    robot_template_runCycle(&sc_handle);
+    uint64_t ns = now_ns() - cycle_start;
+
+    cycles++;
+    total_ns += ns;
+    if (ns < min_ns) {
+      min_ns = ns;
+    }
+    if (ns > max_ns) {
+      max_ns = ns;
+    }
+
+    uint32_t active = active_states(&sc_handle);
+    if (active != prev) {
+      record_transition(prev, active);
+    }
+    for (uint32_t i = 0; i < NUM_STATES; i++) {
+      if (active & (1UL << i)) {
+        state_cycles[i]++;
+      }
+    }
+  }
+
+  double wall = (now_ns() - start) / 1e9;
+  printf("simulated %.0f s in %.3f s (%.0fx real time)\n", world.time, wall, world.time / wall);
+  printf("robot at (%.2f, %.2f) heading %.0f, display \"%s\" \"%s\"\n",
+      world.x, world.y, world.heading, display_lines[0], display_lines[1]);
+
+  printf("\n%llu cycles, runCycle min %llu ns, mean %llu ns, max %llu ns\n",
+      (unsigned long long)cycles, (unsigned long long)(cycles ? min_ns : 0),
+      (unsigned long long)(cycles ? total_ns / cycles : 0), (unsigned long long)max_ns);
+
+  uint32_t covered = 0;
+  for (uint32_t i = 0; i < NUM_STATES; i++) {
+    covered += state_cycles[i] > 0;
+  }
+  printf("\nstates active: %lu of %lu\n", (unsigned long)covered, (unsigned long)NUM_STATES);
+  for (uint32_t i = 0; i < NUM_STATES; i++) {
+    printf("  %-20s %10lu cycles%s\n", states[i].name, (unsigned long)state_cycles[i],
+        state_cycles[i] ? "" : "  NEVER ACTIVE");
+  }
+
+  printf("\ntransitions taken: %u%s\n", num_transitions,
+      num_transitions == MAX_TRANSITIONS ? " (table full, some not shown)" : "");
+  for (uint16_t i = 0; i < num_transitions; i++) {
+    printf("  ");
+    print_states(transitions[i].from);
+    printf(" -> ");
+    print_states(transitions[i].to);
+    printf("  x%lu\n", (unsigned long)transitions[i].count);
+  }
+
+  return 0;
+}
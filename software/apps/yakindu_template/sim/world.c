@@ -0,0 +1,79 @@
+// Simulated world for the Yakindu template
+//
+// The robot can't move into a wall. Touching one presses the bumper that
+// faces it: center within 30 degrees of the heading, left or right beyond.
+
+#include <math.h>
+
+#include "world.h"
+
+#define DEG_PER_RAD (180.0f / (float)M_PI)
+
+world_t world;
+
+void world_init(void) {
+  world = (world_t){0};
+}
+
+static float wrap_degrees(float angle) {
+  while (angle > 180) {
+    angle -= 360;
+  }
+  while (angle <= -180) {
+    angle += 360;
+  }
+  return angle;
+}
+
+// Press the bumper facing a wall whose outward normal points at normal
+// degrees, if the robot is driving into it
+static void touch_wall(float normal) {
+  float bearing = wrap_degrees(normal - world.heading);
+  if (bearing > -30 && bearing < 30) {
+    world.bump_center = true;
+  } else if (bearing >= 30 && bearing < 90) {
+    world.bump_left = true;
+  } else if (bearing <= -30 && bearing > -90) {
+    world.bump_right = true;
+  }
+}
+
+void world_step(float dt) {
+  float left = world.left_speed / 1000.0f * dt;
+  float right = world.right_speed / 1000.0f * dt;
+  world.left_travel += left;
+  world.right_travel += right;
+
+  // move along the arc, using the heading at its midpoint
+  float turn = (right - left) / WORLD_WHEEL_BASE;
+  float mid = world.heading / DEG_PER_RAD + turn / 2;
+  float forward = (left + right) / 2;
+  world.x += forward * cosf(mid);
+  world.y += forward * sinf(mid);
+  world.heading = wrap_degrees(world.heading + turn * DEG_PER_RAD);
+  world.rotation += turn * DEG_PER_RAD;
+
+  // keep out of the walls
+  float limit = WORLD_ARENA_SIZE / 2 - WORLD_ROBOT_RADIUS;
+  world.bump_left = world.bump_center = world.bump_right = false;
+  if (world.x >= limit) {
+    world.x = limit;
+    touch_wall(0);
+  } else if (world.x <= -limit) {
+    world.x = -limit;
+    touch_wall(180);
+  }
+  if (world.y >= limit) {
+    world.y = limit;
+    touch_wall(90);
+  } else if (world.y <= -limit) {
+    world.y = -limit;
+    touch_wall(-90);
+  }
+
+  world.time += dt;
+}
+
+uint16_t world_left_encoder(void) {
+  return (uint16_t)lround(world.left_travel / WORLD_METERS_PER_TICK);
+}
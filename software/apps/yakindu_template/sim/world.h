@@ -0,0 +1,55 @@
+// Simulated world for the Yakindu template
+//
+// A Kobuki in a walled square arena, modelled as a differential drive with
+// perfect wheels. Positions are in meters, headings in degrees counter-
+// clockwise, the same sense as the IMU's z axis.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Kobuki geometry
+#define WORLD_WHEEL_BASE 0.230f // m
+#define WORLD_ROBOT_RADIUS 0.175f // m
+#define WORLD_METERS_PER_TICK 0.00008529f
+
+// Side of the square arena, centred on the origin (m)
+#define WORLD_ARENA_SIZE 3.0f
+
+typedef struct {
+  float x;
+  float y;
+  float heading;
+  double rotation; // heading without wrapping, as an integrating gyro sees it
+
+  // commanded wheel speeds (mm/s)
+  int16_t left_speed;
+  int16_t right_speed;
+
+  // total wheel travel (m), seen by the app as wrapping 16 bit encoder counts
+  double left_travel;
+  double right_travel;
+
+  // bumpers pressed against a wall
+  bool bump_left;
+  bool bump_center;
+  bool bump_right;
+
+  // button held down
+  bool button;
+
+  // seconds since world_init()
+  double time;
+} world_t;
+
+extern world_t world;
+
+// Put the robot at rest in the middle of the arena facing +x
+void world_init(void);
+
+// Advance the world by dt seconds
+void world_step(float dt);
+
+// Left wheel encoder count
+uint16_t world_left_encoder(void);
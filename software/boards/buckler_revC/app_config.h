@@ -51,6 +51,13 @@
 #define APP_TIMER_ENABLED 1
 #define APP_TIMER_KEEPS_RTC_ACTIVE 1
 
+// Buckler libraries that own a peripheral and its interrupt handler. Every
+// app builds with this file, and the display, BLE, teleop and scheduler
+// libraries call rtc_time and virtual_timer directly, so these stay on
+#define RTC_TIME_ENABLED 1      // RTC2
+#define VIRTUAL_TIMER_ENABLED 1 // TIMER4, needs RTC_TIME
+#define CONTROL_LOOP_ENABLED 1  // TIMER3
+
 #define NRFX_UARTE_ENABLED 1
 #define NRFX_UART_ENABLED 1
 #define UART_ENABLED 1
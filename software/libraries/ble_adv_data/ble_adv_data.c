@@ -0,0 +1,153 @@
+// Advertising data updater
+//
+// The posted payload is kept raw, so spotting an unchanged one is a memcmp,
+// and it is only encoded when an update actually goes out.
+
+#include <string.h>
+
+#include "ble_adv_data.h"
+#include "rtc_time.h"
+
+static uint8_t posted[BLE_ADV_DATA_MAX_LEN];
+static uint8_t posted_len;
+static bool pending;
+
+static uint32_t update_interval_ms;
+static bool advertise_name;
+static bool updated; // last_update_ms is valid
+static uint32_t last_update_ms;
+
+static ble_adv_data_stats_t stats;
+
+static ret_code_t update(void);
+
+static uint32_t now_ms(void) {
+  return (uint32_t)(rtc_time_us() / 1000);
+}
+
+ret_code_t ble_adv_data_init(uint32_t interval_ms, bool include_name) {
+  ret_code_t err_code = rtc_time_init();
+  if (err_code != NRF_SUCCESS) {
+    return err_code;
+  }
+
+  update_interval_ms = interval_ms;
+  advertise_name = include_name;
+  posted_len = 0;
+  pending = false;
+  updated = false;
+  stats = (ble_adv_data_stats_t){0};
+  return NRF_SUCCESS;
+}
+
+ret_code_t ble_adv_data_process(void) {
+  if (!pending) {
+    return NRF_SUCCESS;
+  }
+  uint32_t now = now_ms();
+  if (updated && now - last_update_ms < update_interval_ms) {
+    return NRF_SUCCESS;
+  }
+
+  ret_code_t err_code = update();
+  if (err_code != NRF_SUCCESS) {
+    stats.errors++;
+    return err_code;
+  }
+  stats.updates++;
+  pending = false;
+  updated = true;
+  last_update_ms = now;
+  return NRF_SUCCESS;
+}
+
+ret_code_t ble_adv_data_post(const uint8_t* data, uint8_t len) {
+  if (len > BLE_ADV_DATA_MAX_LEN) {
+    return NRF_ERROR_INVALID_LENGTH;
+  }
+  stats.posts++;
+
+  if (len != posted_len || memcmp(data, posted, len) != 0) {
+    memcpy(posted, data, len);
+    posted_len = len;
+    pending = true;
+    stats.changes++;
+  }
+
+  ret_code_t err_code = ble_adv_data_process();
+  if (err_code == NRF_SUCCESS && pending) {
+    stats.deferred++;
+  }
+  return err_code;
+}
+
+bool ble_adv_data_pending(void) {
+  return pending;
+}
+
+const ble_adv_data_stats_t* ble_adv_data_stats(void) {
+  return &stats;
+}
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include "ble.h"
+#include "ble_advdata.h"
+#include "ble_gap.h"
+
+// The S132 has a single advertising set, which simple_ble configured first
+static uint8_t adv_handle = 0;
+
+// The SoftDevice reads one while the other is filled in
+static uint8_t encoded[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t next_buffer;
+
+static ret_code_t update(void) {
+  ble_advdata_manuf_data_t manuf = {
+    .company_identifier = BLE_ADV_DATA_COMPANY_ID,
+    .data = {
+      .p_data = posted,
+      .size = posted_len,
+    },
+  };
+  ble_advdata_t advdata = {
+    .name_type = advertise_name ? BLE_ADVDATA_FULL_NAME : BLE_ADVDATA_NO_NAME,
+    .flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE,
+    .p_manuf_specific_data = &manuf,
+  };
+
+  uint16_t len = sizeof(encoded[next_buffer]);
+  ret_code_t err_code = ble_advdata_encode(&advdata, encoded[next_buffer], &len);
+  if (err_code == NRF_ERROR_DATA_SIZE && advertise_name) {
+    // no room for the name next to this payload
+    advdata.name_type = BLE_ADVDATA_NO_NAME;
+    len = sizeof(encoded[next_buffer]);
+    err_code = ble_advdata_encode(&advdata, encoded[next_buffer], &len);
+  }
+  if (err_code != NRF_SUCCESS) {
+    return err_code;
+  }
+
+  // new data without new parameters, so advertising carries on
+  ble_gap_adv_data_t adv_data = {
+    .adv_data = {
+      .p_data = encoded[next_buffer],
+      .len = len,
+    },
+  };
+  err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, NULL);
+  if (err_code != NRF_SUCCESS) {
+    return err_code;
+  }
+
+  next_buffer ^= 1;
+  return NRF_SUCCESS;
+}
+
+#else
+
+static ret_code_t update(void) {
+  return NRF_ERROR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Advertising data updater
+//
+// Lets an application publish manufacturer specific data in its
+// advertisements as often as it likes. A posted payload that matches the
+// last one costs a comparison. A changed payload is encoded and handed to
+// the SoftDevice at most once per update interval, which should be no
+// shorter than the advertising interval, since advertisements between two
+// updates would never carry the first one. A change that arrives too soon
+// is held and goes out with the next post or process call after the
+// interval, as the latest value.
+//
+// The SoftDevice keeps reading the advertising data while it advertises, so
+// it has to be given a different buffer for each update. Two encoded
+// buffers are swapped, which also means advertising never stops.
+//
+// The functions call into the SoftDevice, so they must be called from the
+// main loop, not from interrupt handlers. Advertising has to have been set
+// up with simple_ble first, e.g. with simple_ble_adv_only_name(), and the
+// updater then replaces its data. Apps built without a SoftDevice get
+// NRF_ERROR_NOT_SUPPORTED.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// Longest payload, what fits in 31 bytes after the flags and the
+// manufacturer data header
+#define BLE_ADV_DATA_MAX_LEN 24
+
+// Company identifier the payload is advertised under
+#ifndef BLE_ADV_DATA_COMPANY_ID
+#define BLE_ADV_DATA_COMPANY_ID 0x02E0
+#endif
+
+typedef struct {
+  uint32_t posts;    // payloads posted
+  uint32_t changes;  // posts that differed from the previous one
+  uint32_t updates;  // times the advertising data was replaced
+  uint32_t deferred; // changes held back by the update interval
+  uint32_t errors;   // updates the SoftDevice refused
+} ble_adv_data_stats_t;
+
+// interval_ms: shortest time between updates, usually the advertising
+// interval
+// include_name: also advertise the device name when there is room for it
+ret_code_t ble_adv_data_init(uint32_t interval_ms, bool include_name);
+
+// Publish a payload of up to BLE_ADV_DATA_MAX_LEN bytes
+//
+// Returns NRF_ERROR_INVALID_LENGTH if it is too long, or the SoftDevice's
+// error if an update was due and failed. The payload stays pending after a
+// failure and is tried again on the next call.
+ret_code_t ble_adv_data_post(const uint8_t* data, uint8_t len);
+
+// Apply a held back change if the interval has passed, for apps that stop
+// posting while a change is pending
+ret_code_t ble_adv_data_process(void);
+
+// A posted change hasn't reached the advertisements yet
+bool ble_adv_data_pending(void);
+
+const ble_adv_data_stats_t* ble_adv_data_stats(void);
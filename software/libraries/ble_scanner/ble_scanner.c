@@ -0,0 +1,279 @@
+// BLE advertisement scanner with a peer address filter
+//
+// The peer table uses linear probing, and removal shifts later entries of a
+// probe run back instead of leaving tombstones, so lookups never get slower
+// as peers come and go. The table is changed with interrupts disabled,
+// since reports are processed in the SoftDevice event handler.
+
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "ble_scanner.h"
+#include "rtc_time.h"
+
+#define TABLE_MASK (BLE_SCANNER_TABLE_SIZE - 1)
+#define TABLE_LIMIT (BLE_SCANNER_TABLE_SIZE / 4 * 3)
+
+typedef struct {
+  uint8_t addr[BLE_SCANNER_ADDR_LEN];
+  bool used;
+  bool seen;             // payload_hash and seen_ms are valid
+  uint32_t payload_hash;
+  uint32_t seen_ms;      // when the payload was last delivered
+} peer_t;
+
+static peer_t peers[BLE_SCANNER_TABLE_SIZE];
+static uint16_t peer_count;
+
+static ble_scanner_config_t scanner_config;
+static ble_scanner_stats_t stats;
+
+// Home slot of an address, mixing all six bytes since addresses from one
+// vendor share their top half
+static uint16_t slot_of(const uint8_t* addr) {
+  uint64_t key = 0;
+  memcpy(&key, addr, BLE_SCANNER_ADDR_LEN);
+  return (uint16_t)((key * 0x9E3779B97F4A7C15ULL) >> 48) & TABLE_MASK;
+}
+
+// Slot holding an address, or the empty slot ending its probe run
+static uint16_t find_slot(const uint8_t* addr) {
+  uint16_t slot = slot_of(addr);
+  while (peers[slot].used && memcmp(peers[slot].addr, addr, BLE_SCANNER_ADDR_LEN) != 0) {
+    slot = (slot + 1) & TABLE_MASK;
+  }
+  return slot;
+}
+
+// FNV-1a
+static uint32_t hash(const uint8_t* data, uint8_t len) {
+  uint32_t value = 2166136261UL;
+  for (uint8_t i = 0; i < len; i++) {
+    value = (value ^ data[i]) * 16777619UL;
+  }
+  return value;
+}
+
+static uint32_t now_ms(void) {
+  return (uint32_t)(rtc_time_us() / 1000);
+}
+
+ret_code_t ble_scanner_init(const ble_scanner_config_t* config) {
+  if (config->handler == NULL || config->window > config->interval) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  if (config->repeat_ms) {
+    ret_code_t err_code = rtc_time_init();
+    if (err_code != NRF_SUCCESS) {
+      return err_code;
+    }
+  }
+
+  CRITICAL_REGION_ENTER();
+  scanner_config = *config;
+  memset(peers, 0, sizeof(peers));
+  peer_count = 0;
+  stats = (ble_scanner_stats_t){0};
+  CRITICAL_REGION_EXIT();
+
+  return NRF_SUCCESS;
+}
+
+ret_code_t ble_scanner_add(const uint8_t addr[BLE_SCANNER_ADDR_LEN]) {
+  ret_code_t err_code = NRF_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  uint16_t slot = find_slot(addr);
+  if (!peers[slot].used) {
+    if (peer_count >= TABLE_LIMIT) {
+      err_code = NRF_ERROR_NO_MEM;
+    } else {
+      memcpy(peers[slot].addr, addr, BLE_SCANNER_ADDR_LEN);
+      peers[slot].used = true;
+      peers[slot].seen = false;
+      peer_count++;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  return err_code;
+}
+
+bool ble_scanner_remove(const uint8_t addr[BLE_SCANNER_ADDR_LEN]) {
+  bool removed = false;
+
+  CRITICAL_REGION_ENTER();
+  uint16_t hole = find_slot(addr);
+  if (peers[hole].used) {
+    removed = true;
+    peer_count--;
+
+    // move back any later entry of the run whose home is at or before the
+    // hole, so it stays reachable from its home slot
+    uint16_t slot = hole;
+    while (true) {
+      slot = (slot + 1) & TABLE_MASK;
+      if (!peers[slot].used) {
+        break;
+      }
+      uint16_t home = slot_of(peers[slot].addr);
+      if (((slot - home) & TABLE_MASK) >= ((slot - hole) & TABLE_MASK)) {
+        peers[hole] = peers[slot];
+        hole = slot;
+      }
+    }
+    peers[hole].used = false;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return removed;
+}
+
+uint16_t ble_scanner_count(void) {
+  return peer_count;
+}
+
+const ble_scanner_stats_t* ble_scanner_stats(void) {
+  return &stats;
+}
+
+typedef enum {
+  FIELD_FOUND,
+  FIELD_MISSING,
+  FIELD_MALFORMED,
+} field_result_t;
+
+static field_result_t find_field(const uint8_t* data, uint16_t len, uint8_t type,
+                                 const uint8_t** value, uint8_t* value_len) {
+  // each structure is a length byte, counting the type byte, then the type
+  uint16_t pos = 0;
+  while (pos < len) {
+    uint8_t field_len = data[pos];
+    if (field_len == 0) {
+      // the rest is padding
+      return FIELD_MISSING;
+    }
+    if (pos + 1 + field_len > len) {
+      return FIELD_MALFORMED;
+    }
+    if (data[pos + 1] == type) {
+      *value = &data[pos + 2];
+      *value_len = field_len - 1;
+      return FIELD_FOUND;
+    }
+    pos += 1 + field_len;
+  }
+  return FIELD_MISSING;
+}
+
+bool ble_scanner_find(const uint8_t* data, uint16_t len, uint8_t type,
+                      const uint8_t** value, uint8_t* value_len) {
+  return find_field(data, len, type, value, value_len) == FIELD_FOUND;
+}
+
+void ble_scanner_process(const uint8_t addr[BLE_SCANNER_ADDR_LEN], int8_t rssi,
+                         const uint8_t* data, uint16_t len) {
+  stats.reports++;
+
+  // filtering first, since most reports are from strangers
+  peer_t* peer = NULL;
+  if (peer_count > 0) {
+    uint16_t slot = find_slot(addr);
+    if (!peers[slot].used) {
+      stats.filtered++;
+      return;
+    }
+    peer = &peers[slot];
+  }
+
+  const uint8_t* value;
+  uint8_t value_len;
+  field_result_t result = find_field(data, len, BLE_SCANNER_AD_MANUFACTURER, &value, &value_len);
+  if (result == FIELD_MALFORMED) {
+    stats.malformed++;
+  }
+  if (result != FIELD_FOUND) {
+    return;
+  }
+
+  if (peer != NULL) {
+    uint32_t payload_hash = hash(value, value_len);
+    uint32_t now = scanner_config.repeat_ms ? now_ms() : 0;
+    if (peer->seen && peer->payload_hash == payload_hash &&
+        (scanner_config.repeat_ms == 0 || now - peer->seen_ms < scanner_config.repeat_ms)) {
+      stats.duplicates++;
+      return;
+    }
+    peer->seen = true;
+    peer->payload_hash = payload_hash;
+    peer->seen_ms = now;
+  }
+
+  stats.delivered++;
+  ble_scanner_report_t report = {
+    .addr = addr,
+    .rssi = rssi,
+    .data = value,
+    .len = value_len,
+  };
+  scanner_config.handler(&report);
+}
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include "ble.h"
+#include "ble_gap.h"
+#include "nrf_sdh_ble.h"
+
+// Reports land here until they have been processed
+static uint8_t scan_data[BLE_GAP_SCAN_BUFFER_MIN];
+static ble_data_t scan_buffer = {scan_data, sizeof(scan_data)};
+
+static bool scanning;
+
+ret_code_t ble_scanner_start(void) {
+  ble_gap_scan_params_t scan_params = {
+    .active = scanner_config.active,
+    .filter_policy = BLE_GAP_SCAN_FP_ACCEPT_ALL,
+    .scan_phys = BLE_GAP_PHY_1MBPS,
+    .interval = scanner_config.interval,
+    .window = scanner_config.window,
+    .timeout = BLE_GAP_SCAN_TIMEOUT_UNLIMITED,
+  };
+  ret_code_t err_code = sd_ble_gap_scan_start(&scan_params, &scan_buffer);
+  scanning = err_code == NRF_SUCCESS;
+  return err_code;
+}
+
+void ble_scanner_stop(void) {
+  if (scanning) {
+    scanning = false;
+    sd_ble_gap_scan_stop();
+  }
+}
+
+void ble_scanner_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context) {
+  if (!scanning || p_ble_evt->header.evt_id != BLE_GAP_EVT_ADV_REPORT) {
+    return;
+  }
+
+  ble_gap_evt_adv_report_t const* adv_report = &p_ble_evt->evt.gap_evt.params.adv_report;
+  ble_scanner_process(adv_report->peer_addr.addr, adv_report->rssi,
+                      adv_report->data.p_data, adv_report->data.len);
+
+  // the SoftDevice pauses after each report until given a buffer again.
+  // Another handler may already have resumed it, which is fine.
+  sd_ble_gap_scan_start(NULL, &scan_buffer);
+}
+
+#else
+
+ret_code_t ble_scanner_start(void) {
+  return NRF_ERROR_NOT_SUPPORTED;
+}
+
+void ble_scanner_stop(void) {
+}
+
+#endif
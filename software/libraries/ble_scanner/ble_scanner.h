@@ -0,0 +1,115 @@
+// BLE advertisement scanner with a peer address filter
+//
+// Scans with a configurable interval and window, and delivers manufacturer
+// specific data from advertisers in a filter table to a callback. The table
+// is an open addressing hash table, so checking a report costs about the
+// same with hundreds of peers as with one. Each report's AD structures are
+// parsed in place in one pass that never reads past the report.
+//
+// A peer that keeps advertising the same payload is only delivered when the
+// payload changes, or again after repeat_ms if that is set.
+//
+// The callback runs in the SoftDevice event handler, so it should be short.
+// The scanning functions need a SoftDevice, and return
+// NRF_ERROR_NOT_SUPPORTED in apps built without one.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+#define BLE_SCANNER_ADDR_LEN 6
+
+// Peer table slots, a power of two. Three quarters of them can be filled.
+#ifndef BLE_SCANNER_TABLE_SIZE
+#define BLE_SCANNER_TABLE_SIZE 256
+#endif
+
+// Priority of the SoftDevice event observer
+#ifndef BLE_SCANNER_OBSERVER_PRIO
+#define BLE_SCANNER_OBSERVER_PRIO 2
+#endif
+
+// Register the scanner for SoftDevice events
+//
+// Use once at file scope in the app, like the SDK's NRF_BLE_SCAN_DEF(), so
+// only apps that use the scanner link its event handler and buffers.
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+#include "nrf_sdh_ble.h"
+#define BLE_SCANNER_DEF(_name) \
+  NRF_SDH_BLE_OBSERVER(_name ## _obs, BLE_SCANNER_OBSERVER_PRIO, ble_scanner_on_ble_evt, NULL)
+void ble_scanner_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context);
+#else
+#define BLE_SCANNER_DEF(_name)
+#endif
+
+// AD type of manufacturer specific data
+#define BLE_SCANNER_AD_MANUFACTURER 0xFF
+
+typedef struct {
+  const uint8_t* addr; // least significant byte first, as the SoftDevice has it
+  int8_t rssi;
+  const uint8_t* data; // manufacturer data, starting with the company ID
+  uint8_t len;
+} ble_scanner_report_t;
+
+typedef void (*ble_scanner_handler_t)(const ble_scanner_report_t* report);
+
+typedef struct {
+  // in 0.625 ms units, e.g. MSEC_TO_UNITS(100, UNIT_0_625_MS). A window as
+  // long as the interval listens all the time, which catches the most
+  // advertisements from fast advertisers.
+  uint16_t interval;
+  uint16_t window;
+  bool active;        // ask advertisers for scan responses too
+  uint32_t repeat_ms; // deliver an unchanged payload again after this, 0 for never
+  ble_scanner_handler_t handler;
+} ble_scanner_config_t;
+
+typedef struct {
+  uint32_t reports;    // advertisements received
+  uint32_t filtered;   // from peers not in the table
+  uint32_t duplicates; // unchanged payloads held back
+  uint32_t delivered;
+  uint32_t malformed;  // AD structures running past the report
+} ble_scanner_stats_t;
+
+// Set the scan parameters and handler, and empty the peer table
+//
+// Returns NRF_ERROR_INVALID_PARAM without a handler or with a window longer
+// than the interval
+ret_code_t ble_scanner_init(const ble_scanner_config_t* config);
+
+// Deliver advertisements from a peer
+//
+// With no peers added, every advertiser is delivered, without deduplication.
+// Returns NRF_ERROR_NO_MEM if the table is full
+ret_code_t ble_scanner_add(const uint8_t addr[BLE_SCANNER_ADDR_LEN]);
+
+// Returns false if the peer wasn't in the table
+bool ble_scanner_remove(const uint8_t addr[BLE_SCANNER_ADDR_LEN]);
+
+// Peers in the table
+uint16_t ble_scanner_count(void);
+
+ret_code_t ble_scanner_start(void);
+
+void ble_scanner_stop(void);
+
+const ble_scanner_stats_t* ble_scanner_stats(void);
+
+// Find the first AD structure of a type in advertising data
+//
+// Stops at a zero length structure or one that runs past len.
+// Returns true and points value at the structure's data if found
+bool ble_scanner_find(const uint8_t* data, uint16_t len, uint8_t type,
+                      const uint8_t** value, uint8_t* value_len);
+
+// Run a report through the filter and deduplication, and deliver it
+//
+// Called for each advertisement received, exposed for testing without a
+// radio
+void ble_scanner_process(const uint8_t addr[BLE_SCANNER_ADDR_LEN], int8_t rssi,
+                         const uint8_t* data, uint16_t len);
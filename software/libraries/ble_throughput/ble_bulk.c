@@ -0,0 +1,304 @@
+// BLE bulk transfer service
+//
+// Sending works as in telemetry_ble: one context at a time hands packets to
+// the SoftDevice until its queue is full, and completion events top it up
+// again. A packet the SoftDevice had no room for is kept and offered first
+// next time. Starting, cancelling or dropping a transfer only leaves a
+// request for the sending context, which resets the transfer before its
+// next packet, so a central's write can't change it under a send in the
+// main loop. The transfer is timed with rtc_time from the first packet
+// queued to the completion event that empties the queue after the last.
+
+#include "ble_bulk.h"
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include <stdio.h>
+
+#include "app_util_platform.h"
+#include "ble.h"
+#include "ble_gatts.h"
+#include "nrf_sdh_ble.h"
+
+#include "ble_throughput.h"
+#include "rtc_time.h"
+#include "simple_ble.h"
+
+#define MAX_PACKET (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3)
+
+static simple_ble_service_t bulk_service = {{
+    .uuid128 = BLE_BULK_SERVICE_UUID
+}};
+
+static simple_ble_char_t data_char = {.uuid16 = BLE_BULK_DATA_UUID16};
+static simple_ble_char_t control_char = {.uuid16 = BLE_BULK_CONTROL_UUID16};
+static simple_ble_char_t rate_char = {.uuid16 = BLE_BULK_RATE_UUID16};
+static uint8_t data_value[MAX_PACKET];
+static uint32_t control_value;
+static uint32_t rate_value;
+
+static bool initialized;
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static bool subscribed;
+static ble_bulk_source_t bulk_source;
+
+static ble_bulk_transfer_t transfer;
+static uint64_t start_us;
+static uint16_t in_flight; // notifications queued and not yet sent
+
+// packet waiting for room in the SoftDevice queue
+static uint8_t packet[MAX_PACKET];
+static uint16_t packet_len;
+
+static bool sending;
+static bool send_again;
+static bool restart;          // begin restart_size before the next packet
+static uint32_t restart_size;
+
+// Bytes counting up from the offset, for measuring the link
+static uint16_t pattern(uint32_t offset, uint8_t* buf, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++) {
+    buf[i] = (offset + i) & 0xFF;
+  }
+  return len;
+}
+
+void ble_bulk_init(ble_bulk_source_t source) {
+  ret_code_t err_code = rtc_time_init();
+  APP_ERROR_CHECK(err_code);
+  bulk_source = source != NULL ? source : pattern;
+
+  simple_ble_add_service(&bulk_service);
+
+  simple_ble_add_characteristic(1, 0, 1, 1,
+      sizeof(data_value), data_value,
+      &bulk_service, &data_char);
+
+  simple_ble_add_characteristic(1, 1, 0, 0,
+      sizeof(control_value), (uint8_t*)&control_value,
+      &bulk_service, &control_char);
+
+  simple_ble_add_characteristic(1, 0, 0, 0,
+      sizeof(rate_value), (uint8_t*)&rate_value,
+      &bulk_service, &rate_char);
+
+  initialized = true;
+}
+
+static void finish(void) {
+  transfer.active = false;
+  transfer.elapsed_us = rtc_time_us() - start_us;
+  transfer.bytes_per_second = transfer.elapsed_us ?
+      (uint64_t)transfer.sent * 1000000 / transfer.elapsed_us : 0;
+  rate_value = transfer.bytes_per_second;
+
+  ble_gatts_value_t value = {
+    .len = sizeof(rate_value),
+    .offset = 0,
+    .p_value = (uint8_t*)&rate_value,
+  };
+  sd_ble_gatts_value_set(conn_handle, rate_char.char_handle.value_handle, &value);
+
+  printf("bulk: %lu bytes in %lu packets, %lu ms, %lu bytes/s\n",
+      transfer.sent, transfer.packets, transfer.elapsed_us / 1000, transfer.bytes_per_second);
+}
+
+static void begin(uint32_t size) {
+  transfer.active = size > 0;
+  transfer.size = size;
+  transfer.sent = 0;
+  transfer.packets = 0;
+  transfer.elapsed_us = 0;
+  packet_len = 0;
+}
+
+// Have the sending context begin a transfer of size bytes, 0 to stop
+static void request(uint32_t size) {
+  CRITICAL_REGION_ENTER();
+  restart = true;
+  restart_size = size;
+  CRITICAL_REGION_EXIT();
+}
+
+// Hand packets to the SoftDevice until it or the source runs out
+static void send_packets(void) {
+  bool begin_now;
+  uint32_t size;
+  CRITICAL_REGION_ENTER();
+  begin_now = restart;
+  size = restart_size;
+  restart = false;
+  CRITICAL_REGION_EXIT();
+  if (begin_now) {
+    begin(size);
+  }
+
+  if (!transfer.active || conn_handle == BLE_CONN_HANDLE_INVALID || !subscribed) {
+    return;
+  }
+
+  uint16_t max_len = ble_throughput_link()->att_mtu - 3;
+  if (max_len > MAX_PACKET) {
+    max_len = MAX_PACKET;
+  }
+
+  while (true) {
+    if (packet_len == 0) {
+      uint32_t offset = transfer.sent;
+      uint32_t remaining = transfer.size - offset;
+      if (remaining == 0) {
+        if (in_flight == 0) {
+          finish();
+        }
+        return;
+      }
+      uint16_t len = max_len - BLE_BULK_HEADER_LEN;
+      if (len > remaining) {
+        len = remaining;
+      }
+      len = bulk_source(offset, packet + BLE_BULK_HEADER_LEN, len);
+      if (len == 0) {
+        return;
+      }
+      packet[0] = offset & 0xFF;
+      packet[1] = (offset >> 8) & 0xFF;
+      packet[2] = (offset >> 16) & 0xFF;
+      packet[3] = offset >> 24;
+      packet_len = BLE_BULK_HEADER_LEN + len;
+    }
+
+    uint16_t len = packet_len;
+    ble_gatts_hvx_params_t hvx_params = {
+      .handle = data_char.char_handle.value_handle,
+      .type = BLE_GATT_HVX_NOTIFICATION,
+      .p_len = &len,
+      .p_data = packet,
+    };
+    ret_code_t err_code = sd_ble_gatts_hvx(conn_handle, &hvx_params);
+    if (err_code == NRF_ERROR_RESOURCES) {
+      // queue full, try again when a notification completes
+      return;
+    }
+    if (err_code != NRF_SUCCESS) {
+      // the link is going away
+      transfer.active = false;
+      packet_len = 0;
+      return;
+    }
+    if (transfer.packets == 0) {
+      start_us = rtc_time_us();
+    }
+    transfer.sent += packet_len - BLE_BULK_HEADER_LEN;
+    transfer.packets++;
+    CRITICAL_REGION_ENTER();
+    in_flight++;
+    CRITICAL_REGION_EXIT();
+    packet_len = 0;
+  }
+}
+
+void ble_bulk_send(void) {
+  if (!initialized) {
+    return;
+  }
+
+  bool run = false;
+  CRITICAL_REGION_ENTER();
+  if (sending) {
+    send_again = true;
+  } else {
+    sending = run = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  while (run) {
+    send_again = false;
+    send_packets();
+
+    CRITICAL_REGION_ENTER();
+    run = send_again;
+    sending = run;
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+bool ble_bulk_start(uint32_t size) {
+  if (!initialized || conn_handle == BLE_CONN_HANDLE_INVALID || !subscribed) {
+    return false;
+  }
+
+  request(size);
+  ble_bulk_send();
+  return true;
+}
+
+const ble_bulk_transfer_t* ble_bulk_transfer(void) {
+  return &transfer;
+}
+
+static void on_write(ble_gatts_evt_write_t const* write) {
+  if (write->handle == data_char.char_handle.cccd_handle && write->len == 2) {
+    subscribed = write->data[0] & BLE_GATT_HVX_NOTIFICATION;
+  } else if (write->handle == control_char.char_handle.value_handle && write->len == 4) {
+    request(write->data[0] | (write->data[1] << 8) | (write->data[2] << 16) |
+            ((uint32_t)write->data[3] << 24));
+  }
+}
+
+void ble_bulk_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context) {
+  if (!initialized) {
+    return;
+  }
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      subscribed = false;
+      in_flight = 0;
+      request(0);
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      subscribed = false;
+      in_flight = 0;
+      request(0);
+      break;
+
+    case BLE_GATTS_EVT_WRITE:
+      on_write(&p_ble_evt->evt.gatts_evt.params.write);
+      break;
+
+    case BLE_GATTS_EVT_HVN_TX_COMPLETE: {
+      // counts every notification on the link, see ble_bulk.h
+      uint8_t count = p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+      in_flight = count < in_flight ? in_flight - count : 0;
+      break;
+    }
+
+    default:
+      return;
+  }
+
+  ble_bulk_send();
+}
+
+#else
+
+static ble_bulk_transfer_t transfer;
+
+void ble_bulk_init(ble_bulk_source_t source) {
+}
+
+bool ble_bulk_start(uint32_t size) {
+  return false;
+}
+
+void ble_bulk_send(void) {
+}
+
+const ble_bulk_transfer_t* ble_bulk_transfer(void) {
+  return &transfer;
+}
+
+#endif
@@ -0,0 +1,85 @@
+// BLE bulk transfer service
+//
+// Streams a block of bytes to a subscribed central as notifications, each
+// as large as the MTU allows, and measures how fast it went. Each
+// notification starts with the little-endian uint32 offset of its data in
+// the block, so the receiver can tell if any went missing.
+//
+// The data comes from a source callback, or a counting pattern for
+// measuring the link. A central starts a transfer by writing the number of
+// bytes it wants as a little-endian uint32 to the control characteristic,
+// 0 to cancel, and can read the bytes/s of the last finished transfer from
+// the rate characteristic.
+//
+// The end of a transfer is found by counting notification completions, and
+// the SoftDevice counts those for the whole connection. So the bulk service
+// must be the only one notifying on the link while a transfer runs;
+// another service's notifications, e.g. telemetry_ble's, would end the
+// timing early and inflate the rate.
+//
+// Relies on ble_throughput for the negotiated MTU, so ble_throughput_init()
+// must be called too. Needs a SoftDevice, the functions do nothing in apps
+// built without one.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 9b3c0001-71d2-4e0a-b8f5-3a6d1c9e2f47
+#define BLE_BULK_SERVICE_UUID {0x47,0x2f,0x9e,0x1c,0x6d,0x3a,0xf5,0xb8, \
+                               0x0a,0x4e,0xd2,0x71,0x01,0x00,0x3c,0x9b}
+#define BLE_BULK_DATA_UUID16 0x0002
+#define BLE_BULK_CONTROL_UUID16 0x0003
+#define BLE_BULK_RATE_UUID16 0x0004
+
+#define BLE_BULK_HEADER_LEN 4
+
+// Priority of the SoftDevice event observer
+#ifndef BLE_BULK_OBSERVER_PRIO
+#define BLE_BULK_OBSERVER_PRIO 2
+#endif
+
+// Register the service for SoftDevice events
+//
+// Use once at file scope in the app, like the SDK's NRF_BLE_SCAN_DEF(), so
+// only apps that use the service link its event handler and buffers.
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+#include "nrf_sdh_ble.h"
+#define BLE_BULK_DEF(_name) \
+  NRF_SDH_BLE_OBSERVER(_name ## _obs, BLE_BULK_OBSERVER_PRIO, ble_bulk_on_ble_evt, NULL)
+void ble_bulk_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context);
+#else
+#define BLE_BULK_DEF(_name)
+#endif
+
+// Fill buf with up to len bytes of the block starting at offset
+//
+// Returns the number of bytes written, 0 if none are ready yet. Called
+// from the SoftDevice event handler as well as ble_bulk_send().
+typedef uint16_t (*ble_bulk_source_t)(uint32_t offset, uint8_t* buf, uint16_t len);
+
+typedef struct {
+  bool active;
+  uint32_t size;             // bytes in the block
+  uint32_t sent;             // bytes handed to the SoftDevice
+  uint32_t packets;
+  uint32_t elapsed_us;       // from the first packet to the last one going out
+  uint32_t bytes_per_second; // of the last finished transfer
+} ble_bulk_transfer_t;
+
+// Add the service to the simple_ble app
+//
+// Must be called after simple_ble_init() and before advertising starts.
+// source: where the data comes from, NULL for the counting pattern
+void ble_bulk_init(ble_bulk_source_t source);
+
+// Start sending a block of size bytes, replacing any transfer in progress
+//
+// Returns false if no central has subscribed
+bool ble_bulk_start(uint32_t size);
+
+// Send more, after a source that had nothing ready has new data
+void ble_bulk_send(void);
+
+const ble_bulk_transfer_t* ble_bulk_transfer(void);
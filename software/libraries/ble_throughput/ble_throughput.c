@@ -0,0 +1,161 @@
+// BLE link setup for throughput
+//
+// simple_ble may already negotiate some of this itself, in which case the
+// SoftDevice turns the second request away as busy or in the wrong state.
+// Those errors are ignored, as are refusals from the central, since the
+// link carries on with whatever it had.
+
+#include <stdio.h>
+
+#include "ble_throughput.h"
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include "app_error.h"
+#include "ble.h"
+#include "ble_gap.h"
+#include "ble_gattc.h"
+#include "ble_hci.h"
+#include "nrf_sdh_ble.h"
+
+static bool initialized;
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+// the defaults until a central connects and negotiates
+static ble_throughput_link_t current_link = {
+  .att_mtu = BLE_GATT_ATT_MTU_DEFAULT,
+  .data_length = BLE_GAP_DATA_LENGTH_DEFAULT,
+  .tx_phy = BLE_GAP_PHY_1MBPS,
+};
+
+static void reset_link(void) {
+  current_link = (ble_throughput_link_t){
+    .connected = false,
+    .att_mtu = BLE_GATT_ATT_MTU_DEFAULT,
+    .data_length = BLE_GAP_DATA_LENGTH_DEFAULT,
+    .tx_phy = BLE_GAP_PHY_1MBPS,
+    .conn_interval = 0,
+  };
+}
+
+void ble_throughput_init(void) {
+  // keep sending past the configured event length while there is data
+  ble_opt_t opt = {0};
+  opt.common_opt.conn_evt_ext.enable = 1;
+  ret_code_t err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+  APP_ERROR_CHECK(err_code);
+
+  reset_link();
+  initialized = true;
+}
+
+const ble_throughput_link_t* ble_throughput_link(void) {
+  return &current_link;
+}
+
+void ble_throughput_print_link(void) {
+  if (!current_link.connected) {
+    printf("link: not connected\n");
+    return;
+  }
+  printf("link: MTU %u, data length %u, %s PHY, interval %u.%02u ms\n",
+      current_link.att_mtu, current_link.data_length, current_link.tx_phy == BLE_GAP_PHY_2MBPS ? "2M" : "1M",
+      current_link.conn_interval * 125 / 100, current_link.conn_interval * 125 % 100);
+}
+
+// Ask for everything at once, the central answers each in its own time
+static void negotiate(void) {
+  sd_ble_gattc_exchange_mtu_request(conn_handle, NRF_SDH_BLE_GATT_MAX_MTU_SIZE);
+
+  // NULL lets the SoftDevice pick the largest lengths it was configured for
+  sd_ble_gap_data_length_update(conn_handle, NULL, NULL);
+
+  // either PHY is fine, but 2M is preferred
+  ble_gap_phys_t phys = {
+    .tx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+    .rx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+  };
+  sd_ble_gap_phy_update(conn_handle, &phys);
+}
+
+void ble_throughput_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context) {
+  if (!initialized) {
+    return;
+  }
+
+  ble_gap_evt_t const* gap_evt = &p_ble_evt->evt.gap_evt;
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = gap_evt->conn_handle;
+      reset_link();
+      current_link.connected = true;
+      current_link.conn_interval = gap_evt->params.connected.conn_params.max_conn_interval;
+      negotiate();
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      reset_link();
+      break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      current_link.conn_interval = gap_evt->params.conn_param_update.conn_params.max_conn_interval;
+      break;
+
+    // the MTU is the smaller of the two sides', whichever side asks first
+    case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST: {
+      uint16_t mtu = p_ble_evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu;
+      current_link.att_mtu = mtu < NRF_SDH_BLE_GATT_MAX_MTU_SIZE ? mtu : NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
+      sd_ble_gatts_exchange_mtu_reply(conn_handle, NRF_SDH_BLE_GATT_MAX_MTU_SIZE);
+      break;
+    }
+
+    case BLE_GATTC_EVT_EXCHANGE_MTU_RSP: {
+      uint16_t mtu = p_ble_evt->evt.gattc_evt.params.exchange_mtu_rsp.server_rx_mtu;
+      current_link.att_mtu = mtu < NRF_SDH_BLE_GATT_MAX_MTU_SIZE ? mtu : NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
+      break;
+    }
+
+    case BLE_GAP_EVT_DATA_LENGTH_UPDATE_REQUEST:
+      sd_ble_gap_data_length_update(conn_handle, NULL, NULL);
+      break;
+
+    case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
+      current_link.data_length = gap_evt->params.data_length_update.effective_params.max_tx_octets;
+      break;
+
+    case BLE_GAP_EVT_PHY_UPDATE_REQUEST: {
+      // take whatever the central prefers, 2M if it offers it
+      ble_gap_phys_t phys = {
+        .tx_phys = BLE_GAP_PHY_AUTO,
+        .rx_phys = BLE_GAP_PHY_AUTO,
+      };
+      sd_ble_gap_phy_update(conn_handle, &phys);
+      break;
+    }
+
+    case BLE_GAP_EVT_PHY_UPDATE:
+      if (gap_evt->params.phy_update.status == BLE_HCI_STATUS_CODE_SUCCESS) {
+        current_link.tx_phy = gap_evt->params.phy_update.tx_phy;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+#else
+
+static ble_throughput_link_t current_link;
+
+void ble_throughput_init(void) {
+}
+
+const ble_throughput_link_t* ble_throughput_link(void) {
+  return &current_link;
+}
+
+void ble_throughput_print_link(void) {
+}
+
+#endif
@@ -0,0 +1,57 @@
+// BLE link setup for throughput
+//
+// The board configuration lets the SoftDevice use a 247 byte ATT MTU and
+// 251 byte link layer packets, but a connection starts at 23 and 27 bytes
+// on the 1M PHY, which carries a few KB/s of notifications. When a central
+// connects, this asks for the largest MTU, data length extension and the 2M
+// PHY, and answers the central's own requests for them. It also lets
+// connection events run past their configured length while there is data
+// to send, so many packets go out per connection interval.
+//
+// Every request falls back: a central without data length extension or 2M
+// PHY support keeps the defaults, and the link works either way. The
+// results are reported by ble_throughput_link().
+//
+// Needs a SoftDevice, the functions do nothing in apps built without one.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Priority of the SoftDevice event observer
+#ifndef BLE_THROUGHPUT_OBSERVER_PRIO
+#define BLE_THROUGHPUT_OBSERVER_PRIO 2
+#endif
+
+// Register the link setup for SoftDevice events
+//
+// Use once at file scope in the app, like the SDK's NRF_BLE_SCAN_DEF(), so
+// only apps that use the link setup link its event handler and buffers.
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+#include "nrf_sdh_ble.h"
+#define BLE_THROUGHPUT_DEF(_name) \
+  NRF_SDH_BLE_OBSERVER(_name ## _obs, BLE_THROUGHPUT_OBSERVER_PRIO, ble_throughput_on_ble_evt, NULL)
+void ble_throughput_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context);
+#else
+#define BLE_THROUGHPUT_DEF(_name)
+#endif
+
+// What was negotiated for the current connection
+typedef struct {
+  bool connected;
+  uint16_t att_mtu;       // bytes, a notification carries 3 less
+  uint16_t data_length;   // link layer payload bytes per packet sent
+  uint8_t tx_phy;         // BLE_GAP_PHY_1MBPS or BLE_GAP_PHY_2MBPS
+  uint16_t conn_interval; // 1.25 ms units
+} ble_throughput_link_t;
+
+// Turn on connection event extension and start negotiating on connections
+//
+// Must be called after simple_ble_init()
+void ble_throughput_init(void);
+
+const ble_throughput_link_t* ble_throughput_link(void);
+
+// Print the negotiated parameters
+void ble_throughput_print_link(void);
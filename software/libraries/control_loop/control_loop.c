@@ -0,0 +1,222 @@
+// Fixed-rate control loop executor
+//
+// TIMER3 counts microseconds and its compare register is advanced by one
+// period on every release. The interrupt only records the release time, and
+// all timing is measured in the main loop around the step itself.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_pwr_mgmt.h"
+#include "sdk_common.h"
+
+#include "control_loop.h"
+
+#if NRF_MODULE_ENABLED(CONTROL_LOOP)
+
+// capture channels for the main loop and the interrupt, kept apart so one
+// can't overwrite a capture the other is about to read
+#define CAPTURE_CHANNEL 1
+#define IRQ_CAPTURE_CHANNEL 2
+
+static control_loop_config_t config;
+static control_loop_stats_t stats;
+
+static volatile bool released;
+static volatile uint32_t release_time;
+
+static bool degraded;
+static uint16_t in_budget_steps;
+
+static uint32_t timer_now(uint8_t channel) {
+  NRF_TIMER3->TASKS_CAPTURE[channel] = 1;
+  return NRF_TIMER3->CC[channel];
+}
+
+// Release the step, and move the compare register on to the next release
+void TIMER3_IRQHandler(void) {
+  NRF_TIMER3->EVENTS_COMPARE[0] = 0;
+
+  uint32_t release = NRF_TIMER3->CC[0];
+  if (released) {
+    stats.skipped++;
+  } else {
+    release_time = release;
+    released = true;
+  }
+
+  // if this interrupt was held off for a whole period, the next release has
+  // already gone by and would not match until the counter wraps
+  uint32_t next = release + config.period_us;
+  while ((int32_t)(timer_now(IRQ_CAPTURE_CHANNEL) - next) >= 0) {
+    next += config.period_us;
+    stats.skipped++;
+  }
+  NRF_TIMER3->CC[0] = next;
+}
+
+ret_code_t control_loop_init(const control_loop_config_t* loop_config) {
+  if (loop_config->step == NULL || loop_config->period_us == 0) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  config = *loop_config;
+  if (config.budget_us == 0) {
+    config.budget_us = config.period_us;
+  }
+  released = false;
+  degraded = false;
+  in_budget_steps = 0;
+  memset(&stats, 0, sizeof(stats));
+
+  ret_code_t error_code = nrf_pwr_mgmt_init();
+  if (error_code != NRF_SUCCESS) {
+    return error_code;
+  }
+
+  // 32 bit timer counting at 1MHz
+  NRF_TIMER3->TASKS_STOP = 1;
+  NRF_TIMER3->PRESCALER = 4;
+  NRF_TIMER3->BITMODE = 3;
+  NRF_TIMER3->TASKS_CLEAR = 1;
+  NRF_TIMER3->CC[0] = config.period_us;
+  NRF_TIMER3->EVENTS_COMPARE[0] = 0;
+  NRF_TIMER3->INTENSET = 1 << TIMER_INTENSET_COMPARE0_Pos;
+
+  NVIC_SetPriority(TIMER3_IRQn, APP_IRQ_PRIORITY_HIGH);
+  NVIC_ClearPendingIRQ(TIMER3_IRQn);
+  NVIC_EnableIRQ(TIMER3_IRQn);
+
+  NRF_TIMER3->TASKS_START = 1;
+  return NRF_SUCCESS;
+}
+
+static void hist_add(uint16_t* hist, uint32_t us) {
+  uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+  if (bucket >= CONTROL_LOOP_HIST_BUCKETS) {
+    bucket = CONTROL_LOOP_HIST_BUCKETS - 1;
+  }
+  if (hist[bucket] < UINT16_MAX) {
+    hist[bucket]++;
+  }
+}
+
+static void set_degraded(bool value) {
+  if (degraded == value) {
+    return;
+  }
+  degraded = value;
+  if (config.degraded != NULL) {
+    config.degraded(value);
+  }
+}
+
+bool control_loop_poll(void) {
+  bool due;
+  uint32_t release;
+
+  CRITICAL_REGION_ENTER();
+  due = released;
+  release = release_time;
+  released = false;
+  CRITICAL_REGION_EXIT();
+
+  if (!due) {
+    return false;
+  }
+
+  uint32_t start = timer_now(CAPTURE_CHANNEL);
+  config.step();
+  uint32_t end = timer_now(CAPTURE_CHANNEL);
+
+  uint32_t exec = end - start;
+  uint32_t jitter = start - release;
+  int32_t late = (int32_t)(end - (release + config.period_us));
+
+  stats.steps++;
+  hist_add(stats.exec, exec);
+  hist_add(stats.jitter, jitter);
+  if (exec > stats.max_exec_us) {
+    stats.max_exec_us = exec;
+  }
+  if (jitter > stats.max_jitter_us) {
+    stats.max_jitter_us = jitter;
+  }
+  if (late > 0) {
+    stats.misses++;
+    hist_add(stats.lateness, late);
+  }
+
+  if (exec > config.budget_us) {
+    stats.overruns++;
+    in_budget_steps = 0;
+    set_degraded(true);
+  } else if (degraded && ++in_budget_steps >= CONTROL_LOOP_RECOVER_STEPS) {
+    set_degraded(false);
+  }
+
+  return true;
+}
+
+void control_loop_run(void) {
+  while (1) {
+    // A release after the poll still wakes us, since its interrupt sets the
+    // event register
+    if (!control_loop_poll()) {
+      nrf_pwr_mgmt_run();
+    }
+  }
+}
+
+uint32_t control_loop_now(void) {
+  uint32_t now;
+
+  CRITICAL_REGION_ENTER();
+  now = timer_now(CAPTURE_CHANNEL);
+  CRITICAL_REGION_EXIT();
+
+  return now;
+}
+
+bool control_loop_degraded(void) {
+  return degraded;
+}
+
+const control_loop_stats_t* control_loop_stats(void) {
+  return &stats;
+}
+
+void control_loop_stats_reset(void) {
+  CRITICAL_REGION_ENTER();
+  memset(&stats, 0, sizeof(stats));
+  CRITICAL_REGION_EXIT();
+}
+
+static void print_hist(const char* label, const uint16_t* hist) {
+  for (uint8_t i = 0; i < CONTROL_LOOP_HIST_BUCKETS; i++) {
+    if (hist[i] == 0) {
+      continue;
+    }
+    uint32_t lo = i ? 1UL << (i - 1) : 0;
+    if (i == 0) {
+      printf("  %s 0 us: %u\n", label, hist[i]);
+    } else if (i == CONTROL_LOOP_HIST_BUCKETS - 1) {
+      printf("  %s >=%lu us: %u\n", label, lo, hist[i]);
+    } else {
+      printf("  %s %lu-%lu us: %u\n", label, lo, (1UL << i) - 1, hist[i]);
+    }
+  }
+}
+
+void control_loop_print_stats(void) {
+  printf("loop %lu us: %lu steps, %lu over budget, %lu missed, %lu skipped\n",
+      config.period_us, stats.steps, stats.overruns, stats.misses, stats.skipped);
+  printf("  max exec %lu us, max jitter %lu us\n", stats.max_exec_us, stats.max_jitter_us);
+  print_hist("exec", stats.exec);
+  print_hist("jitter", stats.jitter);
+  print_hist("late", stats.lateness);
+}
+
+#endif // NRF_MODULE_ENABLED(CONTROL_LOOP)
@@ -0,0 +1,90 @@
+// Fixed-rate control loop executor
+//
+// TIMER3 releases a step function at a fixed period, and the main loop runs
+// it, so a step can still make blocking driver calls that rely on interrupts.
+// Releases are spaced exactly one period apart on the hardware timer rather
+// than one period after the previous step, so the rate doesn't drift with
+// the step time.
+//
+// Every step records its execution time, its start jitter (how long after
+// the release it started) and, if it finished after the next release, how
+// late it was, each in a histogram with power of two buckets. A step that
+// runs over its budget puts the loop in degraded mode, so the application
+// can drop optional work such as display updates until it is back in budget.
+//
+// Compiled in when CONTROL_LOOP_ENABLED is set in the board's app_config.h,
+// and defines TIMER3_IRQHandler.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// Histogram buckets. Bucket 0 counts 0 us, bucket n counts 2^(n-1) to
+// 2^n - 1 us, and the last bucket also counts everything longer
+#ifndef CONTROL_LOOP_HIST_BUCKETS
+#define CONTROL_LOOP_HIST_BUCKETS 16
+#endif
+
+// In-budget steps in a row needed to leave degraded mode
+#ifndef CONTROL_LOOP_RECOVER_STEPS
+#define CONTROL_LOOP_RECOVER_STEPS 8
+#endif
+
+// Runs one iteration of the control loop
+typedef void (*control_loop_step_t)(void);
+
+// Called from the main loop when the loop enters or leaves degraded mode
+typedef void (*control_loop_degraded_handler_t)(bool degraded);
+
+typedef struct {
+  uint32_t period_us;
+  uint32_t budget_us; // execution time allowed per step, 0 for the period
+  control_loop_step_t step;
+  control_loop_degraded_handler_t degraded; // NULL for none
+} control_loop_config_t;
+
+typedef struct {
+  uint32_t steps;
+  uint32_t overruns; // steps longer than the budget
+  uint32_t misses;   // steps that finished after the next release
+  uint32_t skipped;  // releases lost while a step was still running
+  uint32_t max_exec_us;
+  uint32_t max_jitter_us;
+
+  // counts saturate rather than wrap
+  uint16_t exec[CONTROL_LOOP_HIST_BUCKETS];
+  uint16_t jitter[CONTROL_LOOP_HIST_BUCKETS];
+  uint16_t lateness[CONTROL_LOOP_HIST_BUCKETS];
+} control_loop_stats_t;
+
+// Set up TIMER3 and power management, and release the first step one period
+// from now
+//
+// Returns NRF_ERROR_INVALID_PARAM without a step function or period
+ret_code_t control_loop_init(const control_loop_config_t* config);
+
+// Run the step if it has been released
+//
+// For main loops that do other work between steps
+// Returns true if the step ran
+bool control_loop_poll(void);
+
+// Run the step every period forever, sleeping in between
+void control_loop_run(void);
+
+// Microseconds from the loop timer, which wraps every 71.6 minutes
+uint32_t control_loop_now(void);
+
+// True from a step over budget until CONTROL_LOOP_RECOVER_STEPS steps in a
+// row are back within it
+bool control_loop_degraded(void);
+
+const control_loop_stats_t* control_loop_stats(void);
+
+void control_loop_stats_reset(void);
+
+// Print the counters and non-empty histogram buckets
+void control_loop_print_stats(void);
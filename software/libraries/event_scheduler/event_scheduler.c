@@ -0,0 +1,243 @@
+// Event scheduler
+//
+// Cooperative run-to-completion scheduler. Interrupt handlers post events to
+// a queue, and the main loop runs the handler registered for each event in
+// turn, then sleeps until the next interrupt when the queue is empty. Time
+// spent in each handler is measured with the cycle counter.
+//
+// Event timers are kept in a table indexed by event type and served by one
+// virtual timer that always points at the earliest deadline, as in
+// statechart_timer.
+
+#include <stddef.h>
+#include <string.h>
+
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_pwr_mgmt.h"
+
+#include "event_scheduler.h"
+#include "virtual_timer.h"
+
+// queue indices are free running 16 bit counts, so they only map onto the
+// queue across a wrap if its size divides 65536
+STATIC_ASSERT((EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) == 0);
+STATIC_ASSERT(EVENT_QUEUE_SIZE > 0 && EVENT_QUEUE_SIZE <= 0x8000);
+
+typedef struct {
+  uint8_t type;
+  uint32_t data;
+} event_t;
+
+static event_t queue[EVENT_QUEUE_SIZE];
+static volatile uint16_t queue_head;
+static volatile uint16_t queue_tail;
+static volatile uint32_t dropped;
+
+typedef struct {
+  uint64_t deadline;
+  uint32_t period_us; // 0 for one-shot timers
+  uint32_t data;
+  bool armed;         // waiting for its deadline
+  bool posted;        // its event is queued and not yet handled
+} event_timer_t;
+
+static event_handler_t handlers[EVENT_MAX_TYPES];
+static event_stats_t stats[EVENT_MAX_TYPES];
+
+static event_timer_t timers[EVENT_MAX_TYPES];
+static uint32_t timer_id = VIRTUAL_TIMER_INVALID;
+
+ret_code_t event_scheduler_init(void) {
+  queue_head = 0;
+  queue_tail = 0;
+  dropped = 0;
+  memset(handlers, 0, sizeof(handlers));
+  memset(stats, 0, sizeof(stats));
+  memset(timers, 0, sizeof(timers));
+  timer_id = VIRTUAL_TIMER_INVALID;
+
+  // start the cycle counter for handler timing
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  return nrf_pwr_mgmt_init();
+}
+
+ret_code_t event_register(uint8_t type, event_handler_t handler) {
+  if (type >= EVENT_MAX_TYPES) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  handlers[type] = handler;
+  return NRF_SUCCESS;
+}
+
+ret_code_t event_post(uint8_t type, uint32_t data) {
+  ret_code_t err_code = NRF_SUCCESS;
+
+  CRITICAL_REGION_ENTER();
+  if ((uint16_t)(queue_tail - queue_head) < EVENT_QUEUE_SIZE) {
+    event_t* event = &queue[queue_tail % EVENT_QUEUE_SIZE];
+    event->type = type;
+    event->data = data;
+    queue_tail++;
+  } else {
+    dropped++;
+    err_code = NRF_ERROR_NO_MEM;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return err_code;
+}
+
+static void timer_fired(void);
+
+// Point the virtual timer at the earliest armed deadline, must be called
+// with interrupts disabled
+static void reschedule(void) {
+  virtual_timer_cancel(timer_id);
+  timer_id = VIRTUAL_TIMER_INVALID;
+
+  bool armed = false;
+  uint64_t earliest = 0;
+  for (uint8_t type = 0; type < EVENT_MAX_TYPES; type++) {
+    if (timers[type].armed && (!armed || timers[type].deadline < earliest)) {
+      earliest = timers[type].deadline;
+      armed = true;
+    }
+  }
+  if (!armed) {
+    return;
+  }
+
+  uint64_t now = read_timer64();
+  uint64_t delay = earliest > now ? earliest - now : 0;
+  if (delay > UINT32_MAX) {
+    delay = UINT32_MAX;
+  }
+  timer_id = virtual_timer_start((uint32_t)delay, timer_fired);
+  APP_ERROR_CHECK_BOOL(timer_id != VIRTUAL_TIMER_INVALID);
+}
+
+// Virtual timer callback, posts the events of expired timers
+static void timer_fired(void) {
+  CRITICAL_REGION_ENTER();
+  timer_id = VIRTUAL_TIMER_INVALID;
+  uint64_t now = read_timer64();
+  for (uint8_t type = 0; type < EVENT_MAX_TYPES; type++) {
+    event_timer_t* timer = &timers[type];
+    if (!timer->armed || timer->deadline > now) {
+      continue;
+    }
+    if (!timer->posted && event_post(type, timer->data) == NRF_SUCCESS) {
+      timer->posted = true;
+    }
+    if (timer->period_us) {
+      // stay on the original grid, skipping periods that were missed
+      do {
+        timer->deadline += timer->period_us;
+      } while (timer->deadline <= now);
+    } else {
+      timer->armed = false;
+    }
+  }
+  reschedule();
+  CRITICAL_REGION_EXIT();
+}
+
+ret_code_t event_timer_start(uint8_t type, uint32_t period_us, bool repeated, uint32_t data) {
+  if (type >= EVENT_MAX_TYPES) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  CRITICAL_REGION_ENTER();
+  event_timer_t* timer = &timers[type];
+  timer->deadline = read_timer64() + period_us;
+  timer->period_us = repeated ? period_us : 0;
+  timer->data = data;
+  timer->armed = true;
+  reschedule();
+  CRITICAL_REGION_EXIT();
+
+  return NRF_SUCCESS;
+}
+
+void event_timer_stop(uint8_t type) {
+  if (type >= EVENT_MAX_TYPES) {
+    return;
+  }
+
+  CRITICAL_REGION_ENTER();
+  timers[type].armed = false;
+  reschedule();
+  CRITICAL_REGION_EXIT();
+}
+
+// Take the oldest event off the queue, returns false if it is empty
+static bool queue_pop(event_t* event) {
+  bool found = false;
+
+  CRITICAL_REGION_ENTER();
+  if (queue_head != queue_tail) {
+    *event = queue[queue_head % EVENT_QUEUE_SIZE];
+    queue_head++;
+    found = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return found;
+}
+
+uint16_t event_dispatch(void) {
+  uint16_t handled = 0;
+  event_t event;
+
+  while (queue_pop(&event)) {
+    if (event.type >= EVENT_MAX_TYPES) {
+      continue;
+    }
+    // from here a timer for this type may post again
+    timers[event.type].posted = false;
+    if (handlers[event.type] == NULL) {
+      continue;
+    }
+
+    uint32_t start = DWT->CYCCNT;
+    handlers[event.type](event.data);
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    event_stats_t* s = &stats[event.type];
+    s->count++;
+    s->last_cycles = cycles;
+    s->total_cycles += cycles;
+    if (cycles > s->max_cycles) {
+      s->max_cycles = cycles;
+    }
+    handled++;
+  }
+
+  return handled;
+}
+
+void event_scheduler_run(void) {
+  while (1) {
+    event_dispatch();
+
+    // An event posted after the queue was found empty still wakes us, since
+    // the interrupt that posted it sets the event register
+    nrf_pwr_mgmt_run();
+  }
+}
+
+const event_stats_t* event_stats(uint8_t type) {
+  if (type >= EVENT_MAX_TYPES) {
+    return NULL;
+  }
+  return &stats[type];
+}
+
+uint32_t event_dropped(void) {
+  return dropped;
+}
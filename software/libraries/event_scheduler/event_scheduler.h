@@ -0,0 +1,82 @@
+// Event scheduler
+//
+// Cooperative run-to-completion scheduler. Interrupt handlers post events to
+// a queue, and the main loop runs the handler registered for each event in
+// turn, then sleeps until the next interrupt when the queue is empty. Time
+// spent in each handler is measured with the cycle counter.
+//
+// Timers are an event source too: event_timer_start() posts an event after a
+// delay, or periodically, from a single virtual timer. virtual_timer_init()
+// must be called before a timer is started.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// Events that can be waiting at once, must be a power of two
+#ifndef EVENT_QUEUE_SIZE
+#define EVENT_QUEUE_SIZE 32
+#endif
+
+// Number of event types, which are numbered from 0
+#ifndef EVENT_MAX_TYPES
+#define EVENT_MAX_TYPES 16
+#endif
+
+// Handler for one type of event, data is whatever was posted with it
+typedef void (*event_handler_t)(uint32_t data);
+
+// Execution time of a handler, in CPU cycles (64 per microsecond)
+typedef struct {
+  uint32_t count;
+  uint32_t last_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+} event_stats_t;
+
+// Initialize the queue, power management and the cycle counter
+//
+// Returns success or an error code
+ret_code_t event_scheduler_init(void);
+
+// Set the handler for an event type, replacing any previous one
+//
+// Returns NRF_ERROR_INVALID_PARAM if type is not below EVENT_MAX_TYPES
+ret_code_t event_register(uint8_t type, event_handler_t handler);
+
+// Queue an event, safe to call from any interrupt priority
+//
+// Returns NRF_ERROR_NO_MEM and counts the event as dropped if the queue is
+// full
+ret_code_t event_post(uint8_t type, uint32_t data);
+
+// Post an event of type with data after period_us, and every period_us after
+// that if repeated, replacing any timer already running for type
+//
+// A timer doesn't post again while its last event is still waiting to be
+// handled, so a slow handler runs once late rather than several times in a
+// row.
+// Returns NRF_ERROR_INVALID_PARAM if type is not below EVENT_MAX_TYPES
+ret_code_t event_timer_start(uint8_t type, uint32_t period_us, bool repeated, uint32_t data);
+
+// Stop the timer for type, if any. An event it already posted is still
+// handled.
+void event_timer_stop(uint8_t type);
+
+// Run the handlers of all queued events, including any posted while they
+// run
+//
+// Returns the number of events handled
+uint16_t event_dispatch(void);
+
+// Dispatch events forever, sleeping whenever the queue is empty
+void event_scheduler_run(void);
+
+// Execution time statistics for an event type, or NULL if type is invalid
+const event_stats_t* event_stats(uint8_t type);
+
+// Number of events lost because the queue was full
+uint32_t event_dropped(void);
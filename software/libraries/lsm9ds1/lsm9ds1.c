@@ -6,9 +6,9 @@
 #include "nrf.h"
 #include "nrf_delay.h"
 #include "nrf_twi_mngr.h"
-#include "nrf_drv_timer.h"
 
 #include "lsm9ds1.h"
+#include "rtc_time.h"
 
 static IMUSettings settings;
 static int16_t gx, gy, gz;
@@ -20,13 +20,9 @@ static float gBias[3], aBias[3], mBias[3];
 static int16_t gBiasRaw[3], aBiasRaw[3], mBiasRaw[3];
 
 // rotation tracking variables
-static const nrf_drv_timer_t gyro_timer = NRFX_TIMER_INSTANCE(1);
+static bool integrating;
 static lsm9ds1_measurement_t integrated_angle;
-static uint32_t prev_timer_val;
-
-static void gyro_timer_event_handler(nrf_timer_event_t event_type, void* p_context) {
-  // don't care about events
-}
+static uint64_t prev_ticks;
 
 static void i2c_read_bytes(uint8_t i2c_addr, uint8_t reg_addr, uint8_t* data, uint8_t len) {
   nrf_twi_mngr_transfer_t const read_transfer[] = {
@@ -384,15 +380,8 @@ ret_code_t lsm9ds1_init(const nrf_twi_mngr_t* i2c) {
   }
   autocalc = false;
 
-  // initialize a timer for integrating gyro - the default frequency is 16MHz
-  nrf_drv_timer_config_t timer_cfg = {
-    .frequency          = NRF_TIMER_FREQ_1MHz,
-    .mode               = NRF_TIMER_MODE_TIMER,
-    .bit_width          = NRF_TIMER_BIT_WIDTH_32,
-    .interrupt_priority = NRFX_TIMER_DEFAULT_CONFIG_IRQ_PRIORITY,
-    .p_context          = NULL,
-  };
-  ret_code_t error_code = nrfx_timer_init(&gyro_timer, &timer_cfg, gyro_timer_event_handler);
+  // start the low power timebase used for integrating gyro
+  ret_code_t error_code = rtc_time_init();
   APP_ERROR_CHECK(error_code);
 
   // Using the ODR of each sensor, We can calculate the resolution
@@ -486,7 +475,7 @@ lsm9ds1_measurement_t lsm9ds1_read_magnetometer()  {
 }
 
 ret_code_t lsm9ds1_start_gyro_integration() {
-  if (nrfx_timer_is_enabled(&gyro_timer)) {
+  if (integrating) {
     return NRF_ERROR_INVALID_STATE;
   }
 
@@ -495,21 +484,26 @@ ret_code_t lsm9ds1_start_gyro_integration() {
   integrated_angle.y_axis = 0;
   integrated_angle.x_axis = 0;
 
-  nrfx_timer_clear(&gyro_timer);
-  nrfx_timer_enable(&gyro_timer);
-  prev_timer_val = 0;
+  prev_ticks = rtc_time_ticks();
+  integrating = true;
 
   return NRF_SUCCESS;
 }
 
 void lsm9ds1_stop_gyro_integration() {
-  nrfx_timer_disable(&gyro_timer);
+  integrating = false;
 }
 
 lsm9ds1_measurement_t lsm9ds1_read_gyro_integration() {
-  uint32_t curr_timer_val = nrfx_timer_capture(&gyro_timer, NRF_TIMER_CC_CHANNEL0);
-  float time_diff = ((float)(curr_timer_val - prev_timer_val))/1000000.0;
-  prev_timer_val = curr_timer_val;
+  // the angle holds still while integration is stopped
+  if (!integrating) {
+    return integrated_angle;
+  }
+
+  // whole ticks, so the interval is exact to the tick with no rounding to us
+  uint64_t curr_ticks = rtc_time_ticks();
+  float time_diff = ((float)(curr_ticks - prev_ticks))/RTC_TIME_TICKS_PER_SECOND;
+  prev_ticks = curr_ticks;
   lsm9ds1_measurement_t measure = lsm9ds1_read_gyro();
   if (measure.z_axis > 0.5 || measure.z_axis < -0.5) {
     integrated_angle.z_axis += measure.z_axis*time_diff;
@@ -48,6 +48,8 @@ void lsm9ds1_stop_gyro_integration();
 // Note: this function also performs the integration and needs to be called
 // periodically
 //
+// dt comes from the RTC timebase (30.5 us ticks)
+//
 // Return the integrated value as floating point in degrees
 lsm9ds1_measurement_t lsm9ds1_read_gyro_integration();
 
@@ -52,6 +52,8 @@ void mpu9250_stop_gyro_integration();
 // Note: this function also performs the integration and needs to be called
 // periodically
 //
+// dt comes from the RTC timebase (30.5 us ticks)
+//
 // Return the integrated value as floating point in degrees
 mpu9250_measurement_t mpu9250_read_gyro_integration();
 
@@ -4,147 +4,339 @@
 
 #include <string.h>
 
-#include "nrf_delay.h"
+#include "app_util_platform.h"
 #include "nrf_drv_spi.h"
 #include "app_error.h"
 
 #include "display.h"
+#include "rtc_time.h"
+
+// The controller takes 10 bit words: RS, R/W, then D7-D0. Consecutive words
+// are packed back to back so that a whole update is one SPI transfer. A row is
+// a DDRAM address command followed by one data word per column.
+#define DISPLAY_WORD_BITS 10
+#define DISPLAY_ROW_WORDS (DISPLAY_COLUMNS + 1)
+#define DISPLAY_FRAME_SIZE ((2 * DISPLAY_ROW_WORDS * DISPLAY_WORD_BITS + 7) / 8)
+
+#define DISPLAY_DATA_WORD(c) (0x200 | (uint8_t)(c))
+
+typedef struct {
+  uint8_t data[DISPLAY_FRAME_SIZE];
+  uint16_t bits;
+} display_frame_t;
+
+// Read the busy flag and address counter
+#define DISPLAY_READ_STATUS 0x100
+
+// Longest the controller takes to carry out a command. Clear and home take
+// up to 6.2 ms, everything else well under 1 ms
+#define DISPLAY_CLEAR_US 6200
+#define DISPLAY_COMMAND_US 1000
+
+// DDRAM address commands for the start of each row (0x00 and 0x40)
+static const uint16_t row_address[2] = {0x080, 0x0C0};
+
+typedef struct {
+  uint16_t word;
+  uint16_t max_us; // stop waiting on the busy flag after this long
+} init_command_t;
+
+// The busy flag is read after each command until it clears or the command's
+// worst case time has passed, so a flag that never clears, e.g. from a
+// floating MISO, costs at most DISPLAY_INIT_MAX_US in total
+static const init_command_t init_commands[] = {
+  {0x038, DISPLAY_COMMAND_US}, // Set function 8 bit mode, two lines
+  {0x008, DISPLAY_COMMAND_US}, // Turn display off
+  {0x001, DISPLAY_CLEAR_US},   // Clear display
+  {0x006, DISPLAY_COMMAND_US}, // Set entry mode to increment right no shift
+  {0x002, DISPLAY_CLEAR_US},   // Move cursor home
+  {0x00D, DISPLAY_COMMAND_US}, // Turn display on
+};
+
+#define DISPLAY_INIT_MAX_US (2 * DISPLAY_CLEAR_US + 4 * DISPLAY_COMMAND_US)
 
 static nrf_drv_spi_t* spi_instance;
 
-ret_code_t display_init(nrf_drv_spi_t* spi) {
-  spi_instance = spi;
+// contents last written or posted to each row, padded with spaces
+static char rows[2][DISPLAY_COLUMNS];
 
-  uint8_t write[2];
+// non-blocking mode state
+static bool async;
+static display_done_handler_t done_handler;
+static void* done_context;
+static display_frame_t frames[2];
+static uint8_t front;
+static uint8_t dirty_rows;
+static volatile bool in_flight;
+static volatile bool back_ready;
 
-  // Set function 8 bit mode
-  write[0] = 0b00001110;
-  write[1] = 0b00000000;
-  ret_code_t err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
-  if (err_code != NRF_SUCCESS) {
-    return err_code;
+// init sequence state
+typedef enum {
+  INIT_IDLE,
+  INIT_COMMAND,
+  INIT_STATUS,
+  INIT_DONE,
+} init_state_t;
+
+static volatile init_state_t init_state;
+static uint8_t init_index;
+static uint64_t init_start_us;
+static uint64_t command_deadline_us;
+static uint32_t init_duration_us;
+static uint8_t init_tx[2];
+static uint8_t init_rx[2];
+
+static void frame_append(display_frame_t* frame, uint16_t word) {
+  for (int8_t bit = DISPLAY_WORD_BITS - 1; bit >= 0; bit--) {
+    if (word & (1 << bit)) {
+      frame->data[frame->bits / 8] |= 0x80 >> (frame->bits % 8);
+    }
+    frame->bits++;
   }
-  nrf_delay_ms(10);
+}
 
-  // Turn display off
-  write[0] = 0b00000010;
-  write[1] = 0b00000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
-  if (err_code != NRF_SUCCESS) {
-    return err_code;
+// Encode the rows selected by row_mask into a single frame
+static void frame_encode(display_frame_t* frame, uint8_t row_mask) {
+  memset(frame, 0, sizeof(display_frame_t));
+  for (uint8_t row = 0; row < 2; row++) {
+    if (row_mask & (1 << row)) {
+      frame_append(frame, row_address[row]);
+      for (uint8_t i = 0; i < DISPLAY_COLUMNS; i++) {
+        frame_append(frame, DISPLAY_DATA_WORD(rows[row][i]));
+      }
+    }
   }
-  nrf_delay_ms(10);
+}
 
-  // Clear display
-  write[0] = 0b00000000;
-  write[1] = 0b01000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
-  if (err_code != NRF_SUCCESS) {
-    return err_code;
+// Copy a string into the row shadow, padding with spaces to clear the rest of
+// the row. Returns true if the row contents changed
+static bool row_update(uint8_t row, const char* string, uint32_t len) {
+  char padded[DISPLAY_COLUMNS];
+  memset(padded, ' ', DISPLAY_COLUMNS);
+  memcpy(padded, string, len);
+
+  if (memcmp(rows[row], padded, DISPLAY_COLUMNS) == 0) {
+    return false;
   }
-  nrf_delay_ms(10);
+  memcpy(rows[row], padded, DISPLAY_COLUMNS);
+  return true;
+}
 
-  // Set entry mode to increment right no shift
-  write[0] = 0b00000001;
-  write[1] = 0b10000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
+// Start a transfer, marking it in flight if it will complete asynchronously
+static ret_code_t transfer(uint8_t const* tx, uint8_t tx_len, uint8_t* rx, uint8_t rx_len) {
+  in_flight = async;
+  ret_code_t err_code = nrf_drv_spi_transfer(spi_instance, tx, tx_len, rx, rx_len);
   if (err_code != NRF_SUCCESS) {
-    return err_code;
+    in_flight = false;
   }
-  nrf_delay_ms(10);
+  return err_code;
+}
 
-  // Move cursor home
-  write[0] = 0b00000000;
-  write[1] = 0b10000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
-  if (err_code != NRF_SUCCESS) {
-    return err_code;
+// Swap the back buffer to the front and start sending it
+// Must be called from the SPI interrupt or with interrupts disabled
+static ret_code_t frame_start(void) {
+  front ^= 1;
+  dirty_rows = 0;
+  back_ready = false;
+
+  display_frame_t* frame = &frames[front];
+  return transfer(frame->data, (frame->bits + 7) / 8, NULL, 0);
+}
+
+static ret_code_t init_send_command(void) {
+  uint16_t word = init_commands[init_index].word;
+  init_tx[0] = word >> 2;
+  init_tx[1] = (word & 0x3) << 6;
+  init_state = INIT_COMMAND;
+  return transfer(init_tx, 2, NULL, 0);
+}
+
+static ret_code_t init_read_status(void) {
+  init_tx[0] = DISPLAY_READ_STATUS >> 2;
+  init_tx[1] = (DISPLAY_READ_STATUS & 0x3) << 6;
+  init_state = INIT_STATUS;
+  return transfer(init_tx, 2, init_rx, 2);
+}
+
+// Advance the init sequence once the previous transfer has completed
+//
+// Every command is followed by busy flag reads until the controller is ready
+// for the next one, rather than a fixed delay
+static ret_code_t init_advance(void) {
+  switch (init_state) {
+    case INIT_COMMAND:
+      command_deadline_us = rtc_time_us() + init_commands[init_index].max_us;
+      return init_read_status();
+
+    case INIT_STATUS:
+      // D7 of the status word is clocked back in the third bit
+      if ((init_rx[0] & 0x20) && rtc_time_us() < command_deadline_us) {
+        return init_read_status();
+      }
+      init_index++;
+      if (init_index < sizeof(init_commands) / sizeof(init_commands[0])) {
+        return init_send_command();
+      }
+      init_duration_us = rtc_time_us() - init_start_us;
+      init_state = INIT_DONE;
+      return NRF_SUCCESS;
+
+    default:
+      return NRF_SUCCESS;
   }
-  nrf_delay_ms(10);
+}
 
-  // Move cursor home
-  write[0] = 0b00000011;
-  write[1] = 0b01000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
+static ret_code_t init_start(nrf_drv_spi_t* spi) {
+  ret_code_t err_code = rtc_time_init();
   if (err_code != NRF_SUCCESS) {
     return err_code;
   }
-  nrf_delay_ms(10);
 
-  // Read the status bit
-  write[0] = 0b01000000;
-  write[1] = 0b00000000;
-  err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-  APP_ERROR_CHECK(err_code);
-  if (err_code != NRF_SUCCESS) {
-    return err_code;
+  spi_instance = spi;
+  init_index = 0;
+  dirty_rows = 0;
+  back_ready = false;
+
+  // the sequence clears the display
+  memset(rows, ' ', sizeof(rows));
+
+  init_start_us = rtc_time_us();
+  init_duration_us = 0;
+  return init_send_command();
+}
+
+ret_code_t display_init(nrf_drv_spi_t* spi) {
+  async = false;
+
+  ret_code_t err_code = init_start(spi);
+  while (err_code == NRF_SUCCESS && init_state != INIT_DONE) {
+    err_code = init_advance();
   }
-  nrf_delay_ms(10);
+  APP_ERROR_CHECK(err_code);
 
-  return NRF_SUCCESS;
+  return err_code;
 }
 
-ret_code_t display_write(const char* string, uint8_t row) {
+ret_code_t display_init_async(nrf_drv_spi_t* spi, display_done_handler_t handler, void* context) {
+  async = true;
+  done_handler = handler;
+  done_context = context;
 
-  uint32_t len = strlen(string);
-  if (len > 16) {
-    return NRF_ERROR_INVALID_LENGTH;
+  ret_code_t err_code = init_start(spi);
+  APP_ERROR_CHECK(err_code);
+
+  return err_code;
+}
+
+bool display_ready(void) {
+  return init_state == INIT_DONE;
+}
+
+uint32_t display_init_time_us(void) {
+  return init_duration_us;
+}
+
+void display_spi_evt_handler(nrf_drv_spi_evt_t const* event, void* context) {
+  if (event->type != NRF_DRV_SPI_EVENT_DONE) {
+    return;
   }
 
-  // Set up a spi transfer struct
-  uint8_t write[2];
-
-  ret_code_t err_code;
-  if (row == 0) {
-    // Set the screen to the correct character (0)
-    write[0] = 0b00100000;
-    write[1] = 0b00000000;
-    err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-    APP_ERROR_CHECK(err_code);
-    if(err_code != NRF_SUCCESS) return err_code;
-
-  } else if (row == 1) {
-    // Set the screen to the correct character (0x40)
-    write[0] = 0b00110000;
-    write[1] = 0b00000000;
-    err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-    APP_ERROR_CHECK(err_code);
-    if(err_code != NRF_SUCCESS) return err_code;
-  } else {
-    return NRF_ERROR_INVALID_DATA;
+  in_flight = false;
+  if (init_state != INIT_DONE) {
+    APP_ERROR_CHECK(init_advance());
+    if (in_flight) {
+      return;
+    }
+  } else if (done_handler != NULL) {
+    done_handler(done_context);
+  }
+
+  // start whatever was posted while the bus was busy
+  if (back_ready) {
+    APP_ERROR_CHECK(frame_start());
   }
+}
 
-  // Now write the characters of the string then clear the line
-  uint8_t base_char[2];
-  base_char[0] = 0b10000000;
-  base_char[1] = 0b00000000;
-  for (uint8_t i = 0; i < 16; i++) {
-    char to_write;
+ret_code_t display_post(const char* line0, const char* line1) {
+  const char* strings[2] = {line0, line1};
+  uint32_t lens[2] = {0, 0};
 
-    if (i >= len) {
-      //write spaces as padding to clear that row
-      to_write = ' ';
-    } else {
-      to_write = string[i];
+  for (uint8_t row = 0; row < 2; row++) {
+    if (strings[row] != NULL) {
+      lens[row] = strlen(strings[row]);
+      if (lens[row] > DISPLAY_COLUMNS) {
+        return NRF_ERROR_INVALID_LENGTH;
+      }
     }
+  }
 
-    // write the character
-    // the top 6 bits then the bottom two bits
-    write[0] = base_char[0] | (to_write >> 2);
-    write[1] = base_char[1] | (to_write << 6);
-    err_code = nrf_drv_spi_transfer(spi_instance, write, 2, NULL, 0);
-    APP_ERROR_CHECK(err_code);
-    if (err_code != NRF_SUCCESS) {
-      return err_code;
+  if (!async) {
+    for (uint8_t row = 0; row < 2; row++) {
+      if (strings[row] != NULL) {
+        ret_code_t err_code = display_write(strings[row], row);
+        if (err_code != NRF_SUCCESS) {
+          return err_code;
+        }
+      }
     }
+    return NRF_SUCCESS;
   }
 
-  return NRF_SUCCESS;
+  // take the back buffer away from the interrupt handler while it is rewritten
+  CRITICAL_REGION_ENTER();
+  back_ready = false;
+  CRITICAL_REGION_EXIT();
+
+  for (uint8_t row = 0; row < 2; row++) {
+    if (strings[row] != NULL && row_update(row, strings[row], lens[row])) {
+      dirty_rows |= (1 << row);
+    }
+  }
+  if (dirty_rows == 0) {
+    return NRF_SUCCESS;
+  }
+  frame_encode(&frames[front ^ 1], dirty_rows);
+
+  ret_code_t err_code = NRF_SUCCESS;
+  CRITICAL_REGION_ENTER();
+  back_ready = true;
+  if (!in_flight && init_state == INIT_DONE) {
+    err_code = frame_start();
+  }
+  CRITICAL_REGION_EXIT();
+
+  return err_code;
+}
+
+bool display_busy(void) {
+  return in_flight || back_ready;
 }
 
+ret_code_t display_write(const char* string, uint8_t row) {
+
+  uint32_t len = strlen(string);
+  if (len > DISPLAY_COLUMNS) {
+    return NRF_ERROR_INVALID_LENGTH;
+  }
+  if (row > 1) {
+    return NRF_ERROR_INVALID_DATA;
+  }
+
+  if (async) {
+    return display_post(row == 0 ? string : NULL, row == 1 ? string : NULL);
+  }
+
+  // skip the transfer if the row already shows this string
+  if (!row_update(row, string, len)) {
+    return NRF_SUCCESS;
+  }
+
+  // Move to the start of the row, then write the characters of the string
+  // followed by spaces to clear the rest of the line, all in one transfer
+  static display_frame_t frame;
+  frame_encode(&frame, 1 << row);
+  ret_code_t err_code = nrf_drv_spi_transfer(spi_instance, frame.data, (frame.bits + 7) / 8, NULL, 0);
+  APP_ERROR_CHECK(err_code);
+
+  return err_code;
+}
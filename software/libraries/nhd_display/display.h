@@ -4,20 +4,69 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "app_error.h"
 #include "nrf_drv_spi.h"
 
 #define DISPLAY_LINE_0 0
 #define DISPLAY_LINE_1 1
 
+// Characters per display row
+#define DISPLAY_COLUMNS 16
+
+// Called once an asynchronous display update has been clocked out
+// Runs in the SPI interrupt context
+typedef void (*display_done_handler_t)(void* context);
+
 // Initialize the display
 //
+// spi - pointer to an already initialized SPI instance with no event handler
+//
+// Polls the controller busy flag between commands instead of waiting a fixed
+//  time. Each command waits at most its worst case time, so init takes no
+//  more than about 16 ms even if the flag never reads clear
 // Returns success or an error code
 ret_code_t display_init(nrf_drv_spi_t* spi);
 
+// Initialize the display for non-blocking updates
+//
+// spi - pointer to an SPI instance initialized with `display_spi_evt_handler`
+//  as its event handler
+// handler - called after each update completes, may be NULL
+// context - passed through to the handler
+//
+// Returns immediately. The init sequence runs from the SPI interrupt so it
+//  overlaps with other initialization, and rows written before it finishes
+//  are shown once it does
+// Returns success or an error code
+ret_code_t display_init_async(nrf_drv_spi_t* spi, display_done_handler_t handler, void* context);
+
+// Returns true once the display init sequence has finished
+bool display_ready(void);
+
+// How long the init sequence took, 0 until it finishes
+uint32_t display_init_time_us(void);
+
+// SPI event handler for non-blocking display updates
+//
+// Pass this to nrf_drv_spi_init() before calling display_init_async()
+void display_spi_evt_handler(nrf_drv_spi_evt_t const* event, void* context);
+
 // Write to the display
 // String is a null terminated c string with max length of 16 characters
 // Row may either be set to 0 or 1
+// Rows that already show the string are not rewritten
+// In non-blocking mode this posts the row and returns immediately
 // Returns success or an error code
 ret_code_t display_write(const char* string, uint8_t row);
 
+// Post an update to both rows of the display
+// Either string may be NULL to leave that row unchanged
+// The update is encoded into the idle half of a double buffer and sent as a
+//  single SPI transfer. Posting again before it starts replaces it.
+// Returns success or an error code
+ret_code_t display_post(const char* line0, const char* line1);
+
+// Returns true while a non-blocking update is in flight or waiting to start
+bool display_busy(void);
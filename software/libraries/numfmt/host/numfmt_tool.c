@@ -0,0 +1,284 @@
+// Host tool for numfmt
+//
+// Builds on Linux from the same source as the robot and checks the formatter
+// against the C library's printf, then measures both.
+//
+// usage: numfmt_tool check [precision [stride]]
+//        numfmt_tool bench
+//
+// check compares numfmt_float() with "%.*f" for every float bit pattern,
+// or every stride'th one, at one precision, and compares numfmt_fixed() and
+// numfmt_int() on every small value and a spread of large ones at every
+// precision. printf rounds exact ties to even and numfmt rounds them away
+// from zero, so ties are checked against that rule instead. bench times both
+// on the kinds of values the robot apps display.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "numfmt.h"
+
+#define BUF_SIZE 48
+
+static const uint64_t pow10[NUMFMT_MAX_PRECISION + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+static uint64_t failures;
+
+static void report(const char* what, const char* expected, const char* got) {
+  if (failures++ < 20) {
+    printf("%s: expected \"%s\", got \"%s\"\n", what, expected, got);
+  }
+}
+
+// Expected text for the exact value negative, scaled / 10^precision, where
+// scaled is exact and may have a fractional part. Exact ties round away from
+// zero, and everything else matches printf, which rounds correctly
+static void expected_text(char* buf, bool negative, long double scaled, long double value, uint8_t precision) {
+  long double whole = floorl(scaled);
+  if (scaled - whole != 0.5L) {
+    snprintf(buf, BUF_SIZE, "%s%.*Lf", negative ? "-" : "", precision, fabsl(value));
+    return;
+  }
+
+  uint64_t digits = (uint64_t)whole + 1;
+  uint64_t scale = pow10[precision];
+  int len = snprintf(buf, BUF_SIZE, "%s%llu", negative ? "-" : "", (unsigned long long)(digits / scale));
+  if (precision > 0) {
+    char* fraction = buf + len;
+    uint64_t fdigits = digits % scale;
+    *fraction++ = '.';
+    for (uint8_t i = precision; i > 0; i--) {
+      fraction[i - 1] = '0' + fdigits % 10;
+      fdigits /= 10;
+    }
+    fraction[precision] = '\0';
+  }
+}
+
+static void check_float(uint32_t bits, uint8_t precision) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  char got[BUF_SIZE];
+  int len = numfmt_float(got, sizeof(got), value, precision, 0);
+
+  char expected[BUF_SIZE];
+  if (isnan(value)) {
+    strcpy(expected, "nan");
+  } else if (isinf(value)) {
+    strcpy(expected, value < 0 ? "-inf" : "inf");
+  } else if (fabsf(value) >= 4294967296.0f) {
+    // doesn't fit, unless it rounds up past 2^32 - 1, which floats can't reach
+    if (len != -1 || strcmp(got, NUMFMT_OVERFLOW) != 0) {
+      report("float out of range", NUMFMT_OVERFLOW, got);
+    }
+    return;
+  } else {
+    long double exact = value;
+    expected_text(expected, signbit(value), fabsl(exact) * pow10[precision], exact, precision);
+  }
+
+  if (len != (int)strlen(expected) || strcmp(got, expected) != 0) {
+    char what[64];
+    snprintf(what, sizeof(what), "float 0x%08x %%.%uf", bits, precision);
+    report(what, expected, got);
+  }
+}
+
+static void check_fixed(int32_t value, uint8_t frac_bits, uint8_t precision) {
+  char got[BUF_SIZE];
+  int len = numfmt_fixed(got, sizeof(got), value, frac_bits, precision, 0);
+
+  long double exact = ldexpl(value, -frac_bits);
+  char expected[BUF_SIZE];
+  expected_text(expected, value < 0, fabsl(exact) * pow10[precision], exact, precision);
+
+  if (len != (int)strlen(expected) || strcmp(got, expected) != 0) {
+    char what[64];
+    snprintf(what, sizeof(what), "fixed %d Q%u %%.%uf", value, frac_bits, precision);
+    report(what, expected, got);
+  }
+}
+
+static void check_int(int32_t value, int8_t width) {
+  char got[BUF_SIZE];
+  char expected[BUF_SIZE];
+  int len = numfmt_int(got, sizeof(got), value, width);
+  snprintf(expected, sizeof(expected), "%*d", width, value);
+  if (len != (int)strlen(expected) || strcmp(got, expected) != 0) {
+    char what[64];
+    snprintf(what, sizeof(what), "int %d width %d", value, width);
+    report(what, expected, got);
+  }
+}
+
+// Values both near zero and spread over the whole range
+static int32_t spread(uint32_t i) {
+  uint32_t hash = i * 2654435761u;
+  return (int32_t)(hash >> (i % 32));
+}
+
+static int check(uint8_t precision, uint32_t stride) {
+  uint64_t floats = 0;
+  for (uint64_t bits = 0; bits <= UINT32_MAX; bits += stride) {
+    check_float((uint32_t)bits, precision);
+    floats++;
+  }
+  printf("%llu floats at %%.%uf\n", (unsigned long long)floats, precision);
+
+  uint64_t fixed = 0;
+  for (uint8_t frac_bits = 0; frac_bits < 32; frac_bits++) {
+    for (uint8_t p = 0; p <= NUMFMT_MAX_PRECISION; p++) {
+      for (int32_t value = -4096; value <= 4096; value++) {
+        check_fixed(value, frac_bits, p);
+      }
+      for (uint32_t i = 0; i < 20000; i++) {
+        check_fixed(spread(i), frac_bits, p);
+      }
+      check_fixed(INT32_MIN, frac_bits, p);
+      check_fixed(INT32_MAX, frac_bits, p);
+      fixed += 8193 + 20000 + 2;
+    }
+  }
+  printf("%llu fixed-point values at every precision\n", (unsigned long long)fixed);
+
+  uint64_t ints = 0;
+  for (int8_t width = -20; width <= 20; width += 5) {
+    for (int32_t value = -100000; value <= 100000; value++) {
+      check_int(value, width);
+    }
+    for (uint32_t i = 0; i < 200000; i++) {
+      check_int(spread(i), width);
+    }
+    check_int(INT32_MIN, width);
+    check_int(INT32_MAX, width);
+    ints += 200001 + 200000 + 2;
+  }
+  printf("%llu integers at widths -20 to 20\n", (unsigned long long)ints);
+
+  // a line built from pieces, and values that don't fit
+  char line[17];
+  int len = numfmt_str(line, sizeof(line), "TURNING: ");
+  len += numfmt_float(line + len, sizeof(line) - len, -123.456f, 2, 0);
+  if (len != 16 || strcmp(line, "TURNING: -123.46") != 0) {
+    report("line", "TURNING: -123.46", line);
+  }
+  if (numfmt_float(line, 8, -123.456f, 2, 0) != 7 || numfmt_float(line, 7, -123.456f, 2, 0) != -1 ||
+      strcmp(line, NUMFMT_OVERFLOW) != 0) {
+    report("buffer size", "-123.46, then " NUMFMT_OVERFLOW, line);
+  }
+  // the marker itself is cut to a buffer too small for it
+  if (numfmt_float(line, 3, -123.456f, 2, 0) != -1 || strcmp(line, "##") != 0) {
+    report("small buffer", "##", line);
+  }
+  if (numfmt_float(line, sizeof(line), 1.0f, NUMFMT_MAX_PRECISION + 1, 0) != -1 ||
+      strcmp(line, NUMFMT_OVERFLOW) != 0) {
+    report("precision", NUMFMT_OVERFLOW, line);
+  }
+
+  printf("%llu failures\n", (unsigned long long)failures);
+  return failures == 0 ? 0 : 1;
+}
+
+// Bench
+
+#define BENCH_VALUES 4096
+#define BENCH_ROUNDS 200
+
+static double elapsed_ns(const struct timespec* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static volatile int sink;
+
+static void bench_float(const char* what, const float* values, uint8_t precision) {
+  char buf[BUF_SIZE];
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+      sink += numfmt_float(buf, sizeof(buf), values[i], precision, 0);
+    }
+  }
+  double numfmt_ns = elapsed_ns(&start) / (BENCH_ROUNDS * BENCH_VALUES);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+      sink += snprintf(buf, sizeof(buf), "%.*f", precision, values[i]);
+    }
+  }
+  double printf_ns = elapsed_ns(&start) / (BENCH_ROUNDS * BENCH_VALUES);
+
+  printf("%-28s numfmt %6.1f ns  snprintf %6.1f ns  %4.1fx\n", what, numfmt_ns, printf_ns,
+      printf_ns / numfmt_ns);
+}
+
+static int bench(void) {
+  static float angles[BENCH_VALUES];
+  static float distances[BENCH_VALUES];
+  static int32_t fixed[BENCH_VALUES];
+  for (int i = 0; i < BENCH_VALUES; i++) {
+    angles[i] = (spread(i) % 36000) / 100.0f;
+    distances[i] = (spread(i) % 500000) / 1000.0f;
+    fixed[i] = spread(i) % (1000 << 16);
+  }
+
+  bench_float("angle, %.2f", angles, 2);
+  bench_float("distance, %.6f", distances, 6);
+
+  char buf[BUF_SIZE];
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+      sink += numfmt_fixed(buf, sizeof(buf), fixed[i], 16, 3, 0);
+    }
+  }
+  double fixed_ns = elapsed_ns(&start) / (BENCH_ROUNDS * BENCH_VALUES);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (int i = 0; i < BENCH_VALUES; i++) {
+      sink += numfmt_int(buf, sizeof(buf), fixed[i], 0);
+    }
+  }
+  double int_ns = elapsed_ns(&start) / (BENCH_ROUNDS * BENCH_VALUES);
+  printf("Q16 fixed, 3 digits         numfmt %6.1f ns\n", fixed_ns);
+  printf("integer                     numfmt %6.1f ns\n", int_ns);
+  return 0;
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: numfmt_tool check [precision [stride]]\n"
+                  "       numfmt_tool bench\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return usage();
+  }
+
+  if (strcmp(argv[1], "check") == 0) {
+    uint32_t precision = argc > 2 ? strtoul(argv[2], NULL, 0) : 2;
+    uint32_t stride = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+    if (precision > NUMFMT_MAX_PRECISION || stride == 0) {
+      return usage();
+    }
+    return check(precision, stride);
+  }
+
+  if (strcmp(argv[1], "bench") == 0) {
+    return bench();
+  }
+
+  return usage();
+}
@@ -0,0 +1,176 @@
+// Number formatting without printf
+//
+// Converts integers, fixed-point and floating point values to decimal strings
+// in caller-provided buffers. Useful for display and log output in loops where
+// snprintf() is too slow.
+
+#include <string.h>
+
+#include "numfmt.h"
+
+// sign, 10 integer digits, decimal point and fraction digits
+#define NUMFMT_BODY_SIZE (1 + 10 + 1 + NUMFMT_MAX_PRECISION)
+
+static const uint32_t pow10[NUMFMT_MAX_PRECISION + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+static int fail(char* buf, size_t size) {
+  if (size > 0) {
+    size_t len = size - 1 < sizeof(NUMFMT_OVERFLOW) - 1 ? size - 1 : sizeof(NUMFMT_OVERFLOW) - 1;
+    memcpy(buf, NUMFMT_OVERFLOW, len);
+    buf[len] = '\0';
+  }
+  return -1;
+}
+
+// Copy a formatted number into the destination, adding width padding
+static int pad_and_copy(char* buf, size_t size, const char* body, uint8_t len, int8_t width) {
+  uint8_t columns = width < 0 ? -width : width;
+  uint8_t pad = columns > len ? columns - len : 0;
+  if ((size_t)len + pad + 1 > size) {
+    return fail(buf, size);
+  }
+
+  char* out = buf;
+  if (width > 0) {
+    memset(out, ' ', pad);
+    out += pad;
+  }
+  memcpy(out, body, len);
+  out += len;
+  if (width < 0) {
+    memset(out, ' ', pad);
+    out += pad;
+  }
+  *out = '\0';
+
+  return len + pad;
+}
+
+// Format a value given as its sign, integer part and fractional part
+//
+// frac is the fraction in units of 2^-64
+static int format_parts(char* buf, size_t size, bool negative, uint32_t ipart, uint64_t frac,
+    uint8_t precision, int8_t width) {
+  if (precision > NUMFMT_MAX_PRECISION) {
+    return fail(buf, size);
+  }
+
+  // round the fraction to the requested number of digits, carrying into the
+  // integer part if it rounds up to one. The 96 bit product frac * scale is
+  // built from two 32x32 multiplies, and its low 32 bits cannot affect the
+  // rounded result
+  uint32_t scale = pow10[precision];
+  uint64_t high = (frac >> 32) * scale;
+  uint64_t low = (frac & 0xFFFFFFFF) * scale;
+  uint32_t fdigits = (high + (low >> 32) + 0x80000000u) >> 32;
+  if (fdigits >= scale) {
+    if (ipart == UINT32_MAX) {
+      return fail(buf, size);
+    }
+    fdigits -= scale;
+    ipart++;
+  }
+
+  char digits[10];
+  uint8_t ndigits = 0;
+  do {
+    digits[ndigits++] = '0' + ipart % 10;
+    ipart /= 10;
+  } while (ipart != 0);
+
+  char body[NUMFMT_BODY_SIZE];
+  uint8_t len = 0;
+  if (negative) {
+    body[len++] = '-';
+  }
+  while (ndigits > 0) {
+    body[len++] = digits[--ndigits];
+  }
+  if (precision > 0) {
+    body[len++] = '.';
+    for (uint8_t i = precision; i > 0; i--) {
+      body[len + i - 1] = '0' + fdigits % 10;
+      fdigits /= 10;
+    }
+    len += precision;
+  }
+
+  return pad_and_copy(buf, size, body, len, width);
+}
+
+int numfmt_int(char* buf, size_t size, int32_t value, int8_t width) {
+  bool negative = value < 0;
+  uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+  return format_parts(buf, size, negative, magnitude, 0, 0, width);
+}
+
+int numfmt_fixed(char* buf, size_t size, int32_t value, uint8_t frac_bits, uint8_t precision, int8_t width) {
+  if (frac_bits > 31) {
+    return fail(buf, size);
+  }
+
+  bool negative = value < 0;
+  uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+  uint32_t ipart = magnitude >> frac_bits;
+  uint64_t frac = frac_bits > 0 ? (uint64_t)magnitude << (64 - frac_bits) : 0;
+
+  return format_parts(buf, size, negative, ipart, frac, precision, width);
+}
+
+int numfmt_float(char* buf, size_t size, float value, uint8_t precision, int8_t width) {
+  // split the float into its fields so the conversion is exact and needs no
+  // floating point operations
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bool negative = bits >> 31;
+  int16_t exponent = (bits >> 23) & 0xFF;
+  uint64_t mantissa = bits & 0x7FFFFF;
+
+  if (exponent == 0xFF) {
+    if (mantissa != 0) {
+      return pad_and_copy(buf, size, "nan", 3, width);
+    }
+    return negative ? pad_and_copy(buf, size, "-inf", 4, width) : pad_and_copy(buf, size, "inf", 3, width);
+  }
+
+  // value = mantissa * 2^exponent
+  if (exponent == 0) {
+    exponent = -149;
+  } else {
+    mantissa |= 0x800000;
+    exponent -= 150;
+  }
+
+  uint32_t ipart = 0;
+  uint64_t frac = 0;
+  if (exponent >= 0) {
+    if (exponent > 8) {
+      // integer part needs more than 32 bits
+      return fail(buf, size);
+    }
+    ipart = mantissa << exponent;
+  } else if (exponent > -64) {
+    if (exponent > -24) {
+      ipart = mantissa >> -exponent;
+    }
+    frac = mantissa << (64 + exponent);
+  } else if (exponent > -(64 + 24)) {
+    // bits below 2^-64 are dropped, far below the last printed digit
+    frac = mantissa >> (-64 - exponent);
+  }
+
+  return format_parts(buf, size, negative, ipart, frac, precision, width);
+}
+
+int numfmt_str(char* buf, size_t size, const char* string) {
+  size_t len = strlen(string);
+  if (len + 1 > size) {
+    return fail(buf, size);
+  }
+  memcpy(buf, string, len + 1);
+
+  return len;
+}
@@ -0,0 +1,45 @@
+// Number formatting without printf
+//
+// Converts integers, fixed-point and floating point values to decimal strings
+// in caller-provided buffers. Useful for display and log output in loops where
+// snprintf() is too slow.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest number of digits after the decimal point
+#define NUMFMT_MAX_PRECISION 9
+
+// Written in place of a result that does not fit, cut to the buffer size
+#define NUMFMT_OVERFLOW "###"
+
+// All functions take the destination buffer and its size in bytes and always
+// null terminate on success.
+//
+// width pads the result with spaces to at least that many characters. A
+// positive width right aligns the number like "%*f", a negative width left
+// aligns it like "%-*f", and 0 adds no padding.
+//
+// Returns the number of characters written, not counting the terminator, so
+// calls can be chained to build a line. Returns -1 and writes NUMFMT_OVERFLOW
+// if the result does not fit or precision is above NUMFMT_MAX_PRECISION, so a
+// display shows that something is missing rather than nothing.
+
+// Format a signed integer, like "%*ld"
+int numfmt_int(char* buf, size_t size, int32_t value, int8_t width);
+
+// Format a signed fixed-point value with frac_bits fractional bits (Q format),
+// like "%*.*f" of value / 2^frac_bits
+int numfmt_fixed(char* buf, size_t size, int32_t value, uint8_t frac_bits, uint8_t precision, int8_t width);
+
+// Format a float, like "%*.*f"
+//
+// Ties round away from zero. Values with a magnitude of 2^32 or more do not
+// fit and return -1. NaN and infinity are written as "nan" and "inf".
+int numfmt_float(char* buf, size_t size, float value, uint8_t precision, int8_t width);
+
+// Append a string, like "%s"
+int numfmt_str(char* buf, size_t size, const char* string);
@@ -0,0 +1,287 @@
+// Host tool for the PID controller
+//
+// Builds on Linux from the same source as the robot, closes the loop around
+// simulated plants and checks the step responses, then times updates.
+//
+// usage: pid_tool step
+//        pid_tool bench
+//
+// step drives a wheel speed plant and a heading plant like the Kobuki's and
+// checks settling, overshoot and steady state error, that jittered call
+// times give the same response as regular ones, that back-calculation stops
+// windup, that a setpoint step doesn't kick the derivative, and that a batch
+// update matches separate ones. bench reports the time and cycles per
+// update.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "pid.h"
+
+// Plants are integrated at 1 kHz, the controller runs every 20 ms like the
+// robot control loops
+#define SIM_STEP_US 1000
+#define CONTROL_PERIOD_US 20000
+
+static uint32_t failures;
+
+static void expect(bool ok, const char* what) {
+  printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+
+// repeatable noise, uniform in [-amplitude, amplitude]
+static uint32_t seed = 1;
+static int32_t noise(int32_t amplitude) {
+  seed = seed * 1664525 + 1013904223;
+  return (int32_t)((seed >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+typedef enum {
+  PLANT_WHEEL,   // speed, first order lag from command to mm/s
+  PLANT_HEADING, // angle, command is deg/s, integrated
+} plant_t;
+
+typedef struct {
+  float peak;      // furthest value past the setpoint, as a fraction of it
+  float settle_s;  // time until within 2% of the setpoint for good
+  float final;     // mean over the last second
+  int32_t max_command;
+} response_t;
+
+// Step the setpoint from 0 and run for seconds, calling the controller every
+// period_us plus up to jitter_us either way
+static response_t run_step(plant_t plant, const pid_config_t* config, int32_t setpoint,
+    uint32_t seconds, uint32_t jitter_us) {
+  pid_loop_t pid;
+  pid_init(&pid, config);
+
+  float value = 0;
+  int32_t command = 0;
+  uint32_t now = 0x7ffff000; // start near a 32 bit boundary so now wraps
+  uint32_t next_control = now;
+  response_t r = {0};
+  float band = abs(setpoint) * 0.02f;
+  uint32_t end_us = seconds * 1000000;
+  float sum = 0;
+  uint32_t samples = 0;
+
+  for (uint32_t t = 0; t < end_us; t += SIM_STEP_US, now += SIM_STEP_US) {
+    if ((int32_t)(now - next_control) >= 0) {
+      command = pid_update(&pid, setpoint, lroundf(value), now);
+      next_control = now + CONTROL_PERIOD_US + (jitter_us ? noise(jitter_us / SIM_STEP_US) * SIM_STEP_US : 0);
+      if (abs(command) > r.max_command) {
+        r.max_command = abs(command);
+      }
+    }
+
+    float dt = SIM_STEP_US / 1e6f;
+    if (plant == PLANT_WHEEL) {
+      value += (command - value) * dt / 0.1f; // 100 ms time constant
+    } else {
+      value += command * dt;
+    }
+
+    float over = (value - setpoint) / setpoint;
+    if (over > r.peak) {
+      r.peak = over;
+    }
+    if (fabsf(value - setpoint) > band) {
+      r.settle_s = (t + SIM_STEP_US) / 1e6f;
+    }
+    if (t >= end_us - 1000000) {
+      sum += value;
+      samples++;
+    }
+  }
+  r.final = sum / samples;
+  return r;
+}
+
+static void print_response(const char* name, const response_t* r, int32_t setpoint) {
+  printf("%s: overshoot %.1f%%, settles in %.2f s, final %.2f of %d, peak command %d\n", name,
+      100 * r->peak, r->settle_s, r->final, setpoint, r->max_command);
+}
+
+static const pid_config_t wheel_config = {
+  .kp = PID_GAIN(1.5),
+  .ki = PID_GAIN(8.0),
+  .kd = 0,
+  .kt = PID_GAIN(10.0),
+  .min = -500,
+  .max = 500,
+  .deadband = 0,
+  .d_filter_shift = 0,
+};
+
+static const pid_config_t heading_config = {
+  .kp = PID_GAIN(3.0),
+  .ki = PID_GAIN(2.0),
+  .kd = PID_GAIN(0.1),
+  .kt = PID_GAIN(5.0),
+  .min = -90,
+  .max = 90,
+  .deadband = 0,
+  .d_filter_shift = 2,
+};
+
+static int step(void) {
+  // wheel speed, 300 mm/s step within the 500 command limit
+  response_t wheel = run_step(PLANT_WHEEL, &wheel_config, 300, 5, 0);
+  print_response("wheel speed", &wheel, 300);
+  expect(wheel.peak < 0.10f, "overshoot under 10%");
+  expect(wheel.settle_s < 1.0f, "settles within 1 s");
+  expect(fabsf(wheel.final - 300) < 1.0f, "no steady state error");
+
+  // the same with calls 10 to 30 ms apart
+  response_t jittered = run_step(PLANT_WHEEL, &wheel_config, 300, 5, 10000);
+  print_response("wheel speed, +-10 ms jitter", &jittered, 300);
+  expect(fabsf(jittered.peak - wheel.peak) < 0.03f, "jitter changes overshoot by under 3 points");
+  expect(fabsf(jittered.settle_s - wheel.settle_s) < 0.2f, "jitter changes settling by under 0.2 s");
+  expect(fabsf(jittered.final - 300) < 1.0f, "no steady state error with jitter");
+
+  // heading, 90 degree turn where the output saturates for most of it
+  response_t heading = run_step(PLANT_HEADING, &heading_config, 90, 10, 0);
+  print_response("heading", &heading, 90);
+  pid_config_t no_tracking = heading_config;
+  no_tracking.kt = 0;
+  response_t windup = run_step(PLANT_HEADING, &no_tracking, 90, 10, 0);
+  print_response("heading without anti-windup", &windup, 90);
+  expect(heading.max_command == 90, "turn saturates the output");
+  expect(heading.peak < 0.05f, "overshoot under 5% with back-calculation");
+  expect(windup.peak > 2 * heading.peak, "back-calculation at least halves overshoot");
+  // measurements are whole degrees, so anything that rounds to 90 is there
+  expect(fabsf(heading.final - 90) <= 0.5f, "no steady state error");
+  expect(heading.settle_s < 3.0f, "settles within 3 s");
+
+  // derivative on measurement: a setpoint step changes the output by kp *
+  // step only
+  pid_config_t d_config = heading_config;
+  d_config.kd = PID_GAIN(50.0);
+  d_config.ki = 0;
+  d_config.min = -10000;
+  d_config.max = 10000;
+  pid_loop_t pid;
+  pid_init(&pid, &d_config);
+  pid_update(&pid, 0, 0, 0);
+  pid_update(&pid, 0, 0, 20000);
+  int32_t kick = pid_update(&pid, 90, 0, 40000);
+  printf("setpoint step of 90 with kp 3, kd 50: output %d\n", kick);
+  expect(kick == 270, "no derivative kick");
+
+  // a batch of loops matches the same loops updated one at a time
+  pid_loop_t batch[2];
+  pid_loop_t single[2];
+  const pid_config_t* configs[2] = {&wheel_config, &heading_config};
+  for (uint8_t i = 0; i < 2; i++) {
+    pid_init(&batch[i], configs[i]);
+    pid_init(&single[i], configs[i]);
+  }
+  bool same = true;
+  uint32_t now = 0;
+  for (uint32_t n = 0; n < 1000; n++) {
+    int32_t setpoints[2] = {300, 90};
+    int32_t measurements[2] = {noise(400), noise(120)};
+    now += CONTROL_PERIOD_US + noise(5000);
+    pid_update_batch(batch, 2, setpoints, measurements, now);
+    for (uint8_t i = 0; i < 2; i++) {
+      same &= pid_update(&single[i], setpoints[i], measurements[i], now) == batch[i].command;
+    }
+  }
+  expect(same, "batch update matches single updates");
+
+  printf("%u failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
+
+// Bench
+
+#define BENCH_UPDATES 10000000
+
+static volatile int32_t sink;
+
+static int bench(void) {
+  pid_loop_t pids[2];
+  pid_init(&pids[0], &wheel_config);
+  pid_init(&pids[1], &heading_config);
+  static int32_t measurements[1024];
+  for (int i = 0; i < 1024; i++) {
+    measurements[i] = noise(400);
+  }
+
+  struct timespec start;
+  struct timespec end;
+#ifdef HAVE_TSC
+  uint64_t cycles = __rdtsc();
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint32_t now = 0;
+  for (uint32_t i = 0; i < BENCH_UPDATES; i++) {
+    now += CONTROL_PERIOD_US;
+    sink += pid_update(&pids[i & 1], 300, measurements[i & 1023], now);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef HAVE_TSC
+  cycles = __rdtsc() - cycles;
+#endif
+  double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_UPDATES;
+  printf("pid_update: %.1f ns", ns);
+#ifdef HAVE_TSC
+  printf(", %.0f TSC cycles", (double)cycles / BENCH_UPDATES);
+#endif
+  printf(" per update\n");
+
+  int32_t setpoints[2] = {300, 90};
+  int32_t batch_meas[2];
+#ifdef HAVE_TSC
+  cycles = __rdtsc();
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < BENCH_UPDATES / 2; i++) {
+    now += CONTROL_PERIOD_US;
+    batch_meas[0] = measurements[i & 1023];
+    batch_meas[1] = measurements[(i + 1) & 1023];
+    pid_update_batch(pids, 2, setpoints, batch_meas, now);
+    sink += pids[0].command;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef HAVE_TSC
+  cycles = __rdtsc() - cycles;
+#endif
+  ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_UPDATES;
+  printf("pid_update_batch of 2: %.1f ns", ns);
+#ifdef HAVE_TSC
+  printf(", %.0f TSC cycles", (double)cycles / BENCH_UPDATES);
+#endif
+  printf(" per loop\n");
+  return 0;
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: pid_tool step\n"
+                  "       pid_tool bench\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return usage();
+  }
+  if (strcmp(argv[1], "step") == 0) {
+    return step();
+  }
+  if (strcmp(argv[1], "bench") == 0) {
+    return bench();
+  }
+  return usage();
+}
@@ -0,0 +1,117 @@
+// Fixed-point PID controller
+//
+// Gains are Q-format fixed-point with PID_Q fractional bits and time comes
+// from a microsecond clock, so the loop can be called at an uneven rate. The
+// derivative acts on the measurement rather than the error, so setpoint steps
+// don't kick the output, and is low-pass filtered. Integral windup is
+// limited by back-calculation: while the output saturates the integral is
+// driven back towards the value that just reaches the limit.
+
+#include "pid.h"
+
+// 2^32 / 10^6 rounded, for converting microseconds to Q16 seconds without a
+// division
+#define PID_US_TO_Q16 4295u
+
+// Largest measurement change per step used for the derivative
+#define PID_MAX_CHANGE 0x7fff
+
+static int32_t clamp(int64_t value, int32_t min, int32_t max) {
+  if (value < min) {
+    return min;
+  }
+  if (value > max) {
+    return max;
+  }
+  return (int32_t)value;
+}
+
+// Seconds in Q16 from the previous update to now
+static uint32_t dt_q16(const pid_loop_t* pid, uint32_t now) {
+  uint32_t dt_us = now - pid->prev_time;
+  if (dt_us > PID_MAX_DT_US) {
+    dt_us = PID_MAX_DT_US;
+  }
+  return (dt_us * PID_US_TO_Q16) >> 16;
+}
+
+static int32_t step(pid_loop_t* pid, int32_t setpoint, int32_t measurement, uint32_t now, uint32_t dt) {
+  const pid_config_t* c = &pid->config;
+  int32_t error = setpoint - measurement;
+
+  // derivative on measurement, in units/s
+  // the change is limited so the division stays 32 bit
+  if (pid->primed && dt > 0) {
+    int32_t change = clamp((int64_t)measurement - pid->prev_meas, -PID_MAX_CHANGE, PID_MAX_CHANGE);
+    int32_t rate = change * 65536 / (int32_t)dt;
+    pid->rate += (rate - pid->rate) >> c->d_filter_shift;
+  }
+
+  int64_t p = (int64_t)c->kp * error;
+  int64_t d = -(int64_t)c->kd * pid->rate;
+  int64_t out = p + pid->integral + d;
+
+  int32_t lo = c->min * (1 << PID_Q);
+  int32_t hi = c->max * (1 << PID_Q);
+  int32_t sat = clamp(out, lo, hi);
+
+  // integrate for the next step, bleeding off whatever the limits cut
+  if (pid->primed) {
+    int64_t i_rate = (int64_t)c->ki * error + (((int64_t)c->kt * (sat - out)) >> PID_Q);
+    int64_t integral = pid->integral + ((i_rate * dt) >> 16);
+    pid->integral = clamp(integral, lo, hi);
+  }
+
+  pid->prev_meas = measurement;
+  pid->prev_time = now;
+  pid->primed = true;
+
+  int32_t command = sat >> PID_Q;
+  if (command > 0) {
+    command = clamp((int64_t)command + c->deadband, c->min, c->max);
+  } else if (command < 0) {
+    command = clamp((int64_t)command - c->deadband, c->min, c->max);
+  }
+  pid->command = command;
+  return command;
+}
+
+void pid_init(pid_loop_t* pid, const pid_config_t* config) {
+  pid->config = *config;
+  pid_reset(pid);
+}
+
+void pid_reset(pid_loop_t* pid) {
+  pid->command = 0;
+  pid->integral = 0;
+  pid->rate = 0;
+  pid->prev_meas = 0;
+  pid->prev_time = 0;
+  pid->primed = false;
+}
+
+int32_t pid_update(pid_loop_t* pid, int32_t setpoint, int32_t measurement, uint32_t now) {
+  return step(pid, setpoint, measurement, now, pid->primed ? dt_q16(pid, now) : 0);
+}
+
+void pid_update_batch(pid_loop_t* pids, uint8_t n, const int32_t* setpoints, const int32_t* measurements, uint32_t now) {
+  uint32_t dt = 0;
+  uint32_t dt_from = 0;
+  bool have_dt = false;
+
+  for (uint8_t i = 0; i < n; i++) {
+    pid_loop_t* pid = &pids[i];
+    uint32_t prev = pid->prev_time;
+
+    if (!pid->primed) {
+      step(pid, setpoints[i], measurements[i], now, 0);
+      continue;
+    }
+    if (!have_dt || prev != dt_from) {
+      dt = dt_q16(pid, now);
+      dt_from = prev;
+      have_dt = true;
+    }
+    step(pid, setpoints[i], measurements[i], now, dt);
+  }
+}
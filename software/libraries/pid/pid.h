@@ -0,0 +1,72 @@
+// Fixed-point PID controller
+//
+// Gains are Q-format fixed-point with PID_Q fractional bits and time comes
+// from a microsecond clock, so the loop can be called at an uneven rate. The
+// derivative acts on the measurement rather than the error, so setpoint steps
+// don't kick the output, and is low-pass filtered. Integral windup is
+// limited by back-calculation: while the output saturates the integral is
+// driven back towards the value that just reaches the limit.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fractional bits of gains and internal values
+#define PID_Q 10
+
+// Convert a constant gain to fixed-point
+#define PID_GAIN(g) ((int32_t)((g) * (1 << PID_Q) + ((g) < 0 ? -0.5 : 0.5)))
+
+// Calls further apart than this are treated as this far apart (us)
+#define PID_MAX_DT_US 250000
+
+typedef struct {
+  int32_t kp; // output per unit of error
+  int32_t ki; // output per unit of error per second
+  int32_t kd; // output per unit/s of measurement rate
+  int32_t kt; // anti-windup tracking rate (1/s), 0 for none
+
+  // output limits, at most 2^(31 - PID_Q) in magnitude
+  int32_t min;
+  int32_t max;
+
+  // added to the magnitude of any nonzero output, to overcome motor deadband
+  int32_t deadband;
+
+  // derivative filter, each update moves the rate 1/2^shift of the way to
+  // the new value. 0 for no filtering
+  uint8_t d_filter_shift;
+} pid_config_t;
+
+typedef struct {
+  pid_config_t config;
+
+  int32_t command;     // last output
+
+  int32_t integral;    // Q output units
+  int32_t rate;        // filtered measurement rate, units/s
+  int32_t prev_meas;
+  uint32_t prev_time;
+  bool primed;         // set once there is a previous measurement
+} pid_loop_t;
+
+// Initialize a loop with the given configuration and reset it
+void pid_init(pid_loop_t* pid, const pid_config_t* config);
+
+// Clear the integral and history, e.g. when the loop is re-engaged
+void pid_reset(pid_loop_t* pid);
+
+// Run one step of the loop
+//
+// now - microseconds from any free running clock
+//
+// The first step after a reset has no dt, so it applies only the
+// proportional and integral terms.
+// Returns the new command, also stored in pid->command
+int32_t pid_update(pid_loop_t* pid, int32_t setpoint, int32_t measurement, uint32_t now);
+
+// Run one step of n loops sampled at the same time, e.g. left and right wheel
+//
+// Loops that were last updated together share the dt computation.
+void pid_update_batch(pid_loop_t* pids, uint8_t n, const int32_t* setpoints, const int32_t* measurements, uint32_t now);
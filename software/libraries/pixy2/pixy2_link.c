@@ -0,0 +1,139 @@
+// I2C and UART links for the Pixy2 driver
+//
+// SPI is in pixy2_spi.c. These let Pixy share the TWI manager with the other
+// I2C sensors, or sit on a serial port, leaving the SPI bus to the display and
+// SD card.
+
+#include "nrf_serial.h"
+#include "nrf_twi_mngr.h"
+
+#include "pixy2_spi.h"
+
+
+// --- I2C ---
+
+
+// Most writes a request of up to 255 bytes takes
+#define I2C_MAX_WRITES ((UINT8_MAX + PIXY_I2C_MAX_SEND - 1)/PIXY_I2C_MAX_SEND)
+
+// The transaction of a scheduled request, which the TWI manager reads until
+// it completes. The driver schedules one at a time.
+static nrf_twi_mngr_transfer_t scheduledTransfers[I2C_MAX_WRITES + 1];
+static nrf_twi_mngr_transaction_t scheduled;
+
+
+// Pixy takes at most PIXY_I2C_MAX_SEND bytes per write, so longer requests go
+// out as several writes in one transaction. Returns the number of writes.
+static uint8_t i2cWrites(const pixy_link_t *link, nrf_twi_mngr_transfer_t *transfers, uint8_t *buf, uint8_t len) {
+  uint8_t n = 0;
+  uint16_t i;
+  uint8_t packet;
+
+  for (i=0; i<len; i+=PIXY_I2C_MAX_SEND) {
+    packet = len-i < PIXY_I2C_MAX_SEND ? len-i : PIXY_I2C_MAX_SEND;
+    transfers[n++] = (nrf_twi_mngr_transfer_t)NRF_TWI_MNGR_WRITE(link->addr, buf+i, packet, 0);
+  }
+  return n;
+}
+
+
+static ret_code_t i2cSend(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  nrf_twi_mngr_transfer_t transfers[I2C_MAX_WRITES];
+  uint8_t n = i2cWrites(link, transfers, buf, len);
+
+  return nrf_twi_mngr_perform(link->bus, NULL, transfers, n, NULL);
+}
+
+
+static ret_code_t i2cRecv(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  nrf_twi_mngr_transfer_t const transfers[] = {
+    NRF_TWI_MNGR_READ(link->addr, buf, len, 0),
+  };
+  return nrf_twi_mngr_perform(link->bus, NULL, transfers, 1, NULL);
+}
+
+
+// Queue the writes of tx and a read into rx as one transaction behind
+// whatever else is on the bus. The TWI manager calls done when it finishes.
+static ret_code_t i2cSchedule(const pixy_link_t *link, uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen,
+    void (*done)(ret_code_t result, void *context), void *context) {
+  uint8_t n = i2cWrites(link, scheduledTransfers, tx, txLen);
+
+  scheduledTransfers[n++] = (nrf_twi_mngr_transfer_t)NRF_TWI_MNGR_READ(link->addr, rx, rxLen, 0);
+  scheduled.callback = done;
+  scheduled.p_user_data = context;
+  scheduled.p_transfers = scheduledTransfers;
+  scheduled.number_of_transfers = n;
+  scheduled.p_required_twi_cfg = NULL;
+  return nrf_twi_mngr_schedule(link->bus, &scheduled);
+}
+
+
+pixy_link_t pixy_link_i2c(const nrf_twi_mngr_t *mngr, uint8_t addr) {
+  pixy_link_t link = {
+    .send = i2cSend,
+    .recv = i2cRecv,
+    .transfer = NULL,
+    .schedule = i2cSchedule,
+    .bus = mngr,
+    .addr = addr,
+    .chunk = PIXY_I2C_MAX_SEND,
+  };
+  return link;
+}
+
+
+// --- UART ---
+
+
+static uint32_t uartTimeout(const pixy_link_t *link, uint8_t len) {
+  return PIXY_UART_TIMEOUT_MS + (len*link->byteTime + 999)/1000;
+}
+
+
+static ret_code_t uartSend(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  // drop anything left over from a response we gave up on
+  ret_code_t status = nrf_serial_rx_drain(link->bus);
+  if (status != NRF_SUCCESS)
+    return status;
+  return nrf_serial_write(link->bus, buf, len, NULL, uartTimeout(link, len));
+}
+
+
+// A read can come up short when Pixy pauses mid-response, so keep reading
+// the rest while bytes are still arriving, up to PIXY_RECV_ATTEMPTS reads
+static ret_code_t uartRecv(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  ret_code_t status;
+  size_t got = 0;
+  size_t read;
+  uint8_t attempt;
+
+  for (attempt=0; attempt<PIXY_RECV_ATTEMPTS; attempt++) {
+    read = 0;
+    status = nrf_serial_read(link->bus, buf+got, len-got, &read, uartTimeout(link, len-got));
+    got += read;
+    if (got == len)
+      return NRF_SUCCESS;
+    if (status != NRF_ERROR_TIMEOUT && status != NRF_SUCCESS)
+      return status;
+    if (read == 0)
+      break; // Pixy has stopped sending
+  }
+  return NRF_ERROR_TIMEOUT;
+}
+
+
+pixy_link_t pixy_link_uart(const nrf_serial_t *serial, uint32_t baud) {
+  pixy_link_t link = {
+    .send = uartSend,
+    .recv = uartRecv,
+    .transfer = NULL,
+    .bus = serial,
+    // 10 bits per byte with the start and stop bits
+    .byteTime = 10*1000000/baud,
+    // bytes only arrive once Pixy sends them, so don't ask for more than the
+    // sync word at a time
+    .chunk = 2,
+  };
+  return link;
+}
@@ -1,12 +1,9 @@
 #include <stdio.h> // for printf
 #include <string.h> // for nstrcpy
-#include <stdlib.h> // for free and malloc
 
 #include "nrf_delay.h"
 
 #include "pixy2_spi.h"
-//#include "Pixy2Line.h"
-//#include "Pixy2Video.h"
 
 
 // Zed's debug macros
@@ -42,20 +39,26 @@
 #define LOG_INFO(M, ...) printf(WHITE "[INFO]" COLOR_X " (%s:%s:%d) " M "\n", __FILENAME__, __func__, __LINE__, ##__VA_ARGS__) 
 
 
+static drv_pixy2_spi_t pixy_instance;
+
+
 int8_t pixy_init(drv_pixy2_spi_t **pref, nrf_drv_spi_t const * const spi) {
-  drv_pixy2_spi_t *p = malloc(sizeof(struct Pixy2));
+  pixy_link_t link = pixy_link_spi(spi);
+  return pixy_init_link(pref, &link);
+}
+
+
+int8_t pixy_init_link(drv_pixy2_spi_t **pref, const pixy_link_t *link) {
+  drv_pixy2_spi_t *p = &pixy_instance;
   *pref = p;
 
-  // allocate buffer space for send/receive
-  p->m_buf = (uint8_t*)malloc(PIXY_BUFFERSIZE);
+  memset(p, 0, sizeof(struct Pixy2));
   // shifted buffer is used for sending, so we have space to write header information
   p->m_bufPayload = p->m_buf + PIXY_SEND_HEADER_SIZE;
-  p->frameWidth = p->frameHeight = 0;
-  p->version = NULL;
 
-  p->spi = spi;
+  p->link = *link;
 
-  p->blocks = NULL;
+  p->blocks = p->m_snapshots[0].blocks;
   p->numBlocks = 0;
 
   uint32_t t0;
@@ -74,94 +77,86 @@ int8_t pixy_init(drv_pixy2_spi_t **pref, nrf_drv_spi_t const * const spi) {
 
 
 void pixy_close(drv_pixy2_spi_t *p) {
-  free(p->m_buf);
+  memset(&p->link, 0, sizeof(pixy_link_t));
 }
 
 
-int16_t getSync(drv_pixy2_spi_t *p) {
-  TRACE();
-  uint8_t i, j, c, cprev;
-  int16_t res;
+// Find the sync word at the start of a response in buf
+// Returns the offset of the sync word or -1 if there isn't one
+static int16_t findSync(drv_pixy2_spi_t *p, const uint8_t *buf, uint8_t len) {
+  uint8_t i;
   uint16_t start;
-  
-  // parse bytes until we find sync
-  for(i=j=0, cprev=0; true; i++) {
-    res = recv(p->spi, &c, 1);
-    if (res == NRF_SUCCESS) {
-      // since we're using little endian, previous byte is least significant byte
-      start = cprev;
-      // current byte is most significant byte
-      start |= c << 8;
-      cprev = c;
-      if (start==PIXY_CHECKSUM_SYNC) {
-        p->m_cs = true;
-        return PIXY_RESULT_OK;
-      }
-      if (start==PIXY_NO_CHECKSUM_SYNC) {
-        p->m_cs = false;
-        return PIXY_RESULT_OK;
-      }
+
+  for (i=1; i<len; i++) {
+    // since we're using little endian, previous byte is least significant byte
+    start = buf[i-1] | (buf[i] << 8);
+    if (start==PIXY_CHECKSUM_SYNC) {
+      p->m_cs = true;
+      return i-1;
     }
-    // If we've read some bytes and no sync, then wait and try again.
-    // And do that several more times before we give up.  
-    // Pixy guarantees to respond within 100us.
-    if (i>=4) {
-      if (j>=4) {
-        DEBUG("error: no response");
-        return PIXY_RESULT_TIMEOUT;
-      }
-      nrf_delay_ms(25); 
-      j++;
-      i = 0;
+    if (start==PIXY_NO_CHECKSUM_SYNC) {
+      p->m_cs = false;
+      return i-1;
     }
   }
+  return -1;
 }
 
 
-int16_t recvPacket(drv_pixy2_spi_t *p) {
-  TRACE();
-  uint16_t csCalc, csSerial;
-  int16_t res;
-  
-  // clear out any stale data
-  res = getSync(p);
-  if (res == PIXY_RESULT_ERROR)
-    return res;
-
-  if (p->m_cs) {
-    res = recv(p->spi, p->m_buf, 4);
-    if (res != NRF_SUCCESS)
-      return res;
+// Parse the packet whose sync word is at m_buf + sync, moving its payload to
+// the start of m_buf. Whatever of it lies past the first have bytes is read
+// from the link, or is an error if read is false.
+//
+// Bytes clocked in after the end of the packet may hold the start of the
+// next one. If extra isn't NULL their count is returned in it, and they are
+// left in m_buf just past the header and payload, at m_buf + *extraAt.
+static int16_t parsePacket(drv_pixy2_spi_t *p, uint16_t have, int16_t sync, bool read, uint16_t *extra, uint16_t *extraAt) {
+  uint8_t *buf = p->m_buf;
+  uint16_t hdrLen;
+  uint16_t csCalc, csSerial = 0;
+
+  // drop everything up to the header and make sure we have all of it
+  hdrLen = p->m_cs ? 4 : 2;
+  have -= sync + 2;
+  memmove(buf, buf + sync + 2, have);
+  if (have < hdrLen) {
+    if (!read || p->link.recv(&p->link, buf+have, hdrLen-have) != NRF_SUCCESS)
+      return PIXY_RESULT_ERROR;
+    have = hdrLen;
+  }
 
-    p->m_type = p->m_buf[0];
-    p->m_length = p->m_buf[1];
+  p->m_type = buf[0];
+  p->m_length = buf[1];
+  if (p->m_cs)
+    csSerial = buf[2] | (buf[3] << 8);
 
-    csSerial = *(uint16_t *)&p->m_buf[2];
+  // the payload is moved down over the header below, which leaves anything
+  // after it in place
+  if (extra) {
+    *extra = have > hdrLen + p->m_length ? have - hdrLen - p->m_length : 0;
+    *extraAt = hdrLen + p->m_length;
+  }
 
-    res = recv(p->spi, p->m_buf, p->m_length);
-    if (res != NRF_SUCCESS)
-      return res;
+  // move the payload we already have to the start of m_buf and read the rest
+  have -= hdrLen;
+  if (have > p->m_length)
+    have = p->m_length;
+  memmove(buf, buf + hdrLen, have);
+  if (have < p->m_length) {
+    if (!read || p->link.recv(&p->link, buf+have, p->m_length-have) != NRF_SUCCESS)
+      return PIXY_RESULT_ERROR;
+  }
 
+  if (p->m_cs) {
     csCalc = 0;
     for (uint8_t i=0; i<p->m_length; i++) {
-      csCalc += p->m_buf[i];
+      csCalc += buf[i];
     }
 
     if (csSerial!=csCalc) {
       DEBUG("error: checksum");
       return PIXY_RESULT_CHECKSUM_ERROR;
     }
-  } else {   
-    res = recv(p->spi, p->m_buf, 2);
-    if (res != NRF_SUCCESS)
-      return res;
-
-    p->m_type = p->m_buf[0];
-    p->m_length = p->m_buf[1];
-
-    res = recv(p->spi, p->m_buf, p->m_length);
-    if (res != NRF_SUCCESS)
-      return res;
   }
 #ifdef PIXY_DEBUG
   DEBUG("received type=%d length=%d cs=%d", p->m_type, p->m_length, csSerial);
@@ -170,15 +165,74 @@ int16_t recvPacket(drv_pixy2_spi_t *p) {
 }
 
 
-int16_t sendPacket(drv_pixy2_spi_t *p) {
-  TRACE();  
+// Receive a response packet into m_buf, starting with the first have bytes
+// already clocked into it
+//
+// Bytes are clocked out a chunk at a time and scanned for the sync word, so
+// the sync, header and a short payload usually arrive in a single transfer.
+// Only the part of the header or payload past the end of the chunk is read
+// separately.
+static int16_t recvPacketFrom(drv_pixy2_spi_t *p, uint16_t have, uint16_t *extra, uint16_t *extraAt) {
+  TRACE();
+  uint8_t *buf = p->m_buf;
+  int16_t sync = findSync(p, buf, have);
+  uint8_t attempt;
+  uint16_t backoff = PIXY_RECV_BACKOFF_US;
+  ret_code_t status;
+
+  for (attempt=0; sync < 0; attempt++) {
+    if (attempt >= PIXY_RECV_ATTEMPTS) {
+      DEBUG("error: no response");
+      return PIXY_RESULT_TIMEOUT;
+    }
+    // Pixy guarantees to respond within 100us, but give it longer before
+    // giving up
+    if (attempt > 0) {
+      nrf_delay_us(backoff);
+      if (backoff < PIXY_RECV_MAX_BACKOFF_US)
+        backoff *= 2;
+    }
+
+    // keep the last byte in case the sync word straddles two chunks
+    if (have > 0) {
+      buf[0] = buf[have-1];
+      have = 1;
+    }
+    // links that only receive what Pixy sends, like UART, time out while
+    // it has nothing to say, which is just another attempt
+    status = p->link.recv(&p->link, buf+have, p->link.chunk);
+    if (status == NRF_ERROR_TIMEOUT)
+      continue;
+    if (status != NRF_SUCCESS)
+      return PIXY_RESULT_ERROR;
+    have += p->link.chunk;
+    sync = findSync(p, buf, have);
+  }
+  return parsePacket(p, have, sync, true, extra, extraAt);
+}
+
+
+int16_t recvPacket(drv_pixy2_spi_t *p) {
+  return recvPacketFrom(p, 0, NULL, NULL);
+}
+
+
+// Write the header in front of the request payload and return the length of
+// the whole packet
+static uint8_t packPacket(drv_pixy2_spi_t *p) {
   // write header info at beginnig of buffer
   p->m_buf[0] = PIXY_NO_CHECKSUM_SYNC&0xff;
   p->m_buf[1] = PIXY_NO_CHECKSUM_SYNC>>8;
   p->m_buf[2] = p->m_type;
   p->m_buf[3] = p->m_length;
+  return p->m_length+PIXY_SEND_HEADER_SIZE;
+}
+
+
+int16_t sendPacket(drv_pixy2_spi_t *p) {
+  TRACE();  
   // send whole thing -- header and data in one call
-  send(p->spi, p->m_buf, p->m_length+PIXY_SEND_HEADER_SIZE);
+  p->link.send(&p->link, p->m_buf, packPacket(p));
   return PIXY_RESULT_OK;
 }
 
@@ -214,7 +268,8 @@ int8_t getVersion(drv_pixy2_spi_t *p) {
   if ((res=recvPacket(p)) != PIXY_RESULT_OK)
     return res; // some kind of bitstream error
   if (p->m_type==PIXY_TYPE_RESPONSE_VERSION) {
-    p->version = (version_t *)p->m_buf;
+    // copy out of m_buf so the next request doesn't overwrite it
+    memcpy(&p->version, p->m_buf, p->m_length < sizeof(version_t) ? p->m_length : sizeof(version_t));
     return p->m_length;
   } else if (p->m_type==PIXY_TYPE_RESPONSE_ERROR)
     return PIXY_RESULT_BUSY;
@@ -360,6 +415,34 @@ ret_code_t recv(nrf_drv_spi_t const * const p_instance, uint8_t *data, uint8_t l
 }
 
 
+static ret_code_t spiSend(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  send(link->bus, buf, len);
+  return NRF_SUCCESS;
+}
+
+
+static ret_code_t spiRecv(const pixy_link_t *link, uint8_t *buf, uint8_t len) {
+  return recv(link->bus, buf, len);
+}
+
+
+static ret_code_t spiTransfer(const pixy_link_t *link, uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen) {
+  return nrf_drv_spi_transfer(link->bus, tx, txLen, rx, rxLen);
+}
+
+
+pixy_link_t pixy_link_spi(nrf_drv_spi_t const *spi) {
+  pixy_link_t link = {
+    .send = spiSend,
+    .recv = spiRecv,
+    .transfer = spiTransfer,
+    .bus = spi,
+    .chunk = PIXY_RECV_CHUNK,
+  };
+  return link;
+}
+
+
 void print_version(version_t *v) {
     printf("hardware ver: 0x%x firmware ver: %d.%d.%d %s\n", v->hardware, v->firmwareMajor, v->firmwareMinor, v->firmwareBuild, v->firmwareType);
 }
@@ -386,6 +469,31 @@ void print_block(block_t *b) {
 }
 
 
+// Copy the blocks in m_buf into the back snapshot, then make it the front
+static int8_t publishBlocks(drv_pixy2_spi_t *p) {
+  uint8_t front = p->m_front;
+  block_snapshot_t *back = &p->m_snapshots[front ^ 1];
+  uint8_t numBlocks = p->m_length/sizeof(struct Block);
+
+  if (numBlocks > CCC_MAX_BLOCKS)
+    numBlocks = CCC_MAX_BLOCKS;
+  memcpy(back->blocks, p->m_buf, numBlocks*sizeof(struct Block));
+  back->numBlocks = numBlocks;
+  back->frame = p->m_snapshots[front].frame + 1;
+  back->time = p->m_pollTime;
+
+  p->m_front = front ^ 1;
+  p->blocks = back->blocks;
+  p->numBlocks = numBlocks;
+  return numBlocks;
+}
+
+
+const block_snapshot_t *pixy_blocks(drv_pixy2_spi_t *p) {
+  return &p->m_snapshots[p->m_front];
+}
+
+
 int8_t getBlocks(drv_pixy2_spi_t *p, bool wait, uint8_t sigmap, uint8_t maxBlocks) {
   TRACE();
 
@@ -400,9 +508,7 @@ int8_t getBlocks(drv_pixy2_spi_t *p, bool wait, uint8_t sigmap, uint8_t maxBlock
     sendPacket(p);
     if (recvPacket(p) == PIXY_RESULT_OK) {
       if (p->m_type==CCC_RESPONSE_BLOCKS) {
-        p->blocks = (block_t*)p->m_buf;
-        p->numBlocks = p->m_length/sizeof(struct Block);
-        return p->numBlocks;
+        return publishBlocks(p);
       }
     // deal with busy and program changing states from Pixy (we'll wait)
       else if (p->m_type == PIXY_TYPE_RESPONSE_ERROR) {
@@ -417,6 +523,478 @@ int8_t getBlocks(drv_pixy2_spi_t *p, bool wait, uint8_t sigmap, uint8_t maxBlock
   
     // If we're waiting for frame data, don't thrash Pixy with requests.
     // We can give up half a millisecond of latency (worst case)  
-    nrf_delay_ms(500);
+    nrf_delay_us(500);
   }
 }
+
+
+// --- Line ---
+
+
+void print_vector(vector_t *v) {
+    printf("vector: (%d %d) (%d %d) index: %d flags %d\n", v->m_x0, v->m_y0, v->m_x1, v->m_y1, v->m_index, v->m_flags);
+}
+
+
+void print_intersection(intersection_t *in) {
+    uint8_t i;
+    printf("intersection: (%d %d)\n", in->m_x, in->m_y);
+    for (i=0; i<in->m_n; i++)
+        printf("  %d: index: %d angle: %d\n", i, in->m_intLines[i].m_index, in->m_intLines[i].m_angle);
+}
+
+
+void print_barcode(barcode_t *b) {
+    printf("Barcode: (%d %d), val: %d flags: %d\n", b->m_x, b->m_y, b->m_code, b->m_flags);
+}
+
+
+static int8_t getFeatures(drv_pixy2_spi_t *p, bool wait, uint8_t type, uint8_t features) {
+  TRACE();
+  int8_t res;
+  uint8_t offset, fsize, ftype, *fdata;
+
+  p->vectors = NULL;
+  p->numVectors = 0;
+  p->intersections = NULL;
+  p->numIntersections = 0;
+  p->barcodes = NULL;
+  p->numBarcodes = 0;
+
+  while(1) {
+    // fill in request data
+    p->m_length = 2;
+    p->m_type = LINE_REQUEST_GET_FEATURES;
+    p->m_bufPayload[0] = type;
+    p->m_bufPayload[1] = features;
+
+    // send request
+    sendPacket(p);
+    if (recvPacket(p) == PIXY_RESULT_OK) {
+      if (p->m_type==LINE_RESPONSE_GET_FEATURES) {
+        // parse line response in place
+        for (offset=0, res=0; p->m_length>offset+1; offset+=fsize+2) {
+          ftype = p->m_buf[offset];
+          fsize = p->m_buf[offset+1];
+          fdata = &p->m_buf[offset+2];
+          if (offset+2+fsize > p->m_length)
+            break; // truncated feature
+          if (ftype==LINE_VECTOR) {
+            p->vectors = (vector_t *)fdata;
+            p->numVectors = fsize/sizeof(vector_t);
+            res |= LINE_VECTOR;
+          } else if (ftype==LINE_INTERSECTION) {
+            p->intersections = (intersection_t *)fdata;
+            p->numIntersections = fsize/sizeof(intersection_t);
+            res |= LINE_INTERSECTION;
+          } else if (ftype==LINE_BARCODE) {
+            p->barcodes = (barcode_t *)fdata;
+            p->numBarcodes = fsize/sizeof(barcode_t);
+            res |= LINE_BARCODE;
+          } else
+            break; // parse error
+        }
+        return res;
+      }
+      // if it's not a busy response, return the error
+      else if (p->m_type == PIXY_TYPE_RESPONSE_ERROR) {
+        if ((int8_t)p->m_buf[0] != PIXY_RESULT_BUSY)
+          return p->m_buf[0];
+        else if (!wait)
+          return PIXY_RESULT_BUSY; // new data not available yet
+      }
+    } else
+      return PIXY_RESULT_ERROR;  // some kind of bitstream error
+
+    // If we're waiting for frame data, don't thrash Pixy with requests.
+    // We can give up half a millisecond of latency (worst case)
+    nrf_delay_us(500);
+  }
+}
+
+
+int8_t getMainFeatures(drv_pixy2_spi_t *p, uint8_t features, bool wait) {
+  return getFeatures(p, wait, LINE_GET_MAIN_FEATURES, features);
+}
+
+
+int8_t getAllFeatures(drv_pixy2_spi_t *p, uint8_t features, bool wait) {
+  return getFeatures(p, wait, LINE_GET_ALL_FEATURES, features);
+}
+
+
+// Send a line request and return the result it gets back
+static int8_t lineRequest(drv_pixy2_spi_t *p, uint8_t type) {
+  uint32_t res;
+
+  p->m_type = type;
+  sendPacket(p);
+  if (recvPacket(p) == PIXY_RESULT_OK && p->m_type==PIXY_TYPE_RESPONSE_RESULT && p->m_length==4) {
+    res = *(uint32_t *)p->m_buf;
+    return (int8_t)res;
+  } else
+    return PIXY_RESULT_ERROR;  // some kind of bitstream error
+}
+
+
+int8_t setMode(drv_pixy2_spi_t *p, uint8_t mode) {
+  p->m_bufPayload[0] = mode;
+  p->m_length = 1;
+  return lineRequest(p, LINE_REQUEST_SET_MODE);
+}
+
+
+int8_t setNextTurn(drv_pixy2_spi_t *p, int16_t angle) {
+  memcpy(p->m_bufPayload, &angle, 2);
+  p->m_length = 2;
+  return lineRequest(p, LINE_REQUEST_SET_NEXT_TURN_ANGLE);
+}
+
+
+int8_t setDefaultTurn(drv_pixy2_spi_t *p, int16_t angle) {
+  memcpy(p->m_bufPayload, &angle, 2);
+  p->m_length = 2;
+  return lineRequest(p, LINE_REQUEST_SET_DEFAULT_TURN_ANGLE);
+}
+
+
+int8_t setVector(drv_pixy2_spi_t *p, uint8_t index) {
+  p->m_bufPayload[0] = index;
+  p->m_length = 1;
+  return lineRequest(p, LINE_REQUEST_SET_VECTOR);
+}
+
+
+int8_t reverseVector(drv_pixy2_spi_t *p) {
+  p->m_length = 0;
+  return lineRequest(p, LINE_REQUEST_REVERSE_VECTOR);
+}
+
+
+// --- Video ---
+
+
+int8_t getRGB(drv_pixy2_spi_t *p, uint16_t x, uint16_t y, rgb_t *rgb, bool saturate) {
+  TRACE();
+
+  while(1) {
+    memcpy(p->m_bufPayload + 0, &x, 2);
+    memcpy(p->m_bufPayload + 2, &y, 2);
+    p->m_bufPayload[4] = saturate;
+    p->m_length = 5;
+    p->m_type = VIDEO_REQUEST_GET_RGB;
+
+    sendPacket(p);
+    if (recvPacket(p) == PIXY_RESULT_OK) {
+      if (p->m_type==PIXY_TYPE_RESPONSE_RESULT && p->m_length==4) {
+        rgb->b = p->m_buf[0];
+        rgb->g = p->m_buf[1];
+        rgb->r = p->m_buf[2];
+        return PIXY_RESULT_OK;
+      }
+      // deal with program changing
+      else if (p->m_type==PIXY_TYPE_RESPONSE_ERROR && (int8_t)p->m_buf[0]==PIXY_RESULT_PROG_CHANGING) {
+        nrf_delay_us(500); // don't be a drag
+        continue;
+      }
+    }
+    return PIXY_RESULT_ERROR;
+  }
+}
+
+
+// Pixel i of a list, or of a cols x rows grid spread evenly over the frame
+// if pixels is NULL
+static pixel_t pixelAt(drv_pixy2_spi_t *p, uint16_t i, const pixel_t *pixels, uint8_t cols, uint8_t rows) {
+  pixel_t px;
+
+  if (pixels)
+    return pixels[i];
+  // centre of each grid cell
+  px.x = (2*(i%cols) + 1)*p->frameWidth/(2*cols);
+  px.y = (2*(i/cols) + 1)*p->frameHeight/(2*rows);
+  return px;
+}
+
+
+// Build a get RGB request for pixel i
+static void rgbRequest(drv_pixy2_spi_t *p, uint8_t *req, uint16_t i,
+    const pixel_t *pixels, uint8_t cols, uint8_t rows, bool saturate) {
+  pixel_t px = pixelAt(p, i, pixels, cols, rows);
+
+  req[0] = PIXY_NO_CHECKSUM_SYNC&0xff;
+  req[1] = PIXY_NO_CHECKSUM_SYNC>>8;
+  req[2] = VIDEO_REQUEST_GET_RGB;
+  req[3] = 5;
+  memcpy(req + 4, &px.x, 2);
+  memcpy(req + 6, &px.y, 2);
+  req[8] = saturate;
+}
+
+
+// Sample n pixels with the requests pipelined
+//
+// Each transfer clocks out the request for the next pixel while clocking in
+// the response to the previous one, so there is one transfer per pixel rather
+// than a request/response round trip.
+//
+// Pixy may answer a request before the transfer that sent it ends, so a
+// response can start anywhere in the chunk clocked in with the next request,
+// or in the tail of the one before. Whatever follows each response is kept
+// and searched for the next sync word along with the next chunk, instead of
+// expecting responses at a fixed offset.
+static int8_t sampleRGB(drv_pixy2_spi_t *p, uint16_t n, const pixel_t *pixels,
+    uint8_t cols, uint8_t rows, rgb_t *rgb, bool saturate) {
+  TRACE();
+  uint8_t req[PIXY_SEND_HEADER_SIZE + 5];
+  uint8_t reqLen;
+  // bytes clocked in after the last response, at most a chunk once trimmed
+  // to the next sync word
+  uint8_t carry[PIXY_RECV_CHUNK];
+  uint16_t carryLen = 0;
+  uint16_t extra, extraAt;
+  int16_t sync;
+  uint16_t i;
+  int16_t res;
+
+  if (n == 0)
+    return PIXY_RESULT_OK;
+
+  // half duplex links get one request at a time, as do links with chunks too
+  // big to carry over
+  if (!p->link.transfer || p->link.chunk > PIXY_RECV_CHUNK) {
+    for (i=0; i<n; i++) {
+      pixel_t px = pixelAt(p, i, pixels, cols, rows);
+      if ((res=getRGB(p, px.x, px.y, &rgb[i], saturate)) != PIXY_RESULT_OK)
+        return res;
+    }
+    return PIXY_RESULT_OK;
+  }
+
+  rgbRequest(p, req, 0, pixels, cols, rows, saturate);
+  p->link.send(&p->link, req, sizeof(req));
+
+  for (i=0; i<n; i++) {
+    reqLen = 0;
+    if (i+1 < n) {
+      rgbRequest(p, req, i+1, pixels, cols, rows, saturate);
+      reqLen = sizeof(req);
+    }
+    memcpy(p->m_buf, carry, carryLen);
+    if (p->link.transfer(&p->link, req, reqLen, p->m_buf + carryLen, p->link.chunk) != NRF_SUCCESS)
+      return PIXY_RESULT_ERROR;
+    res = recvPacketFrom(p, carryLen + p->link.chunk, &extra, &extraAt);
+    if (res != PIXY_RESULT_OK)
+      return res; // some kind of bitstream error
+
+    // keep what came after the response from its sync word on, or just the
+    // last byte in case it is the first half of one
+    carryLen = 0;
+    if (extra > 0) {
+      sync = findSync(p, p->m_buf + extraAt, extra);
+      if (sync < 0)
+        sync = extra - 1;
+      carryLen = extra - sync;
+      if (carryLen > sizeof(carry))
+        carryLen = sizeof(carry);
+      memcpy(carry, p->m_buf + extraAt + sync, carryLen);
+    }
+
+    if (p->m_type==PIXY_TYPE_RESPONSE_RESULT && p->m_length==4) {
+      rgb[i].b = p->m_buf[0];
+      rgb[i].g = p->m_buf[1];
+      rgb[i].r = p->m_buf[2];
+    } else {
+      res = p->m_type==PIXY_TYPE_RESPONSE_ERROR ? (int8_t)p->m_buf[0] : PIXY_RESULT_ERROR;
+      // the request already sent for the next pixel still gets a response,
+      // so drain it before giving up
+      if (reqLen) {
+        memcpy(p->m_buf, carry, carryLen);
+        recvPacketFrom(p, carryLen, NULL, NULL);
+      }
+      return res;
+    }
+  }
+  return PIXY_RESULT_OK;
+}
+
+
+int8_t getRGBs(drv_pixy2_spi_t *p, const pixel_t *pixels, uint16_t n, rgb_t *rgb, bool saturate) {
+  return sampleRGB(p, n, pixels, 0, 0, rgb, saturate);
+}
+
+
+int8_t getRGBGrid(drv_pixy2_spi_t *p, uint8_t cols, uint8_t rows, rgb_t *rgb, bool saturate) {
+  return sampleRGB(p, cols*rows, NULL, cols, rows, rgb, saturate);
+}
+
+
+// --- frame pacing ---
+
+
+int8_t pixy_frame_sync_init(drv_pixy2_spi_t *p) {
+  int8_t fps = getFPS(p);
+
+  if (fps <= 0) {
+    // unknown rate, poll every time
+    p->m_framePeriod = 0;
+    return fps < 0 ? fps : PIXY_RESULT_ERROR;
+  }
+  p->m_framePeriod = 1000000/fps;
+  return PIXY_RESULT_OK;
+}
+
+
+// Whether to ask Pixy for a new frame at time now
+static bool frameDue(drv_pixy2_spi_t *p, uint32_t now) {
+  // the next frame isn't due yet, so don't bother asking. A clock that
+  // hasn't moved since the last poll can't say when that is, e.g.
+  // app_timer_cnt_get() with no app timer running, so ask every time rather
+  // than never again
+  return !p->m_framePeriod || now == p->m_pollTime || (int32_t)(now - p->m_nextFrame) >= 0;
+}
+
+
+// Work out when the next frame is due from the result of a request made at
+// time now
+static void paceFrame(drv_pixy2_spi_t *p, uint32_t now, int8_t res) {
+  if (res == PIXY_RESULT_BUSY) {
+    // the frame is late, check again shortly
+    p->m_nextFrame = now + p->m_framePeriod/PIXY_FRAME_RETRY_DIV;
+  } else if (res >= 0) {
+    // this frame arrived since the last poll, so the next one is due a
+    // period from now
+    p->m_nextFrame = now + p->m_framePeriod;
+    p->m_frameTime = now;
+  }
+}
+
+
+// Run a non-blocking frame request if a new frame is due
+static int8_t pollFrame(drv_pixy2_spi_t *p, uint32_t now,
+    int8_t (*request)(drv_pixy2_spi_t *, bool, uint8_t, uint8_t), uint8_t arg0, uint8_t arg1) {
+  int8_t res;
+
+  if (!frameDue(p, now))
+    return PIXY_RESULT_BUSY;
+
+  p->m_pollTime = now;
+  res = request(p, false, arg0, arg1);
+  paceFrame(p, now, res);
+  return res;
+}
+
+
+static void blocksScheduled(ret_code_t result, void *context);
+
+
+// The rest of the header, then the rest of the payload, of a scheduled
+// response may lie past what has been read so far. Schedule reading them and
+// return true, or return false if the whole packet is in m_buf.
+static bool readRest(drv_pixy2_spi_t *p, int16_t sync) {
+  uint8_t have = p->m_pollLen;
+  uint16_t len = sync + 2 + (p->m_cs ? 4 : 2);
+
+  if (len <= have)
+    len += p->m_buf[sync+3];
+  if (len <= have || len > UINT8_MAX)
+    return false;
+  p->m_pollLen = len;
+  if (p->link.schedule(&p->link, NULL, 0, p->m_buf+have, len-have, blocksScheduled, p) != NRF_SUCCESS) {
+    p->m_pollLen = have;
+    return false;
+  }
+  return true;
+}
+
+
+// Parse the blocks response that starts at m_buf + sync and publish them
+static int8_t parseBlocks(drv_pixy2_spi_t *p, int16_t sync) {
+  int8_t res;
+
+  if (parsePacket(p, p->m_pollLen, sync, false, NULL, NULL) != PIXY_RESULT_OK)
+    return PIXY_RESULT_ERROR;
+  if (p->m_type == CCC_RESPONSE_BLOCKS)
+    return publishBlocks(p);
+  if (p->m_type != PIXY_TYPE_RESPONSE_ERROR)
+    return PIXY_RESULT_ERROR;
+  // a frame that isn't ready yet and a program still starting are the same
+  // to a poll
+  res = (int8_t)p->m_buf[0];
+  return res == PIXY_RESULT_PROG_CHANGING ? PIXY_RESULT_BUSY : res;
+}
+
+
+// Completes a scheduled blocks request, from the link's interrupt
+static void blocksScheduled(ret_code_t result, void *context) {
+  drv_pixy2_spi_t *p = context;
+  int16_t sync;
+  int8_t res = PIXY_RESULT_ERROR;
+
+  if (result == NRF_SUCCESS) {
+    sync = findSync(p, p->m_buf, p->m_pollLen);
+    if (sync < 0)
+      res = PIXY_RESULT_BUSY; // no answer yet, ask again shortly
+    else if (readRest(p, sync))
+      return; // back here once the rest arrives
+    else
+      res = parseBlocks(p, sync);
+  }
+  p->m_pollResult = res;
+  p->m_polled = true;
+  p->m_scheduled = false;
+}
+
+
+// Like pollFrame() with getBlocks(), but the request is queued on the link and
+// its result comes back on a later poll
+static int8_t pollBlocksScheduled(drv_pixy2_spi_t *p, uint32_t now, uint8_t sigmap, uint8_t maxBlocks) {
+  ret_code_t status;
+
+  if (p->m_scheduled)
+    return PIXY_RESULT_BUSY;
+  if (p->m_polled) {
+    p->m_polled = false;
+    paceFrame(p, p->m_pollTime, p->m_pollResult);
+    return p->m_pollResult;
+  }
+  if (!frameDue(p, now))
+    return PIXY_RESULT_BUSY;
+
+  // the whole response, with its 6 bytes of sync and header, has to fit in
+  // the 255 bytes of one read
+  if (maxBlocks > (UINT8_MAX - 6)/sizeof(struct Block))
+    maxBlocks = (UINT8_MAX - 6)/sizeof(struct Block);
+  p->m_bufPayload[0] = sigmap;
+  p->m_bufPayload[1] = maxBlocks;
+  p->m_length = 2;
+  p->m_type = CCC_REQUEST_BLOCKS;
+
+  p->m_pollTime = now;
+  p->m_pollLen = PIXY_POLL_RECV;
+  p->m_scheduled = true;
+  status = p->link.schedule(&p->link, p->m_buf, packPacket(p), p->m_buf, PIXY_POLL_RECV, blocksScheduled, p);
+  if (status != NRF_SUCCESS) {
+    p->m_scheduled = false;
+    // the link's queue is full, try again on the next poll
+    return status == NRF_ERROR_NO_MEM ? PIXY_RESULT_BUSY : PIXY_RESULT_ERROR;
+  }
+  return PIXY_RESULT_BUSY;
+}
+
+
+int8_t pixy_poll_blocks(drv_pixy2_spi_t *p, uint32_t now, uint8_t sigmap, uint8_t maxBlocks) {
+  if (p->link.schedule)
+    return pollBlocksScheduled(p, now, sigmap, maxBlocks);
+  return pollFrame(p, now, getBlocks, sigmap, maxBlocks);
+}
+
+
+int8_t pixy_poll_features(drv_pixy2_spi_t *p, uint32_t now, uint8_t type, uint8_t features) {
+  return pollFrame(p, now, getFeatures, type, features);
+}
+
+
+uint32_t pixy_frame_age(drv_pixy2_spi_t *p, uint32_t now) {
+  return now - p->m_frameTime;
+}
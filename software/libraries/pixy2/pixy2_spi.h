@@ -6,6 +6,8 @@
 #define _TPIXY2_H
 
 #include "nrf_drv_spi.h"
+#include "nrf_serial.h"
+#include "nrf_twi_mngr.h"
 #include <stdint.h> // for int types
 #include <stdbool.h>
 
@@ -19,6 +21,15 @@
 #define PIXY_SEND_HEADER_SIZE                4
 #define PIXY_MAX_PROGNAME                    33
 
+// Bytes clocked out at a time while waiting for a response, and how many
+// chunks to try before timing out. The wait between chunks starts at
+// PIXY_RECV_BACKOFF_US and doubles up to PIXY_RECV_MAX_BACKOFF_US, so a
+// silent Pixy times out in under 5 ms.
+#define PIXY_RECV_CHUNK                      32
+#define PIXY_RECV_ATTEMPTS                   8
+#define PIXY_RECV_BACKOFF_US                 100
+#define PIXY_RECV_MAX_BACKOFF_US             800
+
 #define PIXY_TYPE_REQUEST_CHANGE_PROG        0x02
 #define PIXY_TYPE_REQUEST_RESOLUTION         0x0c
 #define PIXY_TYPE_RESPONSE_RESOLUTION        0x0f
@@ -69,6 +80,50 @@ ret_code_t recv(nrf_drv_spi_t const * const spi, uint8_t *buf, uint8_t len);
 void send(nrf_drv_spi_t const * const spi, uint8_t *buf, uint8_t len);
 
 
+// --- link ---
+
+
+#define PIXY_I2C_DEFAULT_ADDR                0x54
+#define PIXY_I2C_MAX_SEND                    16 // don't send any more than 16 bytes at a time
+
+// Wait this long for a UART response on top of the time to clock in its bytes
+#define PIXY_UART_TIMEOUT_MS                 5
+
+// How the driver reaches Pixy. Each app picks one with pixy_link_spi(),
+// pixy_link_i2c() or pixy_link_uart() and passes it to pixy_init_link().
+typedef struct PixyLink {
+  ret_code_t (*send)(const struct PixyLink *link, uint8_t *buf, uint8_t len);
+  // receive exactly len bytes
+  ret_code_t (*recv)(const struct PixyLink *link, uint8_t *buf, uint8_t len);
+  // send tx while receiving into rx, NULL if the link isn't full duplex
+  ret_code_t (*transfer)(const struct PixyLink *link, uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen);
+  // queue sending tx and then receiving rxLen bytes into rx, and return
+  // straight away. done is called from an interrupt once both finish. NULL
+  // if the link can only block.
+  ret_code_t (*schedule)(const struct PixyLink *link, uint8_t *tx, uint8_t txLen, uint8_t *rx, uint8_t rxLen,
+      void (*done)(ret_code_t result, void *context), void *context);
+
+  const void *bus;  // nrf_drv_spi_t, nrf_twi_mngr_t or nrf_serial_t
+  uint8_t addr;     // I2C address
+  uint16_t byteTime; // UART microseconds per byte
+  uint8_t chunk;    // bytes to read at a time while looking for a response
+} pixy_link_t;
+
+// SPI with slave select. The instance must have no event handler.
+pixy_link_t pixy_link_spi(nrf_drv_spi_t const *spi);
+
+// I2C through a TWI manager shared with other devices. Transfers are queued
+// behind whatever the other drivers have scheduled. pixy_poll_blocks()
+// schedules its request and response without waiting for them.
+pixy_link_t pixy_link_i2c(const nrf_twi_mngr_t *mngr, uint8_t addr);
+
+// UART through a serial port initialized in DMA or IRQ mode at baud
+//
+// The nRF52832 has one UARTE, which the Kobuki uses, so this is for robots
+// that drive some other way or parts with a second UARTE.
+pixy_link_t pixy_link_uart(const nrf_serial_t *serial, uint32_t baud);
+
+
 // --- CCC ---
 
 
@@ -110,35 +165,149 @@ typedef struct Block {
 void print_block(block_t *b);
 
 
+// A stable copy of the blocks from one frame. getBlocks() fills one snapshot
+// while the other stays readable, then swaps them.
+typedef struct BlockSnapshot {
+  block_t blocks[CCC_MAX_BLOCKS];
+  int8_t numBlocks;
+  uint32_t frame; // incremented for every snapshot published
+  uint32_t time;  // time of the pixy_poll_blocks() call that fetched it
+} block_snapshot_t;
+
+
+// --- Line ---
+
+
+#define LINE_REQUEST_GET_FEATURES                0x30
+#define LINE_RESPONSE_GET_FEATURES               0x31
+#define LINE_REQUEST_SET_MODE                    0x36
+#define LINE_REQUEST_SET_VECTOR                  0x38
+#define LINE_REQUEST_SET_NEXT_TURN_ANGLE         0x3a
+#define LINE_REQUEST_SET_DEFAULT_TURN_ANGLE      0x3c
+#define LINE_REQUEST_REVERSE_VECTOR              0x3e
+
+#define LINE_GET_MAIN_FEATURES                   0x00
+#define LINE_GET_ALL_FEATURES                    0x01
+
+#define LINE_MODE_TURN_DELAYED                   0x01
+#define LINE_MODE_MANUAL_SELECT_VECTOR           0x02
+#define LINE_MODE_WHITE_LINE                     0x80
+
+// features
+#define LINE_VECTOR                              0x01
+#define LINE_INTERSECTION                        0x02
+#define LINE_BARCODE                             0x04
+#define LINE_ALL_FEATURES                        (LINE_VECTOR | LINE_INTERSECTION | LINE_BARCODE)
+
+#define LINE_FLAG_INVALID                        0x02
+#define LINE_FLAG_INTERSECTION_PRESENT           0x04
+
+#define LINE_MAX_INTERSECTION_LINES              6
+
+
+typedef struct Vector {
+  uint8_t m_x0;
+  uint8_t m_y0;
+  uint8_t m_x1;
+  uint8_t m_y1;
+  uint8_t m_index;
+  uint8_t m_flags;
+} vector_t;
+
+typedef struct IntersectionLine {
+  uint8_t m_index;
+  uint8_t m_reserved;
+  int16_t m_angle;
+} intersection_line_t;
+
+typedef struct Intersection {
+  uint8_t m_x;
+  uint8_t m_y;
+
+  uint8_t m_n;
+  uint8_t m_reserved;
+  intersection_line_t m_intLines[LINE_MAX_INTERSECTION_LINES];
+} intersection_t;
+
+typedef struct Barcode {
+  uint8_t m_x;
+  uint8_t m_y;
+  uint8_t m_flags;
+  uint8_t m_code;
+} barcode_t;
+
+void print_vector(vector_t *v);
+void print_intersection(intersection_t *i);
+void print_barcode(barcode_t *b);
+
+
+// --- Video ---
+
+
+#define VIDEO_REQUEST_GET_RGB                    0x70
+
+typedef struct Pixel {
+  uint16_t x;
+  uint16_t y;
+} pixel_t;
+
+typedef struct RGB {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} rgb_t;
+
+
 // --- interface ---
 
 
+// The driver holds no heap memory: pixy_init() hands out a single statically
+// allocated instance.
 typedef struct Pixy2 {
-  version_t *version;
+  version_t version;
   uint16_t frameWidth;
   uint16_t frameHeight;
 
-  uint8_t *m_buf;
+  uint8_t m_buf[PIXY_BUFFERSIZE];
   uint8_t *m_bufPayload;
   uint8_t m_type;
   uint8_t m_length;
   bool m_cs;
 
   // Color connected components, color codes
+  // blocks and numBlocks always refer to the latest published snapshot
+  block_snapshot_t m_snapshots[2];
+  volatile uint8_t m_front;
   block_t *blocks;
   int8_t numBlocks;
 
-  // Line following
-  //Pixy2Line line;
+  // Frame pacing, in microseconds
+  uint32_t m_framePeriod;
+  uint32_t m_nextFrame;
+  uint32_t m_pollTime;
+  uint32_t m_frameTime;
 
-  // Video
-  //Pixy2Video video;
+  // A blocks request scheduled on the link, parsed when it completes
+  volatile bool m_scheduled;
+  volatile bool m_polled;
+  volatile int8_t m_pollResult;
+  uint8_t m_pollLen;
 
-  nrf_drv_spi_t const * spi;
+  // Line following
+  // These point into m_buf and are only valid until the next request
+  uint8_t numVectors;
+  vector_t *vectors;
+  uint8_t numIntersections;
+  intersection_t *intersections;
+  uint8_t numBarcodes;
+  barcode_t *barcodes;
+
+  pixy_link_t link;
 } drv_pixy2_spi_t;
 
 
 int8_t pixy_init(drv_pixy2_spi_t** p, nrf_drv_spi_t const * const spi);
+int8_t pixy_init_link(drv_pixy2_spi_t** p, const pixy_link_t *link);
 void pixy_close(drv_pixy2_spi_t* p);
 
 int8_t getVersion(drv_pixy2_spi_t* p);
@@ -152,11 +321,81 @@ int8_t getFPS(drv_pixy2_spi_t* p);
 
 int8_t getBlocks(drv_pixy2_spi_t *p, bool wait, uint8_t sigmap, uint8_t maxBlocks);
 
+// Return the latest published block snapshot. It stays valid until the
+// second getBlocks() call after this one completes.
+const block_snapshot_t *pixy_blocks(drv_pixy2_spi_t *p);
+
+// Line tracking. getMainFeatures() and getAllFeatures() return a bitmap of
+// the LINE_* feature types received, parsed in place into vectors,
+// intersections and barcodes.
+int8_t getMainFeatures(drv_pixy2_spi_t *p, uint8_t features, bool wait);
+int8_t getAllFeatures(drv_pixy2_spi_t *p, uint8_t features, bool wait);
+int8_t setMode(drv_pixy2_spi_t *p, uint8_t mode);
+int8_t setNextTurn(drv_pixy2_spi_t *p, int16_t angle);
+int8_t setDefaultTurn(drv_pixy2_spi_t *p, int16_t angle);
+int8_t setVector(drv_pixy2_spi_t *p, uint8_t index);
+int8_t reverseVector(drv_pixy2_spi_t *p);
+
+// Video. Sample the color of a 5x5 pixel neighborhood, optionally saturated.
+// Return PIXY_RESULT_OK or an error. Needs the video program.
+int8_t getRGB(drv_pixy2_spi_t *p, uint16_t x, uint16_t y, rgb_t *rgb, bool saturate);
+
+// Sample a list of n pixels into rgb[0..n-1]
+//
+// Requests are pipelined, one SPI transfer per pixel, on links that are full
+// duplex, and sent one at a time on the others. Stops at the first
+// pixel that fails and returns its error, e.g. PIXY_RESULT_PROG_CHANGING.
+int8_t getRGBs(drv_pixy2_spi_t *p, const pixel_t *pixels, uint16_t n, rgb_t *rgb, bool saturate);
+
+// Sample the centres of a cols x rows grid over the frame into rgb, row by row
+int8_t getRGBGrid(drv_pixy2_spi_t *p, uint8_t cols, uint8_t rows, rgb_t *rgb, bool saturate);
+
+// --- frame pacing ---
+
+
+// After a poll that finds no new frame, poll again after this fraction of the
+// frame period
+#define PIXY_FRAME_RETRY_DIV                 8
+
+// Bytes read straight after a scheduled blocks request, enough for a
+// response with one block. The rest of a longer one is read after them.
+#define PIXY_POLL_RECV                       (6 + sizeof(struct Block))
+
+// Learn the camera frame period with getFPS() so that the pixy_poll_*()
+// functions only talk to Pixy when a new frame is due. Call once after
+// changeProg().
+int8_t pixy_frame_sync_init(drv_pixy2_spi_t *p);
+
+// Fetch the blocks of a new frame if one is due at time now
+//
+// now - microseconds from any free running clock, such as control_loop_now()
+//  or rtc_time_us(). app_timer_cnt_get() only counts while an app timer is
+//  running, and kobukiInit() doesn't start one
+//
+// Never waits. Returns the number of blocks in the new snapshot, or
+// PIXY_RESULT_BUSY if no new frame is available yet.
+//
+// On links that can schedule transfers, such as I2C, the request and
+// response are queued and parsed when they complete, which publishes the
+// snapshot. The next poll returns its result. Other requests must not be
+// made while one is queued, since it uses m_buf.
+int8_t pixy_poll_blocks(drv_pixy2_spi_t *p, uint32_t now, uint8_t sigmap, uint8_t maxBlocks);
+
+// Fetch the line features of a new frame if one is due at time now
+//
+// type - LINE_GET_MAIN_FEATURES or LINE_GET_ALL_FEATURES
+//
+// Never waits. Returns the bitmap of feature types received, or
+// PIXY_RESULT_BUSY if no new frame is available yet.
+int8_t pixy_poll_features(drv_pixy2_spi_t *p, uint32_t now, uint8_t type, uint8_t features);
+
+// Microseconds between the poll that fetched the latest frame and now
+uint32_t pixy_frame_age(drv_pixy2_spi_t *p, uint32_t now);
+
 
 // --- serial helper ---
 
 
-int16_t getSync(drv_pixy2_spi_t* p);
 int16_t recvPacket(drv_pixy2_spi_t* p);
 int16_t sendPacket(drv_pixy2_spi_t* p);
 
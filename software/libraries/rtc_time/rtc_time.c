@@ -0,0 +1,142 @@
+// RTC timebase
+//
+// Low power 64 bit timestamps and a single alarm from RTC2, which runs from
+// the 32.768 kHz LFCLK. The 24 bit counter is extended with a count of
+// overflows kept by the overflow interrupt.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_drv_clock.h"
+#include "sdk_common.h"
+
+#include "rtc_time.h"
+
+#if NRF_MODULE_ENABLED(RTC_TIME)
+
+#define COUNTER_BITS 24
+#define COUNTER_MASK ((1UL << COUNTER_BITS) - 1)
+
+// The compare event doesn't fire for a CC value less than two ticks ahead of
+// the counter
+#define MIN_ALARM_TICKS 2
+
+static bool initialized;
+static volatile uint32_t overflows;
+
+static uint64_t alarm_tick;
+static rtc_time_alarm_handler_t alarm_handler;
+
+ret_code_t rtc_time_init(void) {
+  if (initialized) {
+    return NRF_SUCCESS;
+  }
+
+  ret_code_t err_code = nrf_drv_clock_init();
+  if (err_code != NRF_SUCCESS && err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED) {
+    return err_code;
+  }
+  nrf_drv_clock_lfclk_request(NULL);
+
+  overflows = 0;
+  alarm_handler = NULL;
+
+  NRF_RTC2->TASKS_STOP = 1;
+  NRF_RTC2->TASKS_CLEAR = 1;
+  NRF_RTC2->PRESCALER = 0;
+  NRF_RTC2->EVENTS_OVRFLW = 0;
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  NRF_RTC2->INTENSET = RTC_INTENSET_OVRFLW_Msk | RTC_INTENSET_COMPARE0_Msk;
+
+  NVIC_SetPriority(RTC2_IRQn, APP_IRQ_PRIORITY_HIGH);
+  NVIC_ClearPendingIRQ(RTC2_IRQn);
+  NVIC_EnableIRQ(RTC2_IRQn);
+
+  NRF_RTC2->TASKS_START = 1;
+  initialized = true;
+  return NRF_SUCCESS;
+}
+
+uint64_t rtc_time_ticks(void) {
+  uint64_t ticks;
+
+  CRITICAL_REGION_ENTER();
+  uint32_t counter = NRF_RTC2->COUNTER;
+  uint32_t high = overflows;
+  // an overflow the interrupt hasn't counted yet, read again in case the
+  // first read was from before it
+  if (NRF_RTC2->EVENTS_OVRFLW) {
+    counter = NRF_RTC2->COUNTER;
+    high++;
+  }
+  ticks = ((uint64_t)high << COUNTER_BITS) | counter;
+  CRITICAL_REGION_EXIT();
+
+  return ticks;
+}
+
+uint64_t rtc_time_ticks_to_us(uint64_t ticks) {
+  // 10^6 / 32768 = 15625 / 512
+  return (ticks * 15625) >> 9;
+}
+
+uint64_t rtc_time_us_to_ticks(uint64_t us) {
+  return ((us << 9) + 15624) / 15625;
+}
+
+uint64_t rtc_time_us(void) {
+  return rtc_time_ticks_to_us(rtc_time_ticks());
+}
+
+// Program the compare register for the alarm, or pend the interrupt if it is
+// too close to be caught by the compare event
+static void alarm_schedule(void) {
+  NRF_RTC2->CC[0] = alarm_tick & COUNTER_MASK;
+  if (alarm_tick < rtc_time_ticks() + MIN_ALARM_TICKS) {
+    NVIC_SetPendingIRQ(RTC2_IRQn);
+  }
+}
+
+void rtc_time_set_alarm(uint64_t tick, rtc_time_alarm_handler_t handler) {
+  CRITICAL_REGION_ENTER();
+  alarm_tick = tick;
+  alarm_handler = handler;
+  alarm_schedule();
+  CRITICAL_REGION_EXIT();
+}
+
+void rtc_time_cancel_alarm(void) {
+  CRITICAL_REGION_ENTER();
+  alarm_handler = NULL;
+  CRITICAL_REGION_EXIT();
+}
+
+void RTC2_IRQHandler(void) {
+  if (NRF_RTC2->EVENTS_OVRFLW) {
+    NRF_RTC2->EVENTS_OVRFLW = 0;
+    overflows++;
+  }
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+
+  // The compare register only holds the low 24 bits, so it also matches
+  // once per overflow before an alarm that is further away
+  rtc_time_alarm_handler_t handler = NULL;
+  CRITICAL_REGION_ENTER();
+  if (alarm_handler != NULL) {
+    if (rtc_time_ticks() >= alarm_tick) {
+      handler = alarm_handler;
+      alarm_handler = NULL;
+    } else {
+      alarm_schedule();
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  if (handler != NULL) {
+    handler();
+  }
+}
+
+#endif // NRF_MODULE_ENABLED(RTC_TIME)
@@ -0,0 +1,48 @@
+// RTC timebase
+//
+// Low power 64 bit timestamps and a single alarm from RTC2, which runs from
+// the 32.768 kHz LFCLK. Unlike a TIMER, the RTC doesn't keep the high
+// frequency clock running, and it only interrupts on an alarm or once every
+// 512 seconds when its 24 bit counter overflows.
+//
+// Compiled in when RTC_TIME_ENABLED is set in the board's app_config.h, and
+// defines RTC2_IRQHandler. Several libraries call it, so the board leaves it
+// on.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "app_error.h"
+
+#define RTC_TIME_TICKS_PER_SECOND 32768
+
+// Called from the RTC interrupt when the alarm time is reached
+typedef void (*rtc_time_alarm_handler_t)(void);
+
+// Request the LFCLK and start RTC2
+//
+// Safe to call more than once, so every driver that needs timestamps can
+// call it from its own init
+// Returns success or an error code
+ret_code_t rtc_time_init(void);
+
+// Ticks since rtc_time_init(), 30.5 us each
+//
+// Safe to call from interrupt handlers and the main loop
+uint64_t rtc_time_ticks(void);
+
+// Microseconds since rtc_time_init(), with the 30.5 us resolution of a tick
+uint64_t rtc_time_us(void);
+
+// Convert between ticks and microseconds, rounding microseconds up to the
+// next tick
+uint64_t rtc_time_ticks_to_us(uint64_t ticks);
+uint64_t rtc_time_us_to_ticks(uint64_t us);
+
+// Call handler once rtc_time_ticks() reaches tick, replacing any alarm that
+// was already set. An alarm in the past goes off right away.
+void rtc_time_set_alarm(uint64_t tick, rtc_time_alarm_handler_t handler);
+
+// Cancel the alarm, if any
+void rtc_time_cancel_alarm(void);
@@ -0,0 +1,15 @@
+// Host stand-in for the SDK's app_error.h
+//
+// Just the error codes the logger returns.
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_INTERNAL 3
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_STATE 8
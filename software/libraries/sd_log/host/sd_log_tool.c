@@ -0,0 +1,382 @@
+// Host tool for binary block logs
+//
+// Builds on Linux from the same logger source as the robot, with a file
+// standing in for the SD card, so logs copied off a card are read exactly
+// as the robot wrote them.
+//
+// usage: sd_log_tool bench image [rate_hz [seconds [stall_ms]]]
+//        sd_log_tool bench-varying image [rate_hz [seconds [stall_ms]]]
+//        sd_log_tool verify image
+//        sd_log_tool dump image
+//        sd_log_tool extract image stream
+//
+// bench logs synthetic IMU records into an image file at rate_hz, as if
+// from an interrupt, while the main loop writes blocks to a card that takes
+// WRITE_US per block and stalls for stall_ms every STALL_EVERY blocks, as
+// SD cards do while they erase. Records keep arriving during writes, so the
+// drops it reports are what the robot would see. It then reads the image
+// back and checks every record against what was logged. The image is
+// first filled with an older log, as a reused card would be, so reading
+// back also checks that none of its blocks are taken for the new log's.
+// bench-varying does the same with records of varying length. verify
+// checks any log's structure, dump prints its records in hex, and extract
+// writes them back to back, which for records from telemetry_codec.h gives
+// a stream telemetry_tool decodes.
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sd_log.h"
+
+// Card model, roughly a class 4 card on a 4 MHz SPI bus
+#define WRITE_US 1500
+#define STALL_EVERY 64
+#define DEFAULT_STALL_MS 100
+
+typedef struct {
+  uint32_t index;
+  uint32_t time_us;
+  int16_t accel[3];
+  int16_t gyro[3];
+} imu_record_t;
+
+#define BENCH_NAME "imu bench"
+#define BENCH_LOG_ID 0x5EED0002
+#define OLD_LOG_ID 0x5EED0001
+
+// File backend
+
+static int image_fd = -1;
+static uint64_t now_us;   // simulated time
+static uint32_t stall_us;
+static uint32_t writes;
+
+// Called while the main loop is busy, as the record interrupt would be
+static void run_interrupts(uint64_t until_us);
+
+static ret_code_t file_open(void* context, uint32_t blocks) {
+  // allocate the whole image up front, as the FatFs backend does, keeping
+  // whatever the image held before as a card would
+  if (posix_fallocate(image_fd, 0, (off_t)blocks * SD_LOG_BLOCK_SIZE) != 0) {
+    return NRF_ERROR_NO_MEM;
+  }
+  return NRF_SUCCESS;
+}
+
+static ret_code_t file_write(void* context, uint32_t block, const uint8_t* data) {
+  if (pwrite(image_fd, data, SD_LOG_BLOCK_SIZE, (off_t)block * SD_LOG_BLOCK_SIZE) != SD_LOG_BLOCK_SIZE) {
+    return NRF_ERROR_INTERNAL;
+  }
+  writes++;
+  uint64_t busy_us = WRITE_US + (writes % STALL_EVERY == 0 ? stall_us : 0);
+  run_interrupts(now_us + busy_us);
+  return NRF_SUCCESS;
+}
+
+static ret_code_t file_sync(void* context) {
+  return fsync(image_fd) == 0 ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
+
+static const sd_log_backend_t file_backend = {
+  .open = file_open,
+  .write = file_write,
+  .sync = file_sync,
+  .context = NULL,
+};
+
+// Reading logs
+
+typedef void (*record_handler_t)(const uint8_t* record, uint16_t size, uint32_t dropped_before);
+
+typedef struct {
+  sd_log_info_t info;
+  uint32_t blocks;
+  uint32_t records;
+  uint32_t dropped;
+} log_summary_t;
+
+// Find the count records in a block, each after its length byte if
+// record_size is 0, returning false if they run past the end of the block
+static bool find_records(const uint8_t* block, uint16_t count, uint16_t record_size,
+                         const uint8_t** records, uint16_t* sizes) {
+  uint16_t offset = SD_LOG_HEADER_SIZE;
+  for (uint16_t i = 0; i < count; i++) {
+    uint16_t size = record_size;
+    if (size == 0) {
+      if (offset >= SD_LOG_BLOCK_SIZE) {
+        return false;
+      }
+      size = block[offset++];
+    }
+    if (offset + size > SD_LOG_BLOCK_SIZE) {
+      return false;
+    }
+    records[i] = block + offset;
+    sizes[i] = size;
+    offset += size;
+  }
+  return true;
+}
+
+// Walk the blocks of a log until one isn't the next in sequence or is from
+// another log, which is where the log ends, since the preallocated space
+// after it holds whatever the card had there before
+static bool read_log(const char* path, record_handler_t handler, log_summary_t* summary) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+
+  memset(summary, 0, sizeof(*summary));
+  uint8_t block[SD_LOG_BLOCK_SIZE];
+  if (fread(block, 1, sizeof(block), file) != sizeof(block) || !sd_log_parse_info(block, &summary->info)) {
+    fprintf(stderr, "%s: not a log\n", path);
+    fclose(file);
+    return false;
+  }
+
+  while (fread(block, 1, sizeof(block), file) == sizeof(block)) {
+    uint16_t count;
+    uint32_t sequence;
+    uint32_t dropped;
+    const uint8_t* records[SD_LOG_MAX_RECORD_SIZE];
+    uint16_t sizes[SD_LOG_MAX_RECORD_SIZE];
+    if (!sd_log_parse_block(block, summary->info.log_id, &count, &sequence, &dropped) ||
+        sequence != summary->blocks + 1 ||
+        !find_records(block, count, summary->info.record_size, records, sizes)) {
+      break;
+    }
+    summary->blocks++;
+    summary->dropped += dropped;
+    for (uint16_t i = 0; i < count; i++) {
+      if (handler != NULL) {
+        handler(records[i], sizes[i], i == 0 ? dropped : 0);
+      }
+      summary->records++;
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+static void print_summary(const char* path, const log_summary_t* summary) {
+  printf("%s: \"%s\", id %08x, ", path, summary->info.name, summary->info.log_id);
+  if (summary->info.record_size == 0) {
+    printf("records of varying length");
+  } else {
+    printf("%u byte records, %u per block", summary->info.record_size, summary->info.records_per_block);
+  }
+  printf(", %u of %u blocks used\n", summary->blocks + 1, summary->info.blocks);
+  printf("%u records, %u dropped\n", summary->records, summary->dropped);
+}
+
+// Bench
+
+static bool varying; // log records of varying length
+static uint32_t rate_hz;
+static uint32_t next_index;
+static uint64_t next_record_us;
+static bool recording; // the record interrupt is running
+
+static imu_record_t make_record(uint32_t index, uint32_t time_us) {
+  imu_record_t record = {
+    .index = index,
+    .time_us = time_us,
+    .accel = {(int16_t)(index * 3), (int16_t)(index * 5), 1000},
+    .gyro = {(int16_t)index, (int16_t)-index, (int16_t)(index >> 4)},
+  };
+  return record;
+}
+
+// Records of varying length keep the index and time and some of the rest
+static uint16_t record_size(uint32_t index) {
+  return varying ? 8 + index % (sizeof(imu_record_t) - 7) : sizeof(imu_record_t);
+}
+
+static bool log_record(const imu_record_t* record) {
+  if (varying) {
+    return sd_log_record_varying(record, record_size(record->index));
+  }
+  return sd_log_record(record);
+}
+
+static void run_interrupts(uint64_t until_us) {
+  while (recording && next_record_us <= until_us) {
+    imu_record_t record = make_record(next_index, (uint32_t)next_record_us);
+    log_record(&record);
+    next_index++;
+    next_record_us = (uint64_t)next_index * 1000000 / rate_hz;
+  }
+  now_us = until_us;
+}
+
+static uint32_t expected_index;
+static uint32_t bad_records;
+
+static void check_record(const uint8_t* data, uint16_t size, uint32_t dropped_before) {
+  imu_record_t record = {0};
+  memcpy(&record, data, size < sizeof(record) ? size : sizeof(record));
+  expected_index += dropped_before;
+  imu_record_t expected = make_record(expected_index, record.time_us);
+  if (size != record_size(expected_index) || memcmp(&record, &expected, size) != 0) {
+    bad_records++;
+  }
+  expected_index = record.index + 1;
+}
+
+// Fill the image with a log using all of it, as a longer earlier run would
+static bool write_old_log(const sd_log_config_t* config) {
+  sd_log_config_t old = *config;
+  old.log_id = OLD_LOG_ID;
+  if (sd_log_init(&old) != NRF_SUCCESS) {
+    return false;
+  }
+  for (uint32_t index = 0; !sd_log_stats()->full; index++) {
+    imu_record_t record = make_record(index, index);
+    log_record(&record);
+    sd_log_process();
+  }
+  return sd_log_flush() == NRF_SUCCESS;
+}
+
+static int bench(const char* path, uint32_t rate, uint32_t seconds, uint32_t stall_ms) {
+  image_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (image_fd < 0) {
+    perror(path);
+    return 1;
+  }
+  rate_hz = rate;
+  stall_us = stall_ms * 1000;
+
+  // room for every record at its longest, with its length byte if any
+  uint32_t records = rate * seconds;
+  uint32_t per_block = SD_LOG_MAX_RECORD_SIZE / (sizeof(imu_record_t) + varying);
+  sd_log_config_t config = {
+    .record_size = varying ? 0 : sizeof(imu_record_t),
+    .blocks = 1 + (records + per_block - 1) / per_block + 16,
+    .backend = &file_backend,
+    .name = BENCH_NAME,
+    .log_id = BENCH_LOG_ID,
+  };
+  if (!write_old_log(&config)) {
+    fprintf(stderr, "writing the old log failed\n");
+    return 1;
+  }
+  ret_code_t err_code = sd_log_init(&config);
+  if (err_code != NRF_SUCCESS) {
+    fprintf(stderr, "sd_log_init failed: %u\n", err_code);
+    return 1;
+  }
+  writes = 0;
+  recording = true;
+
+  // the main loop: sleep until the next record, write what's full
+  uint64_t end_us = (uint64_t)seconds * 1000000;
+  while (now_us < end_us) {
+    run_interrupts(next_record_us < end_us ? next_record_us : end_us);
+    sd_log_process();
+  }
+  recording = false;
+  sd_log_flush();
+  close(image_fd);
+
+  const sd_log_stats_t* stats = sd_log_stats();
+  printf("logged %u records of %s%zu bytes at %u Hz for %u s, %u buffers\n",
+      next_index, varying ? "8 to " : "", sizeof(imu_record_t), rate, seconds, SD_LOG_BUFFERS);
+  printf("card: %u us per block, %u ms stall every %u blocks\n", WRITE_US, stall_ms, STALL_EVERY);
+  printf("%u records stored, %u dropped (%.2f%%), %u blocks written, %u write errors\n",
+      stats->records, stats->dropped, 100.0 * stats->dropped / next_index, stats->blocks,
+      stats->write_errors);
+
+  log_summary_t summary;
+  expected_index = 0;
+  bad_records = 0;
+  if (!read_log(path, check_record, &summary)) {
+    return 1;
+  }
+  print_summary(path, &summary);
+  bool ok = bad_records == 0 && summary.records == stats->records &&
+            summary.dropped + (next_index - expected_index) == stats->dropped;
+  printf("read back: %u bad records, %s\n", bad_records, ok ? "all records accounted for" : "MISMATCH");
+  return ok ? 0 : 1;
+}
+
+static void dump_record(const uint8_t* data, uint16_t size, uint32_t dropped_before) {
+  if (dropped_before > 0) {
+    printf("# %u dropped\n", dropped_before);
+  }
+  for (uint16_t i = 0; i < size; i++) {
+    printf("%02x", data[i]);
+  }
+  printf("\n");
+}
+
+static FILE* extract_file;
+
+static void extract_record(const uint8_t* data, uint16_t size, uint32_t dropped_before) {
+  fwrite(data, 1, size, extract_file);
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: sd_log_tool bench image [rate_hz [seconds [stall_ms]]]\n"
+                  "       sd_log_tool bench-varying image [rate_hz [seconds [stall_ms]]]\n"
+                  "       sd_log_tool verify image\n"
+                  "       sd_log_tool dump image\n"
+                  "       sd_log_tool extract image stream\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    return usage();
+  }
+
+  if (strcmp(argv[1], "bench") == 0 || strcmp(argv[1], "bench-varying") == 0) {
+    varying = argv[1][5] == '-';
+    uint32_t rate = argc > 3 ? strtoul(argv[3], NULL, 0) : 952;
+    uint32_t seconds = argc > 4 ? strtoul(argv[4], NULL, 0) : 60;
+    uint32_t stall_ms = argc > 5 ? strtoul(argv[5], NULL, 0) : DEFAULT_STALL_MS;
+    if (rate == 0 || seconds == 0) {
+      return usage();
+    }
+    return bench(argv[2], rate, seconds, stall_ms);
+  }
+
+  if (strcmp(argv[1], "verify") == 0 || strcmp(argv[1], "dump") == 0) {
+    bool dump = argv[1][0] == 'd';
+    log_summary_t summary;
+    if (!read_log(argv[2], dump ? dump_record : NULL, &summary)) {
+      return 1;
+    }
+    if (!dump) {
+      print_summary(argv[2], &summary);
+    }
+    return 0;
+  }
+
+  if (strcmp(argv[1], "extract") == 0 && argc == 4) {
+    extract_file = fopen(argv[3], "wb");
+    if (extract_file == NULL) {
+      perror(argv[3]);
+      return 1;
+    }
+    log_summary_t summary;
+    bool ok = read_log(argv[2], extract_record, &summary);
+    if (fclose(extract_file) != 0) {
+      perror(argv[3]);
+      ok = false;
+    }
+    if (ok) {
+      printf("%u records\n", summary.records);
+    }
+    return ok ? 0 : 1;
+  }
+
+  return usage();
+}
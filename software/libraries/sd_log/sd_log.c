@@ -0,0 +1,246 @@
+// Binary block logger
+//
+// The buffers form a ring. Records go into the filling block, which is
+// sealed with its header when no more fit, either once it is full of fixed
+// size records or when the next record of varying length comes and doesn't
+// fit. Sealed blocks wait in order
+// to be written. The filling block is always the one after the last
+// sealed block, so the main loop can write sealed blocks without a lock
+// while records keep arriving; only the bookkeeping is shared, and it is
+// touched with interrupts disabled.
+
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "sd_log.h"
+
+static sd_log_config_t log_config;
+static bool started; // records may be stored
+
+static uint8_t buffers[SD_LOG_BUFFERS][SD_LOG_BLOCK_SIZE];
+static uint8_t fill_buffer;   // buffer records are going into
+static uint16_t fill_count;   // records in it
+static uint16_t fill_used;    // bytes of records in it
+static uint8_t write_buffer;  // oldest sealed buffer
+static uint8_t sealed_count;  // sealed buffers waiting to be written
+
+static uint32_t next_sequence;  // of the next block sealed, also its block number
+static uint32_t drops_pending;  // dropped since the last block sealed
+
+static sd_log_stats_t stats;
+
+static void put16(uint8_t* buf, uint16_t value) {
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+}
+
+static void put32(uint8_t* buf, uint32_t value) {
+  put16(buf, value & 0xFFFF);
+  put16(buf + 2, value >> 16);
+}
+
+static uint16_t get16(const uint8_t* buf) {
+  return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* buf) {
+  return get16(buf) | ((uint32_t)get16(buf + 2) << 16);
+}
+
+ret_code_t sd_log_init(const sd_log_config_t* config) {
+  if (config->record_size > SD_LOG_MAX_RECORD_SIZE || config->blocks < 2 || config->backend == NULL) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  ret_code_t err_code = config->backend->open(config->backend->context, config->blocks);
+  if (err_code != NRF_SUCCESS) {
+    return err_code;
+  }
+
+  // stop recording while block 0 is built in the first buffer
+  CRITICAL_REGION_ENTER();
+  started = false;
+  CRITICAL_REGION_EXIT();
+
+  uint16_t per_block = config->record_size ? SD_LOG_MAX_RECORD_SIZE / config->record_size : 0;
+  uint8_t* info = buffers[0];
+  memset(info, 0, SD_LOG_BLOCK_SIZE);
+  memcpy(info, SD_LOG_FILE_MAGIC, sizeof(SD_LOG_FILE_MAGIC) - 1);
+  put16(info + 8, config->record_size);
+  put16(info + 10, per_block);
+  put32(info + 12, config->blocks);
+  if (config->name != NULL) {
+    strncpy((char*)info + 16, config->name, 31);
+  }
+  put32(info + 48, config->log_id);
+
+  err_code = config->backend->write(config->backend->context, 0, info);
+  if (err_code == NRF_SUCCESS) {
+    err_code = config->backend->sync(config->backend->context);
+  }
+  if (err_code != NRF_SUCCESS) {
+    return err_code;
+  }
+
+  CRITICAL_REGION_ENTER();
+  log_config = *config;
+  fill_buffer = 0;
+  fill_count = 0;
+  fill_used = 0;
+  write_buffer = 0;
+  sealed_count = 0;
+  next_sequence = 1;
+  drops_pending = 0;
+  stats = (sd_log_stats_t){0};
+  started = true;
+  CRITICAL_REGION_EXIT();
+
+  return NRF_SUCCESS;
+}
+
+// Finish the filling block and move on to the next buffer, must be called
+// with interrupts disabled and records in the block
+static void seal(void) {
+  uint8_t* block = buffers[fill_buffer];
+  put16(block, SD_LOG_BLOCK_MAGIC);
+  put16(block + 2, fill_count);
+  put32(block + 4, next_sequence);
+  put32(block + 8, drops_pending);
+  put32(block + 12, log_config.log_id);
+  // whatever a previous use of the buffer left after the last record
+  memset(block + SD_LOG_HEADER_SIZE + fill_used, 0, SD_LOG_MAX_RECORD_SIZE - fill_used);
+
+  next_sequence++;
+  drops_pending = 0;
+  sealed_count++;
+  fill_buffer = (fill_buffer + 1) % SD_LOG_BUFFERS;
+  fill_count = 0;
+  fill_used = 0;
+  stats.full = next_sequence >= log_config.blocks;
+}
+
+// Copy a record of size bytes into the filling block, after a length byte
+// if the log's records vary
+static bool store(const void* record, uint16_t size, bool varying) {
+  bool stored = false;
+  uint16_t stored_size = size + (varying ? 1 : 0);
+
+  CRITICAL_REGION_ENTER();
+  bool accepted = started && varying == (log_config.record_size == 0);
+  if (accepted && fill_used + stored_size > SD_LOG_MAX_RECORD_SIZE) {
+    seal();
+  }
+  if (!accepted || sealed_count == SD_LOG_BUFFERS || stats.full) {
+    stats.dropped++;
+    drops_pending++;
+  } else {
+    uint8_t* dest = buffers[fill_buffer] + SD_LOG_HEADER_SIZE + fill_used;
+    if (varying) {
+      *dest++ = size;
+    }
+    memcpy(dest, record, size);
+    fill_count++;
+    fill_used += stored_size;
+    stats.records++;
+    stored = true;
+    // when no other fixed size record fits, send the block on its way now
+    if (!varying && fill_used + size > SD_LOG_MAX_RECORD_SIZE) {
+      seal();
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  return stored;
+}
+
+bool sd_log_record(const void* record) {
+  return store(record, log_config.record_size, false);
+}
+
+bool sd_log_record_varying(const void* record, uint8_t size) {
+  return store(record, size, true);
+}
+
+ret_code_t sd_log_process(void) {
+  ret_code_t result = NRF_SUCCESS;
+
+  while (true) {
+    uint8_t sealed;
+    CRITICAL_REGION_ENTER();
+    sealed = sealed_count;
+    CRITICAL_REGION_EXIT();
+    if (sealed == 0) {
+      break;
+    }
+
+    // records only go into the buffer after the sealed ones, so this one is
+    // left alone while it is written
+    const uint8_t* block = buffers[write_buffer];
+    ret_code_t err_code = log_config.backend->write(log_config.backend->context,
+                                                    get32(block + 4), block);
+    if (err_code == NRF_SUCCESS) {
+      stats.blocks++;
+    } else {
+      stats.write_errors++;
+      if (result == NRF_SUCCESS) {
+        result = err_code;
+      }
+    }
+
+    CRITICAL_REGION_ENTER();
+    write_buffer = (write_buffer + 1) % SD_LOG_BUFFERS;
+    sealed_count--;
+    CRITICAL_REGION_EXIT();
+  }
+
+  return result;
+}
+
+ret_code_t sd_log_flush(void) {
+  if (!started) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+
+  CRITICAL_REGION_ENTER();
+  if (fill_count > 0) {
+    seal();
+  }
+  CRITICAL_REGION_EXIT();
+
+  ret_code_t err_code = sd_log_process();
+  ret_code_t sync_code = log_config.backend->sync(log_config.backend->context);
+  return err_code != NRF_SUCCESS ? err_code : sync_code;
+}
+
+const sd_log_stats_t* sd_log_stats(void) {
+  return &stats;
+}
+
+bool sd_log_parse_info(const uint8_t* block, sd_log_info_t* info) {
+  if (memcmp(block, SD_LOG_FILE_MAGIC, sizeof(SD_LOG_FILE_MAGIC) - 1) != 0) {
+    return false;
+  }
+  info->record_size = get16(block + 8);
+  info->records_per_block = get16(block + 10);
+  info->blocks = get32(block + 12);
+  memcpy(info->name, block + 16, sizeof(info->name) - 1);
+  info->name[sizeof(info->name) - 1] = '\0';
+  info->log_id = get32(block + 48);
+  if (info->record_size == 0) {
+    return info->records_per_block == 0;
+  }
+  return info->record_size <= SD_LOG_MAX_RECORD_SIZE &&
+         info->records_per_block == SD_LOG_MAX_RECORD_SIZE / info->record_size;
+}
+
+bool sd_log_parse_block(const uint8_t* block, uint32_t log_id, uint16_t* count, uint32_t* sequence,
+                        uint32_t* dropped) {
+  if (get16(block) != SD_LOG_BLOCK_MAGIC || get32(block + 12) != log_id) {
+    return false;
+  }
+  *count = get16(block + 2);
+  *sequence = get32(block + 4);
+  *dropped = get32(block + 8);
+  return *count > 0 && *count <= SD_LOG_MAX_RECORD_SIZE;
+}
@@ -0,0 +1,134 @@
+// Binary block logger
+//
+// Logs binary records at high rates, e.g. IMU samples or Kobuki sensor
+// frames, where formatting each one as a line of text and writing it
+// through FatFs a line at a time can't keep up and stalls the code logging.
+// A log's records are either all one size, or each its own length, such as
+// records encoded with telemetry_codec.h.
+//
+// Records are copied into 512 byte blocks in RAM, which takes a few
+// microseconds and may be done from interrupt handlers. Full blocks are
+// written out whole by sd_log_process() from the main loop, while the next
+// block fills. When every block is full because the card has fallen
+// behind, new records are dropped and counted rather than waiting.
+//
+// Blocks go to a backend that stores numbered 512 byte blocks, FatFs on
+// the robot (sd_log_fatfs.h) or a plain file on Linux. The backend sets
+// aside room for the whole log before the first record, so writes never
+// wait for the file system to find free space. That room still holds
+// whatever was there before, often the blocks of an older log, so every
+// log has its own id.
+//
+// Block 0 of a log describes the records and holds the id. Every other
+// block starts with a header:
+//
+//   0  uint16  SD_LOG_BLOCK_MAGIC
+//   2  uint16  records in the block
+//   4  uint32  block sequence number, 1 for the first
+//   8  uint32  records dropped just before this block's first record
+//  12  uint32  the log's id
+//
+// followed by the records back to back, each after a byte holding its
+// length if the log's records vary in length. Records never span two
+// blocks. The
+// log ends at the first block whose id or sequence number is wrong. All
+// fields are little-endian, so logs read the same on any host.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+#define SD_LOG_BLOCK_SIZE 512
+#define SD_LOG_HEADER_SIZE 16
+#define SD_LOG_MAX_RECORD_SIZE (SD_LOG_BLOCK_SIZE - SD_LOG_HEADER_SIZE)
+#define SD_LOG_MAX_VARYING_SIZE 255
+
+#define SD_LOG_FILE_MAGIC "SDLOG2"
+#define SD_LOG_BLOCK_MAGIC 0x4C42
+
+// Blocks of RAM records are collected in, at least 2. Eight hold 20 byte
+// records at 952 Hz through a 100 ms card stall, in 4 kB of RAM.
+#ifndef SD_LOG_BUFFERS
+#define SD_LOG_BUFFERS 8
+#endif
+
+// Where the blocks go
+typedef struct {
+  // Set aside room for the given number of blocks, from block 0
+  ret_code_t (*open)(void* context, uint32_t blocks);
+  // Store SD_LOG_BLOCK_SIZE bytes of data as a block
+  ret_code_t (*write)(void* context, uint32_t block, const uint8_t* data);
+  // Make everything written so far survive a power cut
+  ret_code_t (*sync)(void* context);
+  void* context;
+} sd_log_backend_t;
+
+typedef struct {
+  uint16_t record_size; // 1 to SD_LOG_MAX_RECORD_SIZE bytes, 0 if records vary
+  uint32_t blocks;      // size of the log, including the description block
+  const sd_log_backend_t* backend;
+  const char* name;     // stored in the description, up to 31 characters
+  uint32_t log_id;      // different for every log, e.g. from the RNG
+} sd_log_config_t;
+
+typedef struct {
+  uint32_t records;      // records stored in RAM
+  uint32_t dropped;      // records lost because every buffer was full
+  uint32_t blocks;       // blocks written
+  uint32_t write_errors; // blocks the backend failed to write, and lost
+  bool full;             // no room left in the log
+} sd_log_stats_t;
+
+// The description in block 0
+typedef struct {
+  uint16_t record_size;       // 0 if records vary
+  uint16_t records_per_block; // 0 if records vary
+  uint32_t blocks;
+  char name[32];
+  uint32_t log_id;
+} sd_log_info_t;
+
+// Open the backend and write the description block
+//
+// Returns NRF_ERROR_INVALID_PARAM for a record size that doesn't fit in a
+// block or a log without room for records, or the backend's error
+ret_code_t sd_log_init(const sd_log_config_t* config);
+
+// Copy a record into the current block, in a log of fixed size records
+//
+// Safe to call from interrupt handlers and the main loop. Returns false if
+// the record was dropped
+bool sd_log_record(const void* record);
+
+// Copy size bytes of a record into the current block, in a log of records
+// that vary
+//
+// As sd_log_record(), which also counts a record as dropped if the log's
+// records aren't the kind the call is for
+bool sd_log_record_varying(const void* record, uint8_t size);
+
+// Write out full blocks, call from the main loop
+//
+// Returns the first backend error, if any
+ret_code_t sd_log_process(void);
+
+// Write out everything recorded so far, including a partly filled block,
+// and sync the backend
+ret_code_t sd_log_flush(void);
+
+const sd_log_stats_t* sd_log_stats(void);
+
+// Read a description block
+//
+// Returns false if block isn't one
+bool sd_log_parse_info(const uint8_t* block, sd_log_info_t* info);
+
+// Read a record block's header
+//
+// Returns false if block isn't one of the log with log_id, e.g. because the
+// log ended before it
+bool sd_log_parse_block(const uint8_t* block, uint32_t log_id, uint16_t* count, uint32_t* sequence,
+                        uint32_t* dropped);
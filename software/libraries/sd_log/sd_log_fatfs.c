@@ -0,0 +1,81 @@
+// FatFs backend for the binary block logger
+//
+// Seeking past the end of a file opened for writing makes FatFs allocate
+// clusters up to that point, which is how the log is preallocated. Once
+// they are allocated, writing a block never has to search the FAT.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ff.h"
+
+#include "sd_log_fatfs.h"
+
+static FATFS fs;
+static FIL file;
+static const char* file_path;
+static bool file_open;
+
+static ret_code_t fatfs_open(void* context, uint32_t blocks) {
+  if (file_open) {
+    f_close(&file);
+    file_open = false;
+  }
+
+  // mounting initializes the card
+  if (f_mount(&fs, "", 1) != FR_OK) {
+    return NRF_ERROR_INTERNAL;
+  }
+  if (f_open(&file, file_path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    return NRF_ERROR_INTERNAL;
+  }
+  file_open = true;
+
+  FSIZE_t size = (FSIZE_t)blocks * SD_LOG_BLOCK_SIZE;
+  if (f_lseek(&file, size) != FR_OK) {
+    return NRF_ERROR_INTERNAL;
+  }
+  if (f_tell(&file) != size) {
+    // the card is full, the file only grew as far as there was room
+    return NRF_ERROR_NO_MEM;
+  }
+  if (f_lseek(&file, 0) != FR_OK || f_sync(&file) != FR_OK) {
+    return NRF_ERROR_INTERNAL;
+  }
+  return NRF_SUCCESS;
+}
+
+static ret_code_t fatfs_write(void* context, uint32_t block, const uint8_t* data) {
+  if (!file_open) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+
+  FSIZE_t offset = (FSIZE_t)block * SD_LOG_BLOCK_SIZE;
+  if (f_tell(&file) != offset && f_lseek(&file, offset) != FR_OK) {
+    return NRF_ERROR_INTERNAL;
+  }
+  UINT written = 0;
+  if (f_write(&file, data, SD_LOG_BLOCK_SIZE, &written) != FR_OK || written != SD_LOG_BLOCK_SIZE) {
+    return NRF_ERROR_INTERNAL;
+  }
+  return NRF_SUCCESS;
+}
+
+static ret_code_t fatfs_sync(void* context) {
+  if (!file_open) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  return f_sync(&file) == FR_OK ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
+
+static const sd_log_backend_t backend = {
+  .open = fatfs_open,
+  .write = fatfs_write,
+  .sync = fatfs_sync,
+  .context = NULL,
+};
+
+const sd_log_backend_t* sd_log_fatfs_backend(const char* path) {
+  file_path = path;
+  return &backend;
+}
@@ -0,0 +1,18 @@
+// FatFs backend for the binary block logger
+//
+// Stores a log as one file on the SD card, which is created, or emptied if
+// it exists, and grown to the full size of the log before any records are
+// written. Blocks land at their own offset in the file, so each write is a
+// whole 512 byte sector that FatFs passes straight to the card.
+//
+// The card pins come from buckler.h, as for simple_logger, and the GPIOs
+// must be set up as in apps/sd_card first.
+
+#pragma once
+
+#include "sd_log.h"
+
+// Backend for a log at path, which must stay valid while logging
+//
+// Only one log can be open at a time
+const sd_log_backend_t* sd_log_fatfs_backend(const char* path);
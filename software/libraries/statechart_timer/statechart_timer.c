@@ -0,0 +1,182 @@
+// Statechart timer service
+//
+// The table is shared with the virtual timer interrupt, so it is only
+// touched with interrupts disabled. Raise callbacks run with interrupts
+// enabled, since they run a statechart's code.
+
+#include <stddef.h>
+
+#include "app_util_platform.h"
+
+#include "statechart_timer.h"
+#include "virtual_timer.h"
+
+typedef struct {
+  void* handle;
+  void* evid;
+  statechart_timer_raise_t raise;
+  uint64_t deadline;
+  uint64_t period_us; // 0 for one-shot events
+  bool armed;         // waiting for its deadline
+  bool pending;       // expired, waiting to be raised
+} time_event_t;
+
+static time_event_t events[STATECHART_TIMER_MAX_EVENTS];
+static volatile uint16_t pending_count;
+static uint32_t timer_id = VIRTUAL_TIMER_INVALID;
+
+static bool in_use(const time_event_t* event) {
+  return event->armed || event->pending;
+}
+
+static time_event_t* find(void* handle, void* evid) {
+  for (uint8_t i = 0; i < STATECHART_TIMER_MAX_EVENTS; i++) {
+    if (in_use(&events[i]) && events[i].handle == handle && events[i].evid == evid) {
+      return &events[i];
+    }
+  }
+  return NULL;
+}
+
+static void set_pending(time_event_t* event, bool pending) {
+  if (event->pending != pending) {
+    event->pending = pending;
+    if (pending) {
+      pending_count++;
+    } else {
+      pending_count--;
+    }
+  }
+}
+
+static void timer_fired(void);
+
+// Point the virtual timer at the earliest armed deadline, must be called
+// with interrupts disabled
+static void reschedule(void) {
+  virtual_timer_cancel(timer_id);
+  timer_id = VIRTUAL_TIMER_INVALID;
+
+  bool armed = false;
+  uint64_t earliest = 0;
+  for (uint8_t i = 0; i < STATECHART_TIMER_MAX_EVENTS; i++) {
+    if (events[i].armed && (!armed || events[i].deadline < earliest)) {
+      earliest = events[i].deadline;
+      armed = true;
+    }
+  }
+  if (!armed) {
+    return;
+  }
+
+  // a deadline more than a timer range away just wakes us early to look again
+  uint64_t now = read_timer64();
+  uint64_t delay = earliest > now ? earliest - now : 0;
+  if (delay > UINT32_MAX) {
+    delay = UINT32_MAX;
+  }
+  timer_id = virtual_timer_start((uint32_t)delay, timer_fired);
+  APP_ERROR_CHECK_BOOL(timer_id != VIRTUAL_TIMER_INVALID);
+}
+
+// Virtual timer callback, marks expired events pending
+static void timer_fired(void) {
+  CRITICAL_REGION_ENTER();
+  timer_id = VIRTUAL_TIMER_INVALID;
+  uint64_t now = read_timer64();
+  for (uint8_t i = 0; i < STATECHART_TIMER_MAX_EVENTS; i++) {
+    time_event_t* event = &events[i];
+    if (!event->armed || event->deadline > now) {
+      continue;
+    }
+    set_pending(event, true);
+    if (event->period_us) {
+      // stay on the original grid, skipping periods that were missed
+      do {
+        event->deadline += event->period_us;
+      } while (event->deadline <= now);
+    } else {
+      event->armed = false;
+    }
+  }
+  reschedule();
+  CRITICAL_REGION_EXIT();
+}
+
+ret_code_t statechart_timer_set(void* handle, void* evid, uint32_t time_ms, bool periodic, statechart_timer_raise_t raise) {
+  ret_code_t err_code = NRF_SUCCESS;
+
+  // a zero period would never move the deadline past now
+  if (periodic && time_ms == 0) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  CRITICAL_REGION_ENTER();
+  time_event_t* event = find(handle, evid);
+  if (event == NULL) {
+    for (uint8_t i = 0; i < STATECHART_TIMER_MAX_EVENTS; i++) {
+      if (!in_use(&events[i])) {
+        event = &events[i];
+        break;
+      }
+    }
+  }
+
+  if (event == NULL) {
+    err_code = NRF_ERROR_NO_MEM;
+  } else {
+    uint64_t time_us = (uint64_t)time_ms * 1000;
+    set_pending(event, false);
+    event->handle = handle;
+    event->evid = evid;
+    event->raise = raise;
+    event->deadline = read_timer64() + time_us;
+    event->period_us = periodic ? time_us : 0;
+    event->armed = true;
+    reschedule();
+  }
+  CRITICAL_REGION_EXIT();
+
+  return err_code;
+}
+
+void statechart_timer_unset(void* handle, void* evid) {
+  CRITICAL_REGION_ENTER();
+  time_event_t* event = find(handle, evid);
+  if (event != NULL) {
+    set_pending(event, false);
+    event->armed = false;
+    reschedule();
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+bool statechart_timer_pending(void) {
+  return pending_count > 0;
+}
+
+uint16_t statechart_timer_dispatch(void) {
+  uint16_t raised = 0;
+
+  for (uint8_t i = 0; i < STATECHART_TIMER_MAX_EVENTS; i++) {
+    statechart_timer_raise_t raise = NULL;
+    void* handle = NULL;
+    void* evid = NULL;
+
+    CRITICAL_REGION_ENTER();
+    if (events[i].pending) {
+      set_pending(&events[i], false);
+      raise = events[i].raise;
+      handle = events[i].handle;
+      evid = events[i].evid;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (raise != NULL) {
+      raise(handle, evid);
+      raised++;
+    }
+  }
+
+  return raised;
+}
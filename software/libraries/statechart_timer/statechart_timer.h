@@ -0,0 +1,57 @@
+// Statechart timer service
+//
+// Time events for Yakindu generated state machines. Generated code for a
+// chart with `after` or `every` triggers calls <chart>_setTimer() and
+// <chart>_unsetTimer(), which the application implements by passing the
+// arguments on to statechart_timer_set() and statechart_timer_unset().
+//
+// Deadlines are kept in a small table served by a single virtual timer that
+// always points at the earliest one. When it fires, expired events are only
+// marked pending. The main loop raises them with statechart_timer_dispatch()
+// and runs a cycle only when something was raised, so the state machine
+// never runs from an interrupt and never polls while idle.
+//
+// virtual_timer_init() must be called before any timer is set.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// Time events that can be set at once, across all state machines
+#ifndef STATECHART_TIMER_MAX_EVENTS
+#define STATECHART_TIMER_MAX_EVENTS 16
+#endif
+
+// Raises a time event, normally by calling <chart>_raiseTimeEvent()
+//
+// handle and evid are whatever was passed to statechart_timer_set()
+typedef void (*statechart_timer_raise_t)(void* handle, void* evid);
+
+// Start the timer for a time event, replacing any timer already set for the
+// same handle and evid
+//
+// time_ms  - delay until the event is raised
+// periodic - raise it again every time_ms until it is unset
+// Returns NRF_ERROR_NO_MEM if STATECHART_TIMER_MAX_EVENTS are already set,
+// NRF_ERROR_INVALID_PARAM for a periodic event with a time_ms of 0
+ret_code_t statechart_timer_set(void* handle, void* evid, uint32_t time_ms, bool periodic, statechart_timer_raise_t raise);
+
+// Stop the timer for a time event, also dropping it if it expired but hasn't
+// been raised yet
+void statechart_timer_unset(void* handle, void* evid);
+
+// True if any time event has expired and is waiting to be raised
+//
+// Safe to call from interrupt handlers
+bool statechart_timer_pending(void);
+
+// Raise every expired time event, from the main loop
+//
+// A periodic event that expired more than once since the last dispatch is
+// raised once.
+// Returns the number of events raised, so the caller knows whether to run a
+// cycle
+uint16_t statechart_timer_dispatch(void);
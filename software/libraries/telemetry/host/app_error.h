@@ -0,0 +1,9 @@
+// Host stand-in for the SDK's app_error.h
+//
+// telemetry_ble.h includes it, the tool only needs the batch size from there.
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
@@ -0,0 +1,8 @@
+// Host stand-in for the SDK's app_util_platform.h
+//
+// The host tool is single threaded, so critical regions need do nothing.
+
+#pragma once
+
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
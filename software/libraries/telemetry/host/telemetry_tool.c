@@ -0,0 +1,544 @@
+// Host tool for telemetry streams
+//
+// Builds on Linux from the same codec sources as the robot, so anything it
+// decodes is decoded exactly as the robot encoded it.
+//
+// usage: telemetry_tool bench [trace]
+//        telemetry_tool widths trace
+//        telemetry_tool encode trace stream
+//        telemetry_tool decode stream
+//        telemetry_tool decode-steps stream
+//
+// A trace is fixed size samples back to back, as written by telemetry_encode()
+// or telemetry_reader.py --record. A stream is encoded records back to back,
+// as in a log file. bench measures the codec on a trace, or on a synthetic
+// drive when none is given, and checks that every sample round-trips.
+// widths finds the bit field widths that encode a trace smallest.
+// decode-steps decodes Kobuki control steps, as sd_binary_log logs them,
+// from a stream sd_log_tool extracted.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.h"
+#include "telemetry_ble.h"
+#include "telemetry_codec.h"
+#include "telemetry_kobuki.h"
+
+#define MAX_SAMPLES 200000
+
+// Synthetic drive length, 10 minutes at 50 Hz
+#define SYNTHETIC_SAMPLES 30000
+
+// Sample lost in the resync check
+#define LOST_SAMPLE 1000
+
+// Notification payload at the 247 byte MTU ble_throughput asks for
+#define BLE_PACKET_SIZE 244
+
+// Size reduction the sample encoding is meant to reach on a robot's trace
+#define TARGET_RATIO 4.0
+
+// Widest bit field space widths tries for a member
+#define MAX_WIDTH 12
+
+static telemetry_sample_t samples[MAX_SAMPLES];
+static KobukiSensors_t frames[MAX_SAMPLES];
+static telemetry_kobuki_step_t steps[SYNTHETIC_SAMPLES];
+
+// repeatable noise, uniform in [-amplitude, amplitude]
+static uint32_t seed = 1;
+static int noise(int amplitude) {
+  seed = seed * 1664525 + 1013904223;
+  return (int)((seed >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Drive in straight lines and turns at the control loop rate, with sensor
+// noise, stopping now and then
+static uint32_t synthesize(void) {
+  double x = 0, y = 0, heading = 0;
+  double left_ticks = 0, right_ticks = 0;
+  uint32_t time_ms = 0;
+  uint8_t state = 0;
+
+  for (uint32_t i = 0; i < SYNTHETIC_SAMPLES; i++) {
+    // every 4 s: drive 3 s, turn 0.5 s, stop 0.5 s
+    uint32_t phase = i % 200;
+    double left = 0, right = 0; // mm/s
+    if (phase < 150) {
+      state = 1;
+      left = right = 100;
+    } else if (phase < 175) {
+      state = 2;
+      left = -60;
+      right = 60;
+    } else {
+      state = 0;
+    }
+
+    double dt = 0.02;
+    left_ticks += left * dt / 0.08529;
+    right_ticks += right * dt / 0.08529;
+    double turn = (right - left) * dt / 230;
+    x += (left + right) / 2 * dt * cos(heading + turn / 2);
+    y += (left + right) / 2 * dt * sin(heading + turn / 2);
+    heading = remainder(heading + turn, 2 * M_PI);
+    time_ms += 20 + (noise(20) == 0); // an occasional late step
+
+    telemetry_sample_t* s = &samples[i];
+    s->time_ms = time_ms;
+    s->x_mm = lround(x);
+    s->y_mm = lround(y);
+    s->heading_cdeg = lround(heading * 18000 / M_PI);
+    s->left_encoder = (uint16_t)(int64_t)left_ticks;
+    s->right_encoder = (uint16_t)(int64_t)right_ticks;
+    s->gyro_z_ddps = lround(turn / dt * 1800 / M_PI) + noise(3);
+    s->accel_mg[0] = noise(8);
+    s->accel_mg[1] = noise(8);
+    s->accel_mg[2] = 1000 + noise(8);
+    s->loop_us = 2400 + noise(100);
+    s->bumps = phase == 149 ? TELEMETRY_BUMP_CENTER : 0;
+    s->state = state;
+
+    // the Kobuki's own packet for the same step
+    KobukiSensors_t* f = &frames[i];
+    memset(f, 0, sizeof(*f));
+    f->bumps_wheelDrops.bumpCenter = s->bumps != 0;
+    f->cliffLeftSignal = 1800 + noise(6);
+    f->cliffCenterSignal = 1900 + noise(6);
+    f->cliffRightSignal = 1750 + noise(6);
+    f->leftWheelEncoder = s->left_encoder;
+    f->rightWheelEncoder = s->right_encoder;
+    f->leftWheelCurrent = left ? 12 + noise(2) : 0;
+    f->rightWheelCurrent = right ? 12 + noise(2) : 0;
+    f->leftWheelPWM = left / 4;
+    f->rightWheelPWM = right / 4;
+    f->timeStamp = (uint16_t)time_ms;
+    f->batteryVoltage = 160 - i / 10000;
+    f->chargingState = DISCHARGING;
+    f->angle = s->heading_cdeg;
+    f->angleRate = s->gyro_z_ddps * 10;
+    f->xAxisRate = noise(30);
+    f->yAxisRate = noise(30);
+    f->zAxisRate = s->gyro_z_ddps * 11 + noise(30);
+    f->docking = (KobukiDocking_t){FAR_RIGHT, FAR_RIGHT, FAR_RIGHT};
+    f->hardwareVersion = (KobukiVersion_t){0, 0, 1};
+    f->firmwareVersion = (KobukiVersion_t){2, 1, 1};
+    f->UID[0] = 0x3f5c1a07;
+    f->UID[1] = 0x12345678;
+    f->UID[2] = 0x9abcdef0;
+    f->controllerGain = (KobukiGain_t){false, 100000, 100, 2000000};
+
+    // and the step sd_binary_log would log
+    telemetry_kobuki_step_t* step = &steps[i];
+    memset(step, 0, sizeof(*step));
+    step->time_ms = time_ms;
+    memcpy(step->accel_mg, s->accel_mg, sizeof(step->accel_mg));
+    step->gyro_ddps[0] = noise(3);
+    step->gyro_ddps[1] = noise(3);
+    step->gyro_ddps[2] = s->gyro_z_ddps;
+    step->sensors = *f;
+  }
+
+  return SYNTHETIC_SAMPLES;
+}
+
+static uint32_t read_trace(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  uint8_t buf[TELEMETRY_SAMPLE_SIZE];
+  uint32_t count = 0;
+  while (count < MAX_SAMPLES && fread(buf, sizeof(buf), 1, file) == 1) {
+    telemetry_decode(buf, &samples[count++]);
+  }
+  fclose(file);
+  return count;
+}
+
+// Length of the log line a printf logger would write for a sample
+static int text_size(const telemetry_sample_t* s) {
+  return snprintf(NULL, 0, "%lu,%d,%d,%d,%u,%u,%d,%d,%d,%d,%u,%u,%u\n",
+      (unsigned long)s->time_ms, s->x_mm, s->y_mm, s->heading_cdeg, s->left_encoder,
+      s->right_encoder, s->gyro_z_ddps, s->accel_mg[0], s->accel_mg[1], s->accel_mg[2],
+      s->loop_us, s->bumps, s->state);
+}
+
+// Encode count records of record_size bytes into stream, skipping the one
+// at lost if there is one, and return the stream length
+static size_t encode_all(const telemetry_schema_t* schema, const void* records, size_t record_size,
+                         uint32_t count, int64_t lost, uint8_t* stream, uint16_t* max_record) {
+  telemetry_codec_t codec;
+  telemetry_codec_init(&codec, schema, TELEMETRY_KEYFRAME_INTERVAL);
+  size_t len = 0;
+  *max_record = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t record_len = telemetry_codec_encode(&codec, (const uint8_t*)records + i * record_size, stream + len);
+    if (record_len > *max_record) {
+      *max_record = record_len;
+    }
+    if (i != lost) {
+      len += record_len;
+    }
+  }
+  return len;
+}
+
+// Decode a stream and compare each record with the original, returning the
+// number of records that failed to match
+static uint32_t check_all(const telemetry_schema_t* schema, const void* records, size_t record_size,
+                          uint32_t count, int64_t lost, const uint8_t* stream, size_t len,
+                          uint32_t* skipped) {
+  telemetry_codec_t codec;
+  telemetry_codec_init(&codec, schema, 0);
+  uint8_t* record = malloc(record_size);
+  uint32_t failed = 0;
+  size_t pos = 0;
+  *skipped = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (i == lost) {
+      continue;
+    }
+    uint16_t used = 0;
+    memset(record, 0, record_size);
+    telemetry_codec_result_t result = telemetry_codec_decode(&codec, stream + pos,
+        len - pos > UINT16_MAX ? UINT16_MAX : len - pos, record, &used);
+    if (result == TELEMETRY_CODEC_SKIPPED) {
+      (*skipped)++;
+    } else if (result != TELEMETRY_CODEC_RECORD) {
+      failed += count - i;
+      break;
+    } else {
+      // compare as keyframes, so padding is ignored
+      telemetry_codec_t a;
+      telemetry_codec_t b;
+      telemetry_codec_init(&a, schema, 1);
+      telemetry_codec_init(&b, schema, 1);
+      uint8_t buf_a[256];
+      uint8_t buf_b[256];
+      uint16_t len_a = telemetry_codec_encode(&a, (const uint8_t*)records + i * record_size, buf_a);
+      uint16_t len_b = telemetry_codec_encode(&b, record, buf_b);
+      if (len_a != len_b || memcmp(buf_a, buf_b, len_a) != 0) {
+        failed++;
+      }
+    }
+    pos += used;
+  }
+
+  free(record);
+  return failed;
+}
+
+static int bench(const char* name, const telemetry_schema_t* schema, const void* records,
+                 size_t record_size, uint32_t count, double baseline, const char* baseline_name) {
+  uint8_t* stream = malloc((size_t)count * telemetry_codec_max_size(schema));
+  uint16_t max_record;
+  uint32_t skipped;
+
+  size_t len = encode_all(schema, records, record_size, count, -1, stream, &max_record);
+  uint32_t failed = check_all(schema, records, record_size, count, -1, stream, len, &skipped);
+  double per_record = (double)len / count;
+
+  printf("%s: %lu records\n", name, (unsigned long)count);
+  printf("  %-24s %7.2f bytes/record\n", baseline_name, baseline);
+  printf("  %-24s %7.2f bytes/record, %.2fx smaller, longest %u of %u\n", "encoded",
+      per_record, baseline / per_record, max_record, telemetry_codec_max_size(schema));
+  printf("  round trip: %s\n", failed ? "FAILED" : "ok");
+
+  // lose a record and check decoding picks up again at the next keyframe
+  uint32_t lost_failed = 0;
+  if (count > LOST_SAMPLE) {
+    len = encode_all(schema, records, record_size, count, LOST_SAMPLE, stream, &max_record);
+    lost_failed = check_all(schema, records, record_size, count, LOST_SAMPLE, stream, len, &skipped);
+    printf("  after a lost record: %lu skipped until the next keyframe, %s\n",
+        (unsigned long)skipped, lost_failed ? "FAILED" : "rest ok");
+  }
+
+  free(stream);
+  return failed || lost_failed;
+}
+
+// Send the samples through telemetry_packet() as telemetry_ble does, a
+// batch at a time, and check the records in the packets decode to them
+static int bench_ble(uint32_t count, double* ratio) {
+  uint8_t* stream = malloc((size_t)count * TELEMETRY_RECORD_MAX);
+  size_t len = 0;
+  size_t bytes = 0;
+  uint32_t packets = 0;
+  uint8_t packet[BLE_PACKET_SIZE];
+
+  telemetry_init(1);
+  for (uint32_t i = 0; i <= count; i++) {
+    if (i < count) {
+      telemetry_record(&samples[i]);
+    }
+    while (telemetry_buffered() >= TELEMETRY_BLE_BATCH || (i == count && telemetry_pending())) {
+      uint16_t packet_len = telemetry_packet(packet, sizeof(packet));
+      memcpy(stream + len, packet + TELEMETRY_HEADER_SIZE, packet_len - TELEMETRY_HEADER_SIZE);
+      len += packet_len - TELEMETRY_HEADER_SIZE;
+      bytes += packet_len;
+      packets++;
+    }
+  }
+
+  uint32_t skipped;
+  uint32_t failed = check_all(&telemetry_sample_schema, samples, sizeof(telemetry_sample_t), count, -1,
+                              stream, len, &skipped);
+  double per_sample = (double)bytes / count;
+  *ratio = TELEMETRY_SAMPLE_SIZE / per_sample;
+  printf("  %-24s %7.2f bytes/record, %.2fx smaller, %lu packets of up to %u bytes, %u samples a batch\n",
+      "BLE stream", per_sample, TELEMETRY_SAMPLE_SIZE / per_sample, (unsigned long)packets,
+      BLE_PACKET_SIZE, TELEMETRY_BLE_BATCH);
+  printf("  BLE round trip: %s\n", failed ? "FAILED" : "ok");
+
+  free(stream);
+  return failed != 0;
+}
+
+static int run_bench(const char* path) {
+  uint32_t count = path ? read_trace(path) : synthesize();
+  if (count == 0) {
+    fprintf(stderr, "empty trace\n");
+    return 1;
+  }
+
+  double text = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    text += text_size(&samples[i]);
+  }
+
+  printf("trace: %s\n\n", path ? path : "synthetic drive");
+  int failed = bench("telemetry samples", &telemetry_sample_schema, samples, sizeof(telemetry_sample_t),
+                     count, TELEMETRY_SAMPLE_SIZE, "fixed size");
+  double ratio = 0;
+  failed |= bench_ble(count, &ratio);
+  printf("  %-24s %7.2f bytes/record\n", "printf text", text / count);
+  // the widths were picked on the synthetic drive, so only a recorded trace
+  // says whether the target is met
+  if (path) {
+    printf("  %.0fx target on the BLE stream: %s\n\n", TARGET_RATIO, ratio >= TARGET_RATIO ? "met" : "MISSED");
+  } else {
+    printf("  %.0fx target on the BLE stream: unverified, bench a recorded trace\n\n", TARGET_RATIO);
+  }
+
+  // a recorded trace has no Kobuki packets to go with it
+  if (!path) {
+    failed |= bench("Kobuki sensor packets", &telemetry_kobuki_schema, frames, sizeof(KobukiSensors_t),
+                    count, sizeof(KobukiSensors_t), "KobukiSensors_t");
+    failed |= bench("Kobuki control steps", &telemetry_kobuki_step_schema, steps,
+                    sizeof(telemetry_kobuki_step_t), count, sizeof(telemetry_kobuki_step_t),
+                    "telemetry_kobuki_step_t");
+  }
+  return failed;
+}
+
+// Members of telemetry_sample_schema, in order
+static const char* const field_names[] = {
+  "time_ms", "x_mm", "y_mm", "heading_cdeg", "left_encoder", "right_encoder", "gyro_z_ddps",
+  "accel_mg[0]", "accel_mg[1]", "accel_mg[2]", "loop_us", "bumps", "state",
+};
+
+// Bytes a trace's samples encode to with the given fields
+static size_t encoded_size(const telemetry_field_t* fields, uint8_t field_count, uint32_t count,
+                           uint8_t* stream) {
+  telemetry_schema_t schema = {.fields = fields, .count = field_count};
+  uint16_t max_record;
+  return encode_all(&schema, samples, sizeof(telemetry_sample_t), count, -1, stream, &max_record);
+}
+
+// Try every width for each member in turn, keeping the best, until no
+// change helps, and print the resulting fields for telemetry.c
+static int widths(const char* path) {
+  uint32_t count = read_trace(path);
+  if (count == 0) {
+    fprintf(stderr, "empty trace\n");
+    return 1;
+  }
+  uint8_t field_count = telemetry_sample_schema.count;
+  telemetry_field_t fields[TELEMETRY_CODEC_MAX_FIELDS];
+  memcpy(fields, telemetry_sample_schema.fields, field_count * sizeof(fields[0]));
+  uint8_t* stream = malloc((size_t)count * TELEMETRY_RECORD_MAX);
+
+  size_t start = encoded_size(fields, field_count, count, stream);
+  size_t best = start;
+  bool improved = true;
+  while (improved) {
+    improved = false;
+    for (uint8_t i = 0; i < field_count; i++) {
+      if (fields[i].kind == TELEMETRY_FIELD_BITS) {
+        continue; // its width is the member's, not a choice
+      }
+      uint8_t current = fields[i].bits;
+      for (uint8_t width = 0; width <= MAX_WIDTH; width++) {
+        fields[i].bits = width;
+        size_t size = encoded_size(fields, field_count, count, stream);
+        if (size < best) {
+          best = size;
+          current = width;
+          improved = true;
+        }
+      }
+      fields[i].bits = current;
+    }
+  }
+
+  uint32_t total = 0;
+  printf("trace: %s, %lu samples\n", path, (unsigned long)count);
+  for (uint8_t i = 0; i < field_count; i++) {
+    uint8_t old = telemetry_sample_schema.fields[i].bits;
+    printf("  %-14s %2u bits", i < sizeof(field_names) / sizeof(field_names[0]) ? field_names[i] : "?",
+        fields[i].bits);
+    if (fields[i].bits != old) {
+      printf(", schema has %u", old);
+    }
+    printf("\n");
+    total += fields[i].bits ? fields[i].bits : 1;
+  }
+  printf("%u bits in the bit field\n", total);
+  printf("current widths: %.2f bytes/record, %.2fx smaller\n",
+      (double)start / count, TELEMETRY_SAMPLE_SIZE * (double)count / start);
+  printf("best widths:    %.2f bytes/record, %.2fx smaller\n",
+      (double)best / count, TELEMETRY_SAMPLE_SIZE * (double)count / best);
+  free(stream);
+  return 0;
+}
+
+static int encode(const char* trace, const char* out) {
+  uint32_t count = read_trace(trace);
+  uint8_t* stream = malloc((size_t)count * telemetry_codec_max_size(&telemetry_sample_schema) + 1);
+  uint16_t max_record;
+  size_t len = encode_all(&telemetry_sample_schema, samples, sizeof(telemetry_sample_t), count, -1,
+                          stream, &max_record);
+
+  FILE* file = fopen(out, "wb");
+  if (file == NULL || fwrite(stream, 1, len, file) != len) {
+    perror(out);
+    return 1;
+  }
+  fclose(file);
+  printf("%lu samples, %lu bytes\n", (unsigned long)count, (unsigned long)len);
+  free(stream);
+  return 0;
+}
+
+static void print_sample_header(void) {
+  printf("time_ms,x_mm,y_mm,heading_cdeg,left_encoder,right_encoder,gyro_z_ddps,"
+         "accel_x_mg,accel_y_mg,accel_z_mg,loop_us,bumps,state\n");
+}
+
+static void print_sample(const void* record) {
+  const telemetry_sample_t* s = record;
+  printf("%lu,%d,%d,%d,%u,%u,%d,%d,%d,%d,%u,%u,%u\n",
+      (unsigned long)s->time_ms, s->x_mm, s->y_mm, s->heading_cdeg, s->left_encoder,
+      s->right_encoder, s->gyro_z_ddps, s->accel_mg[0], s->accel_mg[1], s->accel_mg[2],
+      s->loop_us, s->bumps, s->state);
+}
+
+#define STEP_NAME(member, kind, bits) #member,
+
+// Members of telemetry_kobuki_step_schema, in order
+static const char* const step_names[] = {
+  "time_ms", "accel_x_mg", "accel_y_mg", "accel_z_mg", "gyro_x_ddps", "gyro_y_ddps", "gyro_z_ddps",
+  TELEMETRY_KOBUKI_FIELDS(STEP_NAME)
+};
+
+static void print_step_header(void) {
+  for (uint8_t i = 0; i < telemetry_kobuki_step_schema.count; i++) {
+    printf("%s%s", i ? "," : "", step_names[i]);
+  }
+  printf("\n");
+}
+
+// Every member of the step as a number, as the codec sees them
+static void print_step(const void* record) {
+  for (uint8_t i = 0; i < telemetry_kobuki_step_schema.count; i++) {
+    const telemetry_field_t* field = &telemetry_kobuki_step_schema.fields[i];
+    const uint8_t* member = (const uint8_t*)record + field->offset;
+    long value = 0;
+    if (field->size == 1) {
+      value = field->is_signed ? *(const int8_t*)member : *member;
+    } else if (field->size == 2) {
+      int16_t v;
+      memcpy(&v, member, sizeof(v));
+      value = field->is_signed ? v : (uint16_t)v;
+    } else {
+      int32_t v;
+      memcpy(&v, member, sizeof(v));
+      value = field->is_signed ? v : (long)(uint32_t)v;
+    }
+    printf("%s%ld", i ? "," : "", value);
+  }
+  printf("\n");
+}
+
+// Print every record of a stream as CSV
+static int decode(const char* path, const telemetry_schema_t* schema, size_t record_size,
+                  void (*print_header)(void), void (*print)(const void* record)) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+  static uint8_t stream[MAX_SAMPLES * TELEMETRY_RECORD_MAX];
+  size_t len = fread(stream, 1, sizeof(stream), file);
+  fclose(file);
+
+  telemetry_codec_t codec;
+  telemetry_codec_init(&codec, schema, 0);
+  uint8_t* record = malloc(record_size);
+  print_header();
+
+  size_t pos = 0;
+  uint32_t skipped = 0;
+  while (pos < len) {
+    uint16_t used = 0;
+    memset(record, 0, record_size);
+    telemetry_codec_result_t result = telemetry_codec_decode(&codec, stream + pos,
+        len - pos > UINT16_MAX ? UINT16_MAX : len - pos, record, &used);
+    if (result == TELEMETRY_CODEC_INCOMPLETE || result == TELEMETRY_CODEC_INVALID) {
+      fprintf(stderr, "%s record at byte %lu\n",
+          result == TELEMETRY_CODEC_INVALID ? "invalid" : "truncated", (unsigned long)pos);
+      free(record);
+      return 1;
+    }
+    pos += used;
+    if (result == TELEMETRY_CODEC_SKIPPED) {
+      skipped++;
+      continue;
+    }
+    print(record);
+  }
+  if (skipped) {
+    fprintf(stderr, "%lu records skipped waiting for a keyframe\n", (unsigned long)skipped);
+  }
+  free(record);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+    return run_bench(argc > 2 ? argv[2] : NULL);
+  } else if (argc == 3 && strcmp(argv[1], "widths") == 0) {
+    return widths(argv[2]);
+  } else if (argc == 4 && strcmp(argv[1], "encode") == 0) {
+    return encode(argv[2], argv[3]);
+  } else if (argc == 3 && strcmp(argv[1], "decode") == 0) {
+    return decode(argv[2], &telemetry_sample_schema, sizeof(telemetry_sample_t), print_sample_header,
+                  print_sample);
+  } else if (argc == 3 && strcmp(argv[1], "decode-steps") == 0) {
+    return decode(argv[2], &telemetry_kobuki_step_schema, sizeof(telemetry_kobuki_step_t),
+                  print_step_header, print_step);
+  }
+
+  fprintf(stderr, "usage: %s bench [trace]\n"
+                  "       %s widths trace\n"
+                  "       %s encode trace stream\n"
+                  "       %s decode stream\n"
+                  "       %s decode-steps stream\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 2;
+}
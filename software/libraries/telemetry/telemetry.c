@@ -0,0 +1,224 @@
+// Batched robot telemetry
+//
+// The ring is shared between the recording context and the sending one,
+// so its indices only change with interrupts disabled. Building a packet
+// copies samples out one at a time and encodes them outside the critical
+// region.
+
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "telemetry.h"
+
+#define RING_MASK (TELEMETRY_RING_SIZE - 1)
+
+static telemetry_sample_t ring[TELEMETRY_RING_SIZE];
+static volatile uint32_t head; // next slot to write
+static volatile uint32_t tail; // next slot to read
+
+static uint16_t decimation = 1;
+static uint16_t skip; // samples left to skip before the next one is kept
+
+// Counts and timestamps that grow steadily take second differences, values
+// that drift take first differences. The widths fit the usual change of
+// each member on telemetry_tool's synthetic drive, and add up to 40 bits so
+// a record between keyframes is a tag and five bytes unless something
+// jumps. They haven't been checked on a robot's trace yet; telemetry_tool
+// widths finds the best ones for one.
+static const telemetry_field_t sample_fields[] = {
+  TELEMETRY_FIELD(telemetry_sample_t, time_ms, TELEMETRY_FIELD_DELTA2, 1),
+  TELEMETRY_FIELD(telemetry_sample_t, x_mm, TELEMETRY_FIELD_DELTA2, 2),
+  TELEMETRY_FIELD(telemetry_sample_t, y_mm, TELEMETRY_FIELD_DELTA2, 2),
+  TELEMETRY_FIELD(telemetry_sample_t, heading_cdeg, TELEMETRY_FIELD_DELTA2, 2),
+  TELEMETRY_FIELD(telemetry_sample_t, left_encoder, TELEMETRY_FIELD_DELTA2, 2),
+  TELEMETRY_FIELD(telemetry_sample_t, right_encoder, TELEMETRY_FIELD_DELTA2, 2),
+  TELEMETRY_FIELD(telemetry_sample_t, gyro_z_ddps, TELEMETRY_FIELD_DELTA, 4),
+  TELEMETRY_FIELD(telemetry_sample_t, accel_mg[0], TELEMETRY_FIELD_DELTA, 5),
+  TELEMETRY_FIELD(telemetry_sample_t, accel_mg[1], TELEMETRY_FIELD_DELTA, 5),
+  TELEMETRY_FIELD(telemetry_sample_t, accel_mg[2], TELEMETRY_FIELD_DELTA, 5),
+  TELEMETRY_FIELD(telemetry_sample_t, loop_us, TELEMETRY_FIELD_DELTA, 8),
+  TELEMETRY_FIELD(telemetry_sample_t, bumps, TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_sample_t, state, TELEMETRY_FIELD_DELTA, 0),
+};
+
+const telemetry_schema_t telemetry_sample_schema = {
+  .fields = sample_fields,
+  .count = sizeof(sample_fields) / sizeof(sample_fields[0]),
+};
+
+static telemetry_codec_t codec;
+
+// the record being split across packets
+static uint8_t partial[TELEMETRY_RECORD_MAX];
+static uint8_t partial_sent;
+static uint8_t partial_left;
+
+static uint8_t sequence;
+static telemetry_stats_t stats;
+
+static void put16(uint8_t* buf, uint16_t value) {
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+}
+
+static void put32(uint8_t* buf, uint32_t value) {
+  put16(buf, value & 0xFFFF);
+  put16(buf + 2, value >> 16);
+}
+
+static uint16_t get16(const uint8_t* buf) {
+  return buf[0] | ((uint16_t)buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* buf) {
+  return get16(buf) | ((uint32_t)get16(buf + 2) << 16);
+}
+
+void telemetry_encode(const telemetry_sample_t* sample, uint8_t* buf) {
+  put32(buf, sample->time_ms);
+  put16(buf + 4, sample->x_mm);
+  put16(buf + 6, sample->y_mm);
+  put16(buf + 8, sample->heading_cdeg);
+  put16(buf + 10, sample->left_encoder);
+  put16(buf + 12, sample->right_encoder);
+  put16(buf + 14, sample->gyro_z_ddps);
+  put16(buf + 16, sample->accel_mg[0]);
+  put16(buf + 18, sample->accel_mg[1]);
+  put16(buf + 20, sample->accel_mg[2]);
+  put16(buf + 22, sample->loop_us);
+  buf[24] = sample->bumps;
+  buf[25] = sample->state;
+}
+
+void telemetry_decode(const uint8_t* buf, telemetry_sample_t* sample) {
+  sample->time_ms = get32(buf);
+  sample->x_mm = get16(buf + 4);
+  sample->y_mm = get16(buf + 6);
+  sample->heading_cdeg = get16(buf + 8);
+  sample->left_encoder = get16(buf + 10);
+  sample->right_encoder = get16(buf + 12);
+  sample->gyro_z_ddps = get16(buf + 14);
+  sample->accel_mg[0] = get16(buf + 16);
+  sample->accel_mg[1] = get16(buf + 18);
+  sample->accel_mg[2] = get16(buf + 20);
+  sample->loop_us = get16(buf + 22);
+  sample->bumps = buf[24];
+  sample->state = buf[25];
+}
+
+void telemetry_init(uint16_t decimation) {
+  CRITICAL_REGION_ENTER();
+  telemetry_codec_init(&codec, &telemetry_sample_schema, TELEMETRY_KEYFRAME_INTERVAL);
+  sequence = 0;
+  stats = (telemetry_stats_t){0};
+  CRITICAL_REGION_EXIT();
+  telemetry_flush();
+  telemetry_set_decimation(decimation);
+}
+
+void telemetry_set_decimation(uint16_t value) {
+  CRITICAL_REGION_ENTER();
+  decimation = value ? value : 1;
+  if (skip >= decimation) {
+    skip = 0;
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+uint16_t telemetry_decimation(void) {
+  return decimation;
+}
+
+bool telemetry_record(const telemetry_sample_t* sample) {
+  bool kept = false;
+
+  CRITICAL_REGION_ENTER();
+  if (skip > 0) {
+    skip--;
+  } else {
+    skip = decimation - 1;
+    if (head - tail < TELEMETRY_RING_SIZE) {
+      ring[head & RING_MASK] = *sample;
+      head++;
+      stats.recorded++;
+      kept = true;
+    } else {
+      stats.dropped++;
+    }
+  }
+  CRITICAL_REGION_EXIT();
+
+  return kept;
+}
+
+void telemetry_flush(void) {
+  CRITICAL_REGION_ENTER();
+  tail = head;
+  partial_left = 0;
+  telemetry_codec_reset(&codec);
+  CRITICAL_REGION_EXIT();
+}
+
+bool telemetry_pending(void) {
+  return partial_left > 0 || head != tail;
+}
+
+uint16_t telemetry_buffered(void) {
+  return head - tail;
+}
+
+// Take the oldest sample out of the ring
+static bool pop(telemetry_sample_t* sample) {
+  bool popped = false;
+
+  CRITICAL_REGION_ENTER();
+  if (head != tail) {
+    *sample = ring[tail & RING_MASK];
+    tail++;
+    popped = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return popped;
+}
+
+uint16_t telemetry_packet(uint8_t* buf, uint16_t len) {
+  if (len <= TELEMETRY_HEADER_SIZE || !telemetry_pending()) {
+    return 0;
+  }
+
+  buf[0] = sequence++;
+  buf[1] = 0;
+  uint16_t used = TELEMETRY_HEADER_SIZE;
+
+  while (used < len) {
+    if (partial_left == 0) {
+      telemetry_sample_t sample;
+      if (!pop(&sample)) {
+        break;
+      }
+      partial_left = telemetry_codec_encode(&codec, &sample, partial);
+      partial_sent = 0;
+      if (buf[1] == 0 && used <= UINT8_MAX) {
+        buf[1] = used;
+      }
+    }
+
+    uint16_t count = len - used;
+    if (count > partial_left) {
+      count = partial_left;
+    }
+    memcpy(buf + used, partial + partial_sent, count);
+    used += count;
+    partial_sent += count;
+    partial_left -= count;
+  }
+
+  stats.packets++;
+  return used;
+}
+
+const telemetry_stats_t* telemetry_stats(void) {
+  return &stats;
+}
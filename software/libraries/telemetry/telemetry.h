@@ -0,0 +1,119 @@
+// Batched robot telemetry
+//
+// The control loop hands one sample per step to telemetry_record(), which
+// only copies it into a ring buffer, so recording never waits on the radio.
+// A sender, such as the BLE service in telemetry_ble.h, drains the ring into
+// packets carrying as many samples as fit.
+//
+// Samples are encoded with telemetry_codec.h and telemetry_sample_schema,
+// one keyframe every TELEMETRY_KEYFRAME_INTERVAL records, and laid end to
+// end across packets, split wherever a packet fills up. Every packet starts
+// with a two byte header:
+//   byte 0  sequence number, one more than the previous packet's
+//   byte 1  index in the packet of the first record that starts in it, or 0
+//           if the packet only continues a record from the one before
+// so a receiver that misses a packet finds the next record start, and
+// decodes again from the next keyframe.
+//
+// telemetry_encode() gives the fixed size form of a sample instead, for
+// raw traces to measure the codec against.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telemetry_codec.h"
+
+// Samples buffered between sends, must be a power of two
+#ifndef TELEMETRY_RING_SIZE
+#define TELEMETRY_RING_SIZE 64
+#endif
+
+// Encoded records from one keyframe to the next, 5 s at 50 Hz. A keyframe
+// is about five records long, so shorter intervals cost a lot more bytes.
+#ifndef TELEMETRY_KEYFRAME_INTERVAL
+#define TELEMETRY_KEYFRAME_INTERVAL 250
+#endif
+
+#define TELEMETRY_HEADER_SIZE 2
+
+// Longest encoded sample, telemetry_codec_max_size(&telemetry_sample_schema)
+// rounded up
+#define TELEMETRY_RECORD_MAX 48
+
+// Fixed size form of a sample
+#define TELEMETRY_SAMPLE_SIZE 26
+
+// Bits of telemetry_sample_t.bumps
+#define TELEMETRY_BUMP_LEFT        0x01
+#define TELEMETRY_BUMP_CENTER      0x02
+#define TELEMETRY_BUMP_RIGHT       0x04
+#define TELEMETRY_WHEELDROP_LEFT   0x08
+#define TELEMETRY_WHEELDROP_RIGHT  0x10
+#define TELEMETRY_CLIFF            0x20
+
+// One step of robot state, fields in wire order
+typedef struct {
+  uint32_t time_ms;
+  int16_t x_mm;
+  int16_t y_mm;
+  int16_t heading_cdeg;   // hundredths of a degree, counter-clockwise
+  uint16_t left_encoder;
+  uint16_t right_encoder;
+  int16_t gyro_z_ddps;    // tenths of a degree per second
+  int16_t accel_mg[3];    // x, y, z
+  uint16_t loop_us;       // execution time of the control step
+  uint8_t bumps;          // TELEMETRY_BUMP_* bits
+  uint8_t state;          // application state
+} telemetry_sample_t;
+
+extern const telemetry_schema_t telemetry_sample_schema;
+
+typedef struct {
+  uint32_t recorded; // samples put in the ring
+  uint32_t dropped;  // samples lost to a full ring
+  uint32_t packets;  // packets built
+} telemetry_stats_t;
+
+// Empty the ring and restart the sequence numbers
+//
+// decimation: record one sample out of every this many, 0 is treated as 1
+void telemetry_init(uint16_t decimation);
+
+void telemetry_set_decimation(uint16_t decimation);
+
+uint16_t telemetry_decimation(void);
+
+// Offer a sample, keeping one in every decimation
+//
+// Safe to call from any context. A full ring drops the new sample rather
+// than blocking.
+// Returns true if the sample was kept
+bool telemetry_record(const telemetry_sample_t* sample);
+
+// Drop everything buffered, including any partly sent sample, so the next
+// packet starts cleanly with a keyframe
+void telemetry_flush(void);
+
+// True if telemetry_packet() has something to send
+bool telemetry_pending(void);
+
+// Samples waiting in the ring
+uint16_t telemetry_buffered(void);
+
+// Build the next packet into buf, using at most len bytes
+//
+// Only one context may build packets.
+// Returns the packet length, or 0 if nothing is waiting or len leaves no
+// room for data
+uint16_t telemetry_packet(uint8_t* buf, uint16_t len);
+
+const telemetry_stats_t* telemetry_stats(void);
+
+// Serialize a sample into TELEMETRY_SAMPLE_SIZE little-endian bytes, in
+// member order
+void telemetry_encode(const telemetry_sample_t* sample, uint8_t* buf);
+
+// Parse TELEMETRY_SAMPLE_SIZE bytes written by telemetry_encode()
+void telemetry_decode(const uint8_t* buf, telemetry_sample_t* sample);
@@ -0,0 +1,199 @@
+// BLE telemetry service
+//
+// SoftDevice events can interrupt telemetry_ble_send() in the main loop, so
+// only one context builds and sends packets at a time. The other just asks
+// it to go around again. A packet the SoftDevice had no room for is kept
+// and offered again first, so full queues never lose data.
+
+#include "telemetry_ble.h"
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include <stdbool.h>
+
+#include "app_util_platform.h"
+#include "ble.h"
+#include "ble_gatts.h"
+#include "nrf_sdh_ble.h"
+
+#include "ble_throughput.h"
+#include "simple_ble.h"
+#include "telemetry.h"
+
+// largest notification the negotiated MTU can carry
+#define MAX_PACKET (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3)
+
+static simple_ble_service_t telemetry_service = {{
+    .uuid128 = TELEMETRY_BLE_SERVICE_UUID
+}};
+
+static simple_ble_char_t data_char = {.uuid16 = TELEMETRY_BLE_DATA_UUID16};
+static simple_ble_char_t decimation_char = {.uuid16 = TELEMETRY_BLE_DECIMATION_UUID16};
+static uint8_t data_value[MAX_PACKET];
+static uint16_t decimation_value;
+
+static bool initialized;
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static bool subscribed;
+
+// packet waiting for room in the SoftDevice queue
+static uint8_t packet[MAX_PACKET];
+static uint16_t packet_len;
+
+static bool sending;
+static bool send_again;
+static bool restart; // drop old data before the next packet
+
+static uint32_t sent;
+
+void telemetry_ble_init(uint16_t decimation) {
+  telemetry_init(decimation);
+  decimation_value = telemetry_decimation();
+
+  simple_ble_add_service(&telemetry_service);
+
+  simple_ble_add_characteristic(1, 0, 1, 1,
+      sizeof(data_value), data_value,
+      &telemetry_service, &data_char);
+
+  simple_ble_add_characteristic(1, 1, 0, 0,
+      sizeof(decimation_value), (uint8_t*)&decimation_value,
+      &telemetry_service, &decimation_char);
+
+  initialized = true;
+}
+
+// Hand packets to the SoftDevice until it or the ring runs out
+static void send_packets(void) {
+  if (conn_handle == BLE_CONN_HANDLE_INVALID || !subscribed) {
+    return;
+  }
+
+  if (restart) {
+    restart = false;
+    packet_len = 0;
+    telemetry_flush();
+  }
+
+  uint16_t max_len = ble_throughput_link()->att_mtu - 3;
+  if (max_len > MAX_PACKET) {
+    max_len = MAX_PACKET;
+  }
+
+  while (true) {
+    if (packet_len == 0) {
+      if (telemetry_buffered() < TELEMETRY_BLE_BATCH) {
+        return;
+      }
+      packet_len = telemetry_packet(packet, max_len);
+      if (packet_len == 0) {
+        return;
+      }
+    }
+
+    uint16_t len = packet_len;
+    ble_gatts_hvx_params_t hvx_params = {
+      .handle = data_char.char_handle.value_handle,
+      .type = BLE_GATT_HVX_NOTIFICATION,
+      .p_len = &len,
+      .p_data = packet,
+    };
+    ret_code_t err_code = sd_ble_gatts_hvx(conn_handle, &hvx_params);
+    if (err_code == NRF_ERROR_RESOURCES) {
+      // queue full, try again when a notification completes
+      return;
+    }
+    if (err_code == NRF_SUCCESS) {
+      sent++;
+    }
+    // anything else means the link is going away, so the packet is dropped
+    packet_len = 0;
+  }
+}
+
+void telemetry_ble_send(void) {
+  if (!initialized) {
+    return;
+  }
+
+  bool run = false;
+  CRITICAL_REGION_ENTER();
+  if (sending) {
+    send_again = true;
+  } else {
+    sending = run = true;
+  }
+  CRITICAL_REGION_EXIT();
+
+  while (run) {
+    send_again = false;
+    send_packets();
+
+    CRITICAL_REGION_ENTER();
+    run = send_again;
+    sending = run;
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+uint32_t telemetry_ble_sent(void) {
+  return sent;
+}
+
+static void on_write(ble_gatts_evt_write_t const* write) {
+  if (write->handle == data_char.char_handle.cccd_handle && write->len == 2) {
+    // start each subscription with fresh data
+    subscribed = write->data[0] & BLE_GATT_HVX_NOTIFICATION;
+    restart = true;
+  } else if (write->handle == decimation_char.char_handle.value_handle && write->len == 2) {
+    telemetry_set_decimation(write->data[0] | (write->data[1] << 8));
+    decimation_value = telemetry_decimation();
+  }
+}
+
+void telemetry_ble_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context) {
+  if (!initialized) {
+    return;
+  }
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      subscribed = false;
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      subscribed = false;
+      break;
+
+    case BLE_GATTS_EVT_WRITE:
+      on_write(&p_ble_evt->evt.gatts_evt.params.write);
+      break;
+
+    case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+      break;
+
+    default:
+      return;
+  }
+
+  telemetry_ble_send();
+}
+
+#else
+
+#include "telemetry.h"
+
+void telemetry_ble_init(uint16_t decimation) {
+  telemetry_init(decimation);
+}
+
+void telemetry_ble_send(void) {
+}
+
+uint32_t telemetry_ble_sent(void) {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,67 @@
+// BLE telemetry service
+//
+// Sends telemetry packets as notifications on a single characteristic,
+// each packet as large as the negotiated ATT MTU allows. Packets are handed
+// to the SoftDevice until its transmit queue is full, and the queue is
+// topped up again as each notification goes out, so data leaves at the
+// connection event rate without the application waiting on the radio.
+//
+// Samples are sent TELEMETRY_BLE_BATCH at a time, so the two byte packet
+// header stays a small part of the stream.
+//
+// A second characteristic holds the decimation as a little-endian uint16,
+// so the receiver can choose the sample rate.
+//
+// Relies on ble_throughput for the negotiated MTU, so ble_throughput_init()
+// must be called too. Needs a SoftDevice, the functions do nothing in apps built without one.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "app_error.h"
+
+// 5e2a0001-1e49-4f6e-8d7a-6c2b9e7f0c31
+#define TELEMETRY_BLE_SERVICE_UUID {0x31,0x0c,0x7f,0x9e,0x2b,0x6c,0x7a,0x8d, \
+                                    0x6e,0x4f,0x49,0x1e,0x01,0x00,0x2a,0x5e}
+#define TELEMETRY_BLE_DATA_UUID16 0x0002
+#define TELEMETRY_BLE_DECIMATION_UUID16 0x0003
+
+// Samples to collect before sending, 0.64 s at 50 Hz. Must be less than
+// TELEMETRY_RING_SIZE.
+#ifndef TELEMETRY_BLE_BATCH
+#define TELEMETRY_BLE_BATCH 32
+#endif
+
+// Priority of the SoftDevice event observer
+#ifndef TELEMETRY_BLE_OBSERVER_PRIO
+#define TELEMETRY_BLE_OBSERVER_PRIO 2
+#endif
+
+// Register the service for SoftDevice events
+//
+// Use once at file scope in the app, like the SDK's NRF_BLE_SCAN_DEF(), so
+// only apps that use the service link its event handler and buffers.
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+#include "nrf_sdh_ble.h"
+#define TELEMETRY_BLE_DEF(_name) \
+  NRF_SDH_BLE_OBSERVER(_name ## _obs, TELEMETRY_BLE_OBSERVER_PRIO, telemetry_ble_on_ble_evt, NULL)
+void telemetry_ble_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context);
+#else
+#define TELEMETRY_BLE_DEF(_name)
+#endif
+
+// Add the service to the simple_ble app and start recording
+//
+// Must be called after simple_ble_init() and before advertising starts.
+// decimation: initial value, see telemetry_init()
+void telemetry_ble_init(uint16_t decimation);
+
+// Send whatever has been recorded, if a receiver has subscribed
+//
+// Call after recording samples, sending continues from notification
+// completion events after that.
+void telemetry_ble_send(void);
+
+// Notifications handed to the SoftDevice since boot
+uint32_t telemetry_ble_sent(void);
@@ -0,0 +1,275 @@
+// Compact binary encoding for telemetry records
+//
+// Members are widened to int32_t, sign or zero extended by their type, and
+// changes are taken modulo the member's width and sign extended, so counters
+// that wrap or step back still give small deltas. The decoder repeats the
+// encoder's arithmetic exactly, so both ends hold the same previous values.
+//
+// A member that isn't BITS puts its zigzag coded value in its bits of the
+// bit field when it fits below the all ones code. Otherwise it puts the all
+// ones code there, and a varint of how far past it the value is after the
+// bit field. With one bit that is just the flag for a nonzero value.
+
+#include <string.h>
+
+#include "telemetry_codec.h"
+
+#define TAG_KEYFRAME 0x01
+#define SEQUENCE_MASK 0x7F
+
+#define MAX_VARINT 5
+
+// Bits a member takes in the bit field
+static uint8_t field_bits(const telemetry_field_t* field) {
+  return field->bits > 0 ? field->bits : 1;
+}
+
+// Bit field code saying a varint follows, one more than the largest zigzag
+// value packed in the bit field
+static uint32_t escape_code(const telemetry_field_t* field) {
+  return (1UL << field_bits(field)) - 1;
+}
+
+static uint8_t bit_field_size(const telemetry_schema_t* schema) {
+  uint16_t bits = 0;
+  for (uint8_t i = 0; i < schema->count; i++) {
+    bits += field_bits(&schema->fields[i]);
+  }
+  return (bits + 7) / 8;
+}
+
+// Cut a value down to a member's width, extending it back as the member's
+// type would
+static int32_t fit(const telemetry_field_t* field, uint32_t value) {
+  if (field->size == 1) {
+    return field->is_signed ? (int32_t)(int8_t)value : (int32_t)(uint8_t)value;
+  } else if (field->size == 2) {
+    return field->is_signed ? (int32_t)(int16_t)value : (int32_t)(uint16_t)value;
+  }
+  return (int32_t)value;
+}
+
+// Cut a change down to a member's width, signed whatever the member's type,
+// so an unsigned counter stepping back gives a small negative change
+static int32_t fit_change(const telemetry_field_t* field, uint32_t value) {
+  if (field->size == 1) {
+    return (int8_t)value;
+  } else if (field->size == 2) {
+    return (int16_t)value;
+  }
+  return (int32_t)value;
+}
+
+static int32_t load(const telemetry_field_t* field, const void* record) {
+  const uint8_t* member = (const uint8_t*)record + field->offset;
+  if (field->size == 1) {
+    uint8_t value;
+    memcpy(&value, member, 1);
+    return fit(field, value);
+  } else if (field->size == 2) {
+    uint16_t value;
+    memcpy(&value, member, 2);
+    return fit(field, value);
+  }
+  uint32_t value;
+  memcpy(&value, member, 4);
+  return (int32_t)value;
+}
+
+static void store(const telemetry_field_t* field, void* record, int32_t value) {
+  uint8_t* member = (uint8_t*)record + field->offset;
+  if (field->size == 1) {
+    uint8_t narrow = value;
+    memcpy(member, &narrow, 1);
+  } else if (field->size == 2) {
+    uint16_t narrow = value;
+    memcpy(member, &narrow, 2);
+  } else {
+    memcpy(member, &value, 4);
+  }
+}
+
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t put_varint(uint8_t* buf, uint32_t value) {
+  uint8_t len = 0;
+  while (value >= 0x80) {
+    buf[len++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  buf[len++] = value;
+  return len;
+}
+
+// Returns the varint's length, or 0 if it runs past len or is too long
+static uint8_t get_varint(const uint8_t* buf, uint16_t len, uint32_t* value) {
+  *value = 0;
+  for (uint8_t i = 0; i < MAX_VARINT && i < len; i++) {
+    *value |= (uint32_t)(buf[i] & 0x7F) << (7 * i);
+    if (!(buf[i] & 0x80)) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static void put_bits(uint8_t* bit_field, uint16_t* pos, uint32_t value, uint8_t bits) {
+  for (uint8_t i = 0; i < bits; i++, (*pos)++) {
+    if (value & (1UL << i)) {
+      bit_field[*pos / 8] |= 1 << (*pos % 8);
+    }
+  }
+}
+
+static uint32_t get_bits(const uint8_t* bit_field, uint16_t* pos, uint8_t bits) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bits; i++, (*pos)++) {
+    if (bit_field[*pos / 8] & (1 << (*pos % 8))) {
+      value |= 1UL << i;
+    }
+  }
+  return value;
+}
+
+void telemetry_codec_init(telemetry_codec_t* codec, const telemetry_schema_t* schema, uint16_t keyframe_interval) {
+  memset(codec, 0, sizeof(*codec));
+  codec->schema = schema;
+  codec->keyframe_interval = keyframe_interval;
+}
+
+void telemetry_codec_reset(telemetry_codec_t* codec) {
+  codec->synced = false;
+}
+
+uint16_t telemetry_codec_max_size(const telemetry_schema_t* schema) {
+  uint16_t size = 1 + bit_field_size(schema);
+  for (uint8_t i = 0; i < schema->count; i++) {
+    const telemetry_field_t* field = &schema->fields[i];
+    if (field->kind != TELEMETRY_FIELD_BITS) {
+      // zigzag values need a bit more than the member, in 7 bit groups
+      size += (field->size * 8 + 1 + 6) / 7;
+    }
+  }
+  return size;
+}
+
+uint16_t telemetry_codec_encode(telemetry_codec_t* codec, const void* record, uint8_t* buf) {
+  const telemetry_schema_t* schema = codec->schema;
+
+  bool keyframe = !codec->synced || codec->since_keyframe + 1 >= codec->keyframe_interval;
+  codec->since_keyframe = keyframe ? 0 : codec->since_keyframe + 1;
+
+  buf[0] = (codec->sequence << 1) | (keyframe ? TAG_KEYFRAME : 0);
+  codec->sequence = (codec->sequence + 1) & SEQUENCE_MASK;
+
+  uint8_t* bit_field = buf + 1;
+  uint8_t bit_field_len = bit_field_size(schema);
+  memset(bit_field, 0, bit_field_len);
+  uint16_t pos = 0;
+  uint16_t len = 1 + bit_field_len;
+
+  for (uint8_t i = 0; i < schema->count; i++) {
+    const telemetry_field_t* field = &schema->fields[i];
+    int32_t value = load(field, record);
+
+    if (field->kind == TELEMETRY_FIELD_BITS) {
+      put_bits(bit_field, &pos, value, field->bits);
+      continue;
+    }
+
+    int32_t coded = value;
+    if (!keyframe && field->kind == TELEMETRY_FIELD_DELTA) {
+      coded = fit_change(field, (uint32_t)value - codec->previous[i]);
+    } else if (!keyframe && field->kind == TELEMETRY_FIELD_DELTA2) {
+      int32_t change = fit_change(field, (uint32_t)value - codec->previous[i]);
+      coded = fit_change(field, (uint32_t)change - codec->change[i]);
+      codec->change[i] = change;
+    } else if (keyframe) {
+      codec->change[i] = 0;
+    }
+    codec->previous[i] = value;
+
+    uint32_t code = zigzag(coded);
+    uint32_t escape = escape_code(field);
+    put_bits(bit_field, &pos, code < escape ? code : escape, field_bits(field));
+    if (code >= escape) {
+      len += put_varint(buf + len, code - escape);
+    }
+  }
+
+  codec->synced = true;
+  return len;
+}
+
+telemetry_codec_result_t telemetry_codec_decode(telemetry_codec_t* codec, const uint8_t* buf, uint16_t len,
+                                                void* record, uint16_t* used) {
+  const telemetry_schema_t* schema = codec->schema;
+  uint8_t bit_field_len = bit_field_size(schema);
+  if (len < 1 + bit_field_len) {
+    return TELEMETRY_CODEC_INCOMPLETE;
+  }
+
+  bool keyframe = buf[0] & TAG_KEYFRAME;
+  uint8_t sequence = buf[0] >> 1;
+  if (sequence != codec->sequence) {
+    codec->synced = false;
+  }
+  bool decode = keyframe || codec->synced;
+
+  // read every varint before changing any state, in case some are missing
+  const uint8_t* bit_field = buf + 1;
+  uint16_t pos = 0;
+  uint16_t offset = 1 + bit_field_len;
+  int32_t coded[TELEMETRY_CODEC_MAX_FIELDS] = {0};
+  for (uint8_t i = 0; i < schema->count; i++) {
+    const telemetry_field_t* field = &schema->fields[i];
+    uint32_t value = get_bits(bit_field, &pos, field_bits(field));
+    if (field->kind == TELEMETRY_FIELD_BITS) {
+      coded[i] = value;
+      continue;
+    }
+    if (value == escape_code(field)) {
+      uint8_t varint_len = get_varint(buf + offset, len - offset, &value);
+      if (varint_len == 0) {
+        return len - offset >= MAX_VARINT ? TELEMETRY_CODEC_INVALID : TELEMETRY_CODEC_INCOMPLETE;
+      }
+      offset += varint_len;
+      value += escape_code(field);
+    }
+    coded[i] = unzigzag(value);
+  }
+  *used = offset;
+  codec->sequence = (sequence + 1) & SEQUENCE_MASK;
+
+  if (!decode) {
+    return TELEMETRY_CODEC_SKIPPED;
+  }
+
+  for (uint8_t i = 0; i < schema->count; i++) {
+    const telemetry_field_t* field = &schema->fields[i];
+    int32_t value = coded[i];
+
+    if (field->kind == TELEMETRY_FIELD_BITS || field->kind == TELEMETRY_FIELD_VALUE) {
+      value = fit(field, value);
+    } else if (keyframe) {
+      value = fit(field, value);
+      codec->change[i] = 0;
+    } else if (field->kind == TELEMETRY_FIELD_DELTA) {
+      value = fit(field, (uint32_t)codec->previous[i] + value);
+    } else {
+      codec->change[i] = fit_change(field, (uint32_t)codec->change[i] + value);
+      value = fit(field, (uint32_t)codec->previous[i] + codec->change[i]);
+    }
+    codec->previous[i] = value;
+    store(field, record, value);
+  }
+
+  codec->synced = true;
+  return TELEMETRY_CODEC_RECORD;
+}
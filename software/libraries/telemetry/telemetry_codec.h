@@ -0,0 +1,94 @@
+// Compact binary encoding for telemetry records
+//
+// A schema lists the members of a record struct and how to encode each one,
+// so the same encoder serves any fixed record, whether it goes out over BLE
+// or into a log file. Every record starts with a tag byte, bit 0 set for a
+// keyframe and bits 7:1 a sequence number. A bit field follows, holding
+// BITS members packed together and a few bits for each other member, one
+// unless the schema gives it more. Those bits hold the member's coded value
+// if it is small enough, or say that a varint after the bit field holds it.
+// Members with a zero value (VALUE) or zero change (DELTA, DELTA2) take no
+// more than their bits, and a member whose changes are usually small can be
+// given enough bits to hold them without a varint.
+//
+// Keyframes carry every member's value, so a decoder can start at one.
+// Records between keyframes only decode if none before them went missing,
+// which the decoder notices from the sequence numbers.
+//
+// The encoding is the same on any little or big endian host, so the
+// encoder and decoder build on Linux as well as the nRF.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most members a schema can have
+#define TELEMETRY_CODEC_MAX_FIELDS 64
+
+typedef enum {
+  TELEMETRY_FIELD_BITS,   // low bits of the value, packed in the bit field
+  TELEMETRY_FIELD_VALUE,  // the value as a zigzag varint
+  TELEMETRY_FIELD_DELTA,  // the change since the last record, for slowly changing values
+  TELEMETRY_FIELD_DELTA2, // the change in that change, for counters and timestamps
+} telemetry_field_kind_t;
+
+typedef struct {
+  uint16_t offset; // of the member in the record
+  uint8_t size;    // of the member, 1, 2 or 4 bytes
+  bool is_signed;
+  telemetry_field_kind_t kind;
+  uint8_t bits;    // width of a BITS member, or bit field space for the
+                   // coded value of another, 0 for one bit
+} telemetry_field_t;
+
+// Describe a record member, e.g. TELEMETRY_FIELD(my_record_t, count, TELEMETRY_FIELD_DELTA2, 0)
+#define TELEMETRY_FIELD(type, member, kind, bits) \
+  {offsetof(type, member), sizeof(((type*)0)->member), \
+   (__typeof__(((type*)0)->member))-1 < (__typeof__(((type*)0)->member))1, kind, bits}
+
+typedef struct {
+  const telemetry_field_t* fields;
+  uint8_t count;
+} telemetry_schema_t;
+
+// Encoder or decoder state for one stream
+typedef struct {
+  const telemetry_schema_t* schema;
+  uint16_t keyframe_interval;
+  uint16_t since_keyframe;
+  uint8_t sequence;
+  bool synced; // previous values are valid
+  int32_t previous[TELEMETRY_CODEC_MAX_FIELDS];
+  int32_t change[TELEMETRY_CODEC_MAX_FIELDS]; // last change of DELTA2 members
+} telemetry_codec_t;
+
+typedef enum {
+  TELEMETRY_CODEC_RECORD,     // decoded a record
+  TELEMETRY_CODEC_SKIPPED,    // a record after a gap, waiting for a keyframe
+  TELEMETRY_CODEC_INCOMPLETE, // more bytes needed
+  TELEMETRY_CODEC_INVALID,    // not a record of this schema
+} telemetry_codec_result_t;
+
+// keyframe_interval: records from one keyframe to the next when encoding,
+// ignored when decoding
+void telemetry_codec_init(telemetry_codec_t* codec, const telemetry_schema_t* schema, uint16_t keyframe_interval);
+
+// Make the next record encoded a keyframe, or make the decoder wait for one
+void telemetry_codec_reset(telemetry_codec_t* codec);
+
+// Longest record a schema can encode to
+uint16_t telemetry_codec_max_size(const telemetry_schema_t* schema);
+
+// Encode a record into buf, which must have room for
+// telemetry_codec_max_size() bytes
+//
+// Returns the encoded length
+uint16_t telemetry_codec_encode(telemetry_codec_t* codec, const void* record, uint8_t* buf);
+
+// Decode the record at the start of len bytes of buf
+//
+// used: set to the length of the record for RECORD and SKIPPED
+telemetry_codec_result_t telemetry_codec_decode(telemetry_codec_t* codec, const uint8_t* buf, uint16_t len,
+                                                void* record, uint16_t* used);
@@ -0,0 +1,32 @@
+// Telemetry schema for Kobuki sensor packets
+
+#include "telemetry_kobuki.h"
+
+#define FIELD(member, kind, bits) TELEMETRY_FIELD(KobukiSensors_t, member, kind, bits),
+
+static const telemetry_field_t kobuki_fields[] = {
+  TELEMETRY_KOBUKI_FIELDS(FIELD)
+};
+
+const telemetry_schema_t telemetry_kobuki_schema = {
+  .fields = kobuki_fields,
+  .count = sizeof(kobuki_fields) / sizeof(kobuki_fields[0]),
+};
+
+#define STEP_FIELD(member, kind, bits) TELEMETRY_FIELD(telemetry_kobuki_step_t, sensors.member, kind, bits),
+
+static const telemetry_field_t step_fields[] = {
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, time_ms, TELEMETRY_FIELD_DELTA2, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, accel_mg[0], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, accel_mg[1], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, accel_mg[2], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, gyro_ddps[0], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, gyro_ddps[1], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_FIELD(telemetry_kobuki_step_t, gyro_ddps[2], TELEMETRY_FIELD_DELTA, 0),
+  TELEMETRY_KOBUKI_FIELDS(STEP_FIELD)
+};
+
+const telemetry_schema_t telemetry_kobuki_step_schema = {
+  .fields = step_fields,
+  .count = sizeof(step_fields) / sizeof(step_fields[0]),
+};
@@ -0,0 +1,84 @@
+// Telemetry schema for Kobuki sensor packets
+//
+// Encodes every member of KobukiSensors_t with telemetry_codec.h, so whole
+// sensor packets can be logged or sent losslessly. Flags take a bit each
+// and the identity, version and gain members that never change take a bit
+// between keyframes. telemetry_kobuki_step_schema adds the time and IMU
+// readings of the control step the packet was read in.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "kobukiSensorTypes.h"
+#include "telemetry_codec.h"
+
+// The members of KobukiSensors_t and how each is encoded, as
+// FIELD(member, kind, bits) for a FIELD macro given by the schema
+#define TELEMETRY_KOBUKI_FIELDS(FIELD) \
+  FIELD(bumps_wheelDrops.wheeldropLeft, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(bumps_wheelDrops.wheeldropRight, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(bumps_wheelDrops.bumpLeft, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(bumps_wheelDrops.bumpCenter, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(bumps_wheelDrops.bumpRight, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(cliffLeft, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(cliffCenter, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(cliffRight, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(cliffLeftSignal, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(cliffCenterSignal, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(cliffRightSignal, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(buttons.B0, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(buttons.B1, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(buttons.B2, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(leftWheelEncoder, TELEMETRY_FIELD_DELTA2, 0) \
+  FIELD(rightWheelEncoder, TELEMETRY_FIELD_DELTA2, 0) \
+  FIELD(leftWheelCurrent, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(rightWheelCurrent, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(leftWheelPWM, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(rightWheelPWM, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(leftWheelOverCurrent, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(rightWheelOverCurrent, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(timeStamp, TELEMETRY_FIELD_DELTA2, 0) \
+  FIELD(batteryVoltage, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(chargingState, TELEMETRY_FIELD_BITS, 3) \
+  FIELD(angle, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(angleRate, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(xAxisRate, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(yAxisRate, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(zAxisRate, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(docking.dockingRight, TELEMETRY_FIELD_BITS, 3) \
+  FIELD(docking.dockingCenter, TELEMETRY_FIELD_BITS, 3) \
+  FIELD(docking.dockingLeft, TELEMETRY_FIELD_BITS, 3) \
+  FIELD(hardwareVersion.patch, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(hardwareVersion.minor, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(hardwareVersion.major, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(firmwareVersion.patch, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(firmwareVersion.minor, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(firmwareVersion.major, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(UID[0], TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(UID[1], TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(UID[2], TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(generalInput.D0, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(generalInput.D1, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(generalInput.D2, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(generalInput.D3, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(generalInput.A0, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(generalInput.A1, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(generalInput.A2, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(generalInput.A3, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(controllerGain.userConfigured, TELEMETRY_FIELD_BITS, 1) \
+  FIELD(controllerGain.Kp, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(controllerGain.Ki, TELEMETRY_FIELD_DELTA, 0) \
+  FIELD(controllerGain.Kd, TELEMETRY_FIELD_DELTA, 0)
+
+extern const telemetry_schema_t telemetry_kobuki_schema;
+
+// A control step's sensor packet with the IMU readings taken alongside it
+typedef struct {
+  uint32_t time_ms;
+  int16_t accel_mg[3];  // x, y, z
+  int16_t gyro_ddps[3]; // tenths of a degree per second
+  KobukiSensors_t sensors;
+} telemetry_kobuki_step_t;
+
+extern const telemetry_schema_t telemetry_kobuki_step_schema;
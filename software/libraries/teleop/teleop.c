@@ -0,0 +1,117 @@
+// Teleoperation command mailbox
+//
+// The mailbox is a single slot shared with whatever context receives
+// commands, so it is only touched with interrupts disabled.
+
+#include "app_util_platform.h"
+
+#include "teleop.h"
+
+static uint64_t timeout_us;
+
+static teleop_command_t latest;
+static uint64_t latest_us;     // when latest arrived
+static bool pending;           // latest hasn't been applied yet
+static bool synced;            // latest.seq is valid for ordering
+static bool stopped = true;    // robot was told to stop, or never told anything
+static bool stop_requested;    // stop on the next teleop_next()
+
+static teleop_stats_t stats;
+
+static int16_t limit(int16_t speed) {
+  if (speed > TELEOP_MAX_SPEED) {
+    return TELEOP_MAX_SPEED;
+  }
+  if (speed < -TELEOP_MAX_SPEED) {
+    return -TELEOP_MAX_SPEED;
+  }
+  return speed;
+}
+
+void teleop_init(uint32_t timeout_ms) {
+  CRITICAL_REGION_ENTER();
+  timeout_us = (uint64_t)timeout_ms * 1000;
+  pending = false;
+  synced = false;
+  stopped = true;
+  stop_requested = false;
+  stats = (teleop_stats_t){0};
+  CRITICAL_REGION_EXIT();
+}
+
+void teleop_reset(void) {
+  CRITICAL_REGION_ENTER();
+  synced = false;
+  pending = false;
+  stop_requested = true;
+  CRITICAL_REGION_EXIT();
+}
+
+void teleop_receive(const uint8_t* data, uint16_t len, uint64_t now_us) {
+  if (len != TELEOP_COMMAND_LEN) {
+    stats.malformed++;
+    return;
+  }
+  teleop_command_t cmd = {
+    .seq = data[0] | (data[1] << 8),
+    .left = limit((int16_t)(data[2] | (data[3] << 8))),
+    .right = limit((int16_t)(data[4] | (data[5] << 8))),
+  };
+
+  CRITICAL_REGION_ENTER();
+  stats.received++;
+  // newer if ahead by less than half the sequence space, so numbers wrap
+  if (synced && (int16_t)(cmd.seq - latest.seq) <= 0) {
+    stats.stale++;
+  } else {
+    if (pending) {
+      stats.coalesced++;
+    }
+    latest = cmd;
+    latest_us = now_us;
+    pending = true;
+    synced = true;
+    stop_requested = false;
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+bool teleop_next(uint64_t now_us, teleop_command_t* cmd, uint32_t* latency_us) {
+  bool changed = false;
+
+  CRITICAL_REGION_ENTER();
+  if (pending) {
+    *cmd = latest;
+    *latency_us = now_us > latest_us ? (uint32_t)(now_us - latest_us) : 0;
+    pending = false;
+    stopped = false;
+    changed = true;
+
+    stats.applied++;
+    stats.last_latency_us = *latency_us;
+    stats.total_latency_us += *latency_us;
+    if (*latency_us > stats.max_latency_us) {
+      stats.max_latency_us = *latency_us;
+    }
+  } else if (!stopped && (stop_requested || now_us - latest_us >= timeout_us)) {
+    if (!stop_requested) {
+      stats.timeouts++;
+    }
+    *cmd = (teleop_command_t){.seq = latest.seq, .left = 0, .right = 0};
+    *latency_us = 0;
+    stopped = true;
+    changed = true;
+  }
+  stop_requested = false;
+  CRITICAL_REGION_EXIT();
+
+  return changed;
+}
+
+bool teleop_stopped(void) {
+  return stopped;
+}
+
+const teleop_stats_t* teleop_stats(void) {
+  return &stats;
+}
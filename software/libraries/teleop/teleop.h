@@ -0,0 +1,70 @@
+// Teleoperation command mailbox
+//
+// Velocity commands arrive from a radio link faster or slower than the
+// robot applies them. Each one carries a sequence number, and the mailbox
+// keeps only the newest: a command that arrives before the previous one was
+// applied replaces it, and one older than what was already received (a
+// retransmission or reordering) is dropped. Robots should act on the latest
+// intent, not work through a backlog.
+//
+// If no command arrives for the timeout, the robot is told to stop, and it
+// stays stopped until the next command.
+//
+// teleop_receive() may be called from an interrupt or SoftDevice event
+// handler while the main loop calls teleop_next(). Times are passed in, so
+// the mailbox runs on any timebase and on a Linux host.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A command on the wire: sequence number, then left and right wheel speeds
+// in mm/s, all little-endian 16 bit
+#define TELEOP_COMMAND_LEN 6
+
+// Fastest wheel speed passed on, in mm/s
+#ifndef TELEOP_MAX_SPEED
+#define TELEOP_MAX_SPEED 500
+#endif
+
+typedef struct {
+  uint16_t seq;
+  int16_t left;  // mm/s
+  int16_t right; // mm/s
+} teleop_command_t;
+
+typedef struct {
+  uint32_t received;  // commands that arrived
+  uint32_t applied;   // commands handed to the robot
+  uint32_t coalesced; // replaced by a newer one before being applied
+  uint32_t stale;     // arrived with an old sequence number
+  uint32_t malformed; // wrong length
+  uint32_t timeouts;  // stops because commands stopped arriving
+  uint32_t last_latency_us; // from arrival to being applied
+  uint32_t max_latency_us;
+  uint64_t total_latency_us;
+} teleop_stats_t;
+
+// timeout_ms: stop the robot this long after the last command
+void teleop_init(uint32_t timeout_ms);
+
+// Forget the last sequence number and stop, e.g. when a new connection
+// starts, so its first command is accepted whatever its number
+void teleop_reset(void);
+
+// Take a command from the wire, received at now_us
+void teleop_receive(const uint8_t* data, uint16_t len, uint64_t now_us);
+
+// Returns true and fills cmd when the robot should change what it's doing:
+// a new command arrived, or commands stopped and cmd is a stop
+//
+// latency_us: set to the time the command waited in the mailbox, 0 for a
+// stop
+bool teleop_next(uint64_t now_us, teleop_command_t* cmd, uint32_t* latency_us);
+
+// The robot was told to stop by the timeout or a reset, and no command has
+// arrived since
+bool teleop_stopped(void);
+
+const teleop_stats_t* teleop_stats(void);
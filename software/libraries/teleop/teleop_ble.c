@@ -0,0 +1,155 @@
+// BLE teleoperation service
+//
+// Commands are timestamped with rtc_time as their write events arrive, so
+// the latency reported covers everything between the SoftDevice receiving
+// a command and the main loop applying it. A status notification that
+// finds the SoftDevice queue full is dropped, since the next one carries
+// newer news.
+
+#include "teleop_ble.h"
+
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+
+#include "ble.h"
+#include "ble_gap.h"
+#include "ble_gatts.h"
+#include "nrf_sdh_ble.h"
+
+#include "rtc_time.h"
+#include "simple_ble.h"
+
+static simple_ble_service_t teleop_service = {{
+    .uuid128 = TELEOP_BLE_SERVICE_UUID
+}};
+
+static simple_ble_char_t command_char = {.uuid16 = TELEOP_BLE_COMMAND_UUID16};
+static simple_ble_char_t status_char = {.uuid16 = TELEOP_BLE_STATUS_UUID16};
+static uint8_t command_value[TELEOP_COMMAND_LEN];
+static uint8_t status_value[TELEOP_BLE_STATUS_LEN];
+
+static bool initialized;
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint16_t conn_interval;
+static bool subscribed;
+
+void teleop_ble_init(uint32_t timeout_ms) {
+  ret_code_t err_code = rtc_time_init();
+  APP_ERROR_CHECK(err_code);
+  teleop_init(timeout_ms);
+
+  simple_ble_add_service(&teleop_service);
+
+  simple_ble_add_characteristic(0, 1, 0, 0,
+      sizeof(command_value), command_value,
+      &teleop_service, &command_char);
+
+  simple_ble_add_characteristic(1, 0, 1, 0,
+      sizeof(status_value), status_value,
+      &teleop_service, &status_char);
+
+  initialized = true;
+}
+
+static void notify_status(uint16_t seq, uint32_t latency_us) {
+  uint8_t status[TELEOP_BLE_STATUS_LEN] = {
+    seq & 0xFF, seq >> 8,
+    latency_us & 0xFF, (latency_us >> 8) & 0xFF, (latency_us >> 16) & 0xFF, latency_us >> 24,
+  };
+  uint16_t len = sizeof(status);
+  ble_gatts_hvx_params_t hvx_params = {
+    .handle = status_char.char_handle.value_handle,
+    .type = BLE_GATT_HVX_NOTIFICATION,
+    .p_len = &len,
+    .p_data = status,
+  };
+  // the link may be going away or the queue full, either way there will
+  // be another status
+  sd_ble_gatts_hvx(conn_handle, &hvx_params);
+}
+
+bool teleop_ble_next(teleop_command_t* cmd) {
+  if (!initialized) {
+    return false;
+  }
+
+  uint32_t latency_us;
+  if (!teleop_next(rtc_time_us(), cmd, &latency_us)) {
+    return false;
+  }
+  // stops are the robot's own doing, so only commands are acknowledged
+  if (!teleop_stopped() && conn_handle != BLE_CONN_HANDLE_INVALID && subscribed) {
+    notify_status(cmd->seq, latency_us);
+  }
+  return true;
+}
+
+uint16_t teleop_ble_conn_interval(void) {
+  return conn_interval;
+}
+
+static void on_write(ble_gatts_evt_write_t const* write) {
+  if (write->handle == command_char.char_handle.value_handle) {
+    teleop_receive(write->data, write->len, rtc_time_us());
+  } else if (write->handle == status_char.char_handle.cccd_handle && write->len == 2) {
+    subscribed = write->data[0] & BLE_GATT_HVX_NOTIFICATION;
+  }
+}
+
+void teleop_ble_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context) {
+  if (!initialized) {
+    return;
+  }
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED: {
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      conn_interval = p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+      subscribed = false;
+      teleop_reset();
+
+      // centrals usually connect slowly, ask for a fast interval right away
+      ble_gap_conn_params_t conn_params = {
+        .min_conn_interval = TELEOP_BLE_MIN_CONN_INTERVAL,
+        .max_conn_interval = TELEOP_BLE_MAX_CONN_INTERVAL,
+        .slave_latency = 0,
+        .conn_sup_timeout = TELEOP_BLE_CONN_SUP_TIMEOUT,
+      };
+      sd_ble_gap_conn_param_update(conn_handle, &conn_params);
+      break;
+    }
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      conn_interval = 0;
+      subscribed = false;
+      teleop_reset();
+      break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      conn_interval = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+      break;
+
+    case BLE_GATTS_EVT_WRITE:
+      on_write(&p_ble_evt->evt.gatts_evt.params.write);
+      break;
+
+    default:
+      break;
+  }
+}
+
+#else
+
+void teleop_ble_init(uint32_t timeout_ms) {
+  teleop_init(timeout_ms);
+}
+
+bool teleop_ble_next(teleop_command_t* cmd) {
+  return false;
+}
+
+uint16_t teleop_ble_conn_interval(void) {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,83 @@
+// BLE teleoperation service
+//
+// A command characteristic takes teleop commands (see teleop.h) as write
+// without response, so the sender never waits for an acknowledgement and
+// each connection event can carry the newest command. Writes go straight
+// into the teleop mailbox from the SoftDevice event handler.
+//
+// A status characteristic notifies the sequence number of each command as
+// it is applied, followed by the microseconds it waited on the robot as a
+// little-endian uint32. A sender that timestamps its writes gets the round
+// trip latency from these, and the robot's share of it from the second
+// field.
+//
+// When a central connects, the service asks for a connection interval
+// between TELEOP_BLE_MIN_CONN_INTERVAL and TELEOP_BLE_MAX_CONN_INTERVAL with
+// no slave latency, since the interval bounds how long a command waits for
+// the radio. Disconnecting stops the robot.
+//
+// Needs a SoftDevice, the functions do nothing in apps built without one.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_util.h"
+
+#include "teleop.h"
+
+// 7e1e0001-5d3c-4b8a-9f61-2c4a8e0d7b15
+#define TELEOP_BLE_SERVICE_UUID {0x15,0x7b,0x0d,0x8e,0x4a,0x2c,0x61,0x9f, \
+                                 0x8a,0x4b,0x3c,0x5d,0x01,0x00,0x1e,0x7e}
+#define TELEOP_BLE_COMMAND_UUID16 0x0002
+#define TELEOP_BLE_STATUS_UUID16 0x0003
+
+#define TELEOP_BLE_STATUS_LEN 6
+
+// Connection interval to ask for, in 1.25 ms units
+#ifndef TELEOP_BLE_MIN_CONN_INTERVAL
+#define TELEOP_BLE_MIN_CONN_INTERVAL MSEC_TO_UNITS(7.5, UNIT_1_25_MS)
+#endif
+#ifndef TELEOP_BLE_MAX_CONN_INTERVAL
+#define TELEOP_BLE_MAX_CONN_INTERVAL MSEC_TO_UNITS(15, UNIT_1_25_MS)
+#endif
+
+// Supervision timeout, in 10 ms units
+#ifndef TELEOP_BLE_CONN_SUP_TIMEOUT
+#define TELEOP_BLE_CONN_SUP_TIMEOUT MSEC_TO_UNITS(2000, UNIT_10_MS)
+#endif
+
+// Priority of the SoftDevice event observer
+#ifndef TELEOP_BLE_OBSERVER_PRIO
+#define TELEOP_BLE_OBSERVER_PRIO 2
+#endif
+
+// Register the service for SoftDevice events
+//
+// Use once at file scope in the app, like the SDK's NRF_BLE_SCAN_DEF(), so
+// only apps that use the service link its event handler and buffers.
+#if defined(SOFTDEVICE_PRESENT) && SOFTDEVICE_PRESENT
+#include "nrf_sdh_ble.h"
+#define TELEOP_BLE_DEF(_name) \
+  NRF_SDH_BLE_OBSERVER(_name ## _obs, TELEOP_BLE_OBSERVER_PRIO, teleop_ble_on_ble_evt, NULL)
+void teleop_ble_on_ble_evt(ble_evt_t const* p_ble_evt, void* p_context);
+#else
+#define TELEOP_BLE_DEF(_name)
+#endif
+
+// Add the service to the simple_ble app and set up the mailbox
+//
+// Must be called after simple_ble_init() and before advertising starts.
+// timeout_ms: stop the robot this long after the last command
+void teleop_ble_init(uint32_t timeout_ms);
+
+// Returns true and fills cmd when the robot should change what it's doing,
+// see teleop_next(), and notifies the status of applied commands
+//
+// Call from the main loop whenever it wakes, and drive the robot with cmd
+// right away.
+bool teleop_ble_next(teleop_command_t* cmd);
+
+// Connection interval in use, in 1.25 ms units, or 0 when not connected
+uint16_t teleop_ble_conn_interval(void);
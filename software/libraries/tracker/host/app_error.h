@@ -0,0 +1,9 @@
+// Host stand-in for the SDK's app_error.h
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
@@ -0,0 +1,12 @@
+// Host stand-in for the SDK's nrf_drv_spi.h
+//
+// tracker.h takes block_t from pixy2_spi.h, which names the link types in
+// its prototypes. The tool never talks to a Pixy.
+
+#pragma once
+
+#include "app_error.h"
+
+typedef struct {
+  uint8_t unused;
+} nrf_drv_spi_t;
@@ -0,0 +1,9 @@
+// Host stand-in for the SDK's nrf_serial.h
+
+#pragma once
+
+#include "app_error.h"
+
+typedef struct {
+  uint8_t unused;
+} nrf_serial_t;
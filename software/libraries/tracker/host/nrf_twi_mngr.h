@@ -0,0 +1,9 @@
+// Host stand-in for the SDK's nrf_twi_mngr.h
+
+#pragma once
+
+#include "app_error.h"
+
+typedef struct {
+  uint8_t unused;
+} nrf_twi_mngr_t;
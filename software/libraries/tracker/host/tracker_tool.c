@@ -0,0 +1,273 @@
+// Host tool for the block tracker
+//
+// Builds on Linux from the same source as the robot, feeds the tracker
+// simulated Pixy2 frames and checks its estimates, then times updates.
+//
+// usage: tracker_tool check
+//        tracker_tool bench
+//
+// check follows a target moving at constant velocity with noisy block
+// centres and checks that position and velocity converge and that
+// predictions between and past frames hold. It then checks that a single
+// wild block is rejected, that a target that really jumped is picked up
+// again, that a track coasts through missed frames and times out, and that
+// a new signature under an old index starts over. bench reports the time
+// and cycles per frame.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "tracker.h"
+
+// Pixy2 runs at 60 fps. Noise and process variances are safety_first's.
+#define FRAME_US 16667
+#define ACCEL_VAR (300.0f * 300.0f)
+#define MEAS_VAR 2.0f
+#define NOISE_PX 2
+
+static uint32_t failures;
+
+static void expect(bool ok, const char* what) {
+  printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+
+// repeatable noise, uniform in [-amplitude, amplitude]
+static uint32_t seed = 1;
+static int32_t noise(int32_t amplitude) {
+  seed = seed * 1664525 + 1013904223;
+  return (int32_t)((seed >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+// A target moving in a straight line at constant velocity
+typedef struct {
+  float x;  // pixels at time 0
+  float y;
+  float vx; // pixels/s
+  float vy;
+} target_t;
+
+static float target_x(const target_t* target, float t) {
+  return target->x + target->vx * t;
+}
+
+static float target_y(const target_t* target, float t) {
+  return target->y + target->vy * t;
+}
+
+// Publish a frame holding one block at (x, y) plus noise
+static void send_block(tracker_t* tracker, block_snapshot_t* snapshot, uint32_t now,
+    uint16_t signature, float x, float y) {
+  block_t* block = &snapshot->blocks[0];
+  block->m_signature = signature;
+  block->m_x = (uint16_t)lroundf(x + noise(NOISE_PX));
+  block->m_y = (uint16_t)lroundf(y + noise(NOISE_PX));
+  block->m_width = 40;
+  block->m_height = 30;
+  block->m_index = 7;
+  block->m_age = block->m_age < 255 ? block->m_age + 1 : 255;
+  snapshot->numBlocks = 1;
+  snapshot->frame++;
+  snapshot->time = now;
+  tracker_update(tracker, snapshot);
+}
+
+static void send_empty(tracker_t* tracker, block_snapshot_t* snapshot, uint32_t now) {
+  snapshot->numBlocks = 0;
+  snapshot->frame++;
+  snapshot->time = now;
+  tracker_update(tracker, snapshot);
+}
+
+static int check(void) {
+  static tracker_t tracker;
+  static block_snapshot_t snapshot;
+  const target_t target = {60, 180, 120, -45};
+  uint32_t start = 0xfff00000; // just below a 32 bit boundary so time wraps
+  uint32_t now = start;
+  track_estimate_t estimate;
+  char what[64];
+
+  tracker_init(&tracker, ACCEL_VAR, MEAS_VAR);
+
+  // one second of frames, recording the error predicted half way to the
+  // next frame once the filter has had time to settle. The noise on each
+  // block centre alone is 1.6 px RMS.
+  printf("constant velocity target, %.0f, %.0f pixels/s\n", target.vx, target.vy);
+  float sum_mid = 0;
+  for (uint32_t frame = 0; frame < 60; frame++, now += FRAME_US) {
+    float t = (now - start) / 1e6f;
+    send_block(&tracker, &snapshot, now, 1, target_x(&target, t), target_y(&target, t));
+
+    const track_t* track = tracker_find(&tracker, 7);
+    if (track == NULL || !tracker_predict(track, now + FRAME_US / 2, &estimate)) {
+      expect(false, "track follows the block");
+      return 1;
+    }
+    float mid = t + FRAME_US / 2e6f;
+    float error = hypotf(estimate.x - target_x(&target, mid), estimate.y - target_y(&target, mid));
+    if (frame % 10 == 0) {
+      printf("    %5.3f s  error %5.2f px  v %6.1f, %6.1f\n", t, error, estimate.vx, estimate.vy);
+    }
+    if (frame >= 30) {
+      sum_mid += error * error;
+    }
+  }
+  const track_t* track = tracker_find(&tracker, 7);
+  float t = (now - FRAME_US - start) / 1e6f;
+  tracker_predict(track, now - FRAME_US, &estimate);
+  float vel_error = hypotf(estimate.vx - target.vx, estimate.vy - target.vy);
+  snprintf(what, sizeof(what), "velocity within 10 pixels/s (%.1f)", vel_error);
+  expect(vel_error < 10, what);
+  float rms_mid = sqrtf(sum_mid / 30);
+  snprintf(what, sizeof(what), "mid-frame prediction under 1.3 px RMS (%.2f)", rms_mid);
+  expect(rms_mid < 1.3f, what);
+  float ahead = t + TRACKER_MAX_PREDICT_US / 1e6f;
+  tracker_predict(track, now - FRAME_US + TRACKER_MAX_PREDICT_US, &estimate);
+  float ahead_error = hypotf(estimate.x - target_x(&target, ahead), estimate.y - target_y(&target, ahead));
+  snprintf(what, sizeof(what), "prediction 100 ms ahead within 3 px (%.2f)", ahead_error);
+  expect(ahead_error < 3, what);
+
+  // a block far off the track's path for one frame, as when Pixy briefly
+  // merges the target with something of the same colour
+  printf("one wild block\n");
+  t = (now - start) / 1e6f;
+  tracker_predict(track, now, &estimate);
+  float before_x = estimate.x;
+  float before_y = estimate.y;
+  send_block(&tracker, &snapshot, now, 1, target_x(&target, t) + 90, target_y(&target, t) - 60);
+  tracker_predict(track, now, &estimate);
+  float moved = hypotf(estimate.x - before_x, estimate.y - before_y);
+  expect(track->rejects == 1, "block rejected as an outlier");
+  snprintf(what, sizeof(what), "estimate unmoved by it (%.2f px)", moved);
+  expect(moved < 0.5f, what);
+  now += FRAME_US;
+  t = (now - start) / 1e6f;
+  send_block(&tracker, &snapshot, now, 1, target_x(&target, t), target_y(&target, t));
+  expect(track->rejects == 0, "next block on the path accepted");
+
+  // the target really moves somewhere else and stays there
+  printf("target jumps 100 px\n");
+  const target_t moved_target = {target.x + 100, target.y, target.vx, target.vy};
+  uint32_t frames = 0;
+  bool followed = false;
+  while (frames < TRACKER_MAX_REJECTS + 3 && !followed) {
+    now += FRAME_US;
+    frames++;
+    t = (now - start) / 1e6f;
+    send_block(&tracker, &snapshot, now, 1, target_x(&moved_target, t), target_y(&moved_target, t));
+    tracker_predict(track, now, &estimate);
+    followed = fabsf(estimate.x - target_x(&moved_target, t)) < 5;
+  }
+  snprintf(what, sizeof(what), "followed after %d frames (%u)", TRACKER_MAX_REJECTS + 1, frames);
+  expect(followed && frames == TRACKER_MAX_REJECTS + 1, what);
+
+  // frames with no block, as when the target is hidden
+  printf("target hidden\n");
+  uint32_t last = now;
+  for (uint32_t frame = 0; frame < 5; frame++) {
+    now += FRAME_US;
+    send_empty(&tracker, &snapshot, now);
+  }
+  expect(tracker_find(&tracker, 7) != NULL, "track kept through 5 missed frames");
+  expect(tracker_predict(track, last + TRACKER_TIMEOUT_US, &estimate), "prediction at the timeout");
+  expect(!tracker_predict(track, last + TRACKER_TIMEOUT_US + 1, &estimate), "no prediction past the timeout");
+  while ((int32_t)(now - last) <= TRACKER_TIMEOUT_US) {
+    now += FRAME_US;
+    send_empty(&tracker, &snapshot, now);
+  }
+  expect(tracker_find(&tracker, 7) == NULL, "track dropped after the timeout");
+
+  // Pixy reuses tracking indexes, a different signature is a new object
+  printf("index reused\n");
+  now += FRAME_US;
+  send_block(&tracker, &snapshot, now, 1, 100, 100);
+  now += FRAME_US;
+  send_block(&tracker, &snapshot, now, 2, 250, 40);
+  track = tracker_find(&tracker, 7);
+  expect(track != NULL && track->signature == 2, "new signature starts a new track");
+  expect(track != NULL && fabsf(track->x.pos - 250) < 3 && track->x.vel == 0, "new track starts at the block, at rest");
+
+  printf("%s\n", failures ? "FAILED" : "all checks passed");
+  return failures ? 1 : 0;
+}
+
+#define BENCH_FRAMES 1000000
+
+static volatile float sink;
+
+static int bench(void) {
+  static tracker_t tracker;
+  static block_snapshot_t snapshot;
+  tracker_init(&tracker, ACCEL_VAR, MEAS_VAR);
+
+  // a full frame of blocks, each moving at its own speed
+  snapshot.numBlocks = CCC_MAX_BLOCKS < TRACKER_MAX_TRACKS ? CCC_MAX_BLOCKS : TRACKER_MAX_TRACKS;
+  for (int8_t b = 0; b < snapshot.numBlocks; b++) {
+    snapshot.blocks[b].m_signature = 1;
+    snapshot.blocks[b].m_index = b;
+    snapshot.blocks[b].m_width = 20;
+    snapshot.blocks[b].m_height = 20;
+  }
+
+  struct timespec start;
+  struct timespec end;
+#ifdef HAVE_TSC
+  uint64_t cycles = __rdtsc();
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint32_t now = 0;
+  track_estimate_t estimate;
+  for (uint32_t i = 0; i < BENCH_FRAMES; i++) {
+    now += FRAME_US;
+    for (int8_t b = 0; b < snapshot.numBlocks; b++) {
+      snapshot.blocks[b].m_x = (uint16_t)(((i % 200) * (b + 1)) % 316);
+      snapshot.blocks[b].m_y = (uint16_t)(100 + noise(NOISE_PX));
+    }
+    snapshot.frame++;
+    snapshot.time = now;
+    tracker_update(&tracker, &snapshot);
+    tracker_predict(&tracker.tracks[0], now + FRAME_US / 2, &estimate);
+    sink += estimate.x;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+#ifdef HAVE_TSC
+  cycles = __rdtsc() - cycles;
+#endif
+  double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_FRAMES;
+  printf("tracker_update of %d blocks and a prediction: %.1f ns", snapshot.numBlocks, ns);
+#ifdef HAVE_TSC
+  printf(", %.0f TSC cycles", (double)cycles / BENCH_FRAMES);
+#endif
+  printf(" per frame\n");
+  return 0;
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: tracker_tool check\n"
+                  "       tracker_tool bench\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return usage();
+  }
+  if (strcmp(argv[1], "check") == 0) {
+    return check();
+  }
+  if (strcmp(argv[1], "bench") == 0) {
+    return bench();
+  }
+  return usage();
+}
@@ -0,0 +1,169 @@
+// Multi-object tracker for Pixy2 color connected components
+//
+// Follows blocks across camera frames by their Pixy tracking index and
+// filters each one with a constant velocity Kalman filter, so that the
+// position of a target can be predicted at any time between frames.
+
+#include <string.h>
+
+#include "tracker.h"
+
+// Signed microseconds from a to b, correct across timer wraparound
+static int32_t elapsed_us(uint32_t a, uint32_t b) {
+  return (int32_t)(b - a);
+}
+
+static void axis_init(tracker_axis_t* axis, float pos, float meas_var) {
+  axis->pos = pos;
+  axis->vel = 0;
+  axis->p_pos = meas_var;
+  axis->p_cov = 0;
+  axis->p_vel = TRACKER_INITIAL_VEL_VAR;
+}
+
+// Advance an axis by dt seconds with white noise acceleration
+static void axis_predict(tracker_axis_t* axis, float dt, float accel_var) {
+  float dt2 = dt * dt;
+
+  axis->pos += axis->vel * dt;
+  axis->p_pos += dt * (2 * axis->p_cov + dt * axis->p_vel) + accel_var * dt2 * dt2 / 4;
+  axis->p_cov += dt * axis->p_vel + accel_var * dt2 * dt / 2;
+  axis->p_vel += accel_var * dt2;
+}
+
+// Correct an axis with a position measurement
+static void axis_correct(tracker_axis_t* axis, float pos, float meas_var) {
+  float s = axis->p_pos + meas_var;
+  float k_pos = axis->p_pos / s;
+  float k_vel = axis->p_cov / s;
+  float innovation = pos - axis->pos;
+
+  axis->pos += k_pos * innovation;
+  axis->vel += k_vel * innovation;
+  axis->p_vel -= k_vel * axis->p_cov;
+  axis->p_pos *= 1 - k_pos;
+  axis->p_cov *= 1 - k_pos;
+}
+
+static void track_start(tracker_t* tracker, track_t* track, const block_t* block, uint32_t time) {
+  track->active = true;
+  track->index = block->m_index;
+  track->signature = block->m_signature;
+  track->age = block->m_age;
+  track->time = time;
+  track->rejects = 0;
+  axis_init(&track->x, block->m_x, tracker->meas_var);
+  axis_init(&track->y, block->m_y, tracker->meas_var);
+  track->width = block->m_width;
+  track->height = block->m_height;
+}
+
+// Squared distance of a measurement from the predicted position of an axis,
+// in variances of the innovation
+static float axis_distance(const tracker_axis_t* axis, float pos, float meas_var) {
+  float innovation = pos - axis->pos;
+  return innovation * innovation / (axis->p_pos + meas_var);
+}
+
+// Returns false if the block was rejected as an outlier
+static bool track_correct(tracker_t* tracker, track_t* track, const block_t* block, uint32_t time) {
+  float dt = elapsed_us(track->time, time) / 1e6f;
+
+  if (dt > 0) {
+    axis_predict(&track->x, dt, tracker->accel_var);
+    axis_predict(&track->y, dt, tracker->accel_var);
+    track->time = time;
+  }
+  float distance = axis_distance(&track->x, block->m_x, tracker->meas_var) +
+                   axis_distance(&track->y, block->m_y, tracker->meas_var);
+  if (distance > TRACKER_GATE) {
+    track->rejects++;
+    return false;
+  }
+  track->rejects = 0;
+  axis_correct(&track->x, block->m_x, tracker->meas_var);
+  axis_correct(&track->y, block->m_y, tracker->meas_var);
+  track->width += TRACKER_SIZE_GAIN * (block->m_width - track->width);
+  track->height += TRACKER_SIZE_GAIN * (block->m_height - track->height);
+  track->age = block->m_age;
+  return true;
+}
+
+void tracker_init(tracker_t* tracker, float accel_var, float meas_var) {
+  memset(tracker, 0, sizeof(tracker_t));
+  tracker->accel_var = accel_var;
+  tracker->meas_var = meas_var;
+}
+
+void tracker_update(tracker_t* tracker, const block_snapshot_t* snapshot) {
+  if (snapshot->frame == tracker->frame) {
+    return;
+  }
+  tracker->frame = snapshot->frame;
+
+  // forget objects that have been gone too long, their index may be reused
+  for (uint8_t i = 0; i < TRACKER_MAX_TRACKS; i++) {
+    track_t* track = &tracker->tracks[i];
+    if (track->active && elapsed_us(track->time, snapshot->time) > TRACKER_TIMEOUT_US) {
+      track->active = false;
+    }
+  }
+
+  for (int8_t b = 0; b < snapshot->numBlocks; b++) {
+    const block_t* block = &snapshot->blocks[b];
+    track_t* track = (track_t*)tracker_find(tracker, block->m_index);
+
+    // a different object under the same index, start over
+    if (track != NULL && track->signature != block->m_signature) {
+      track->active = false;
+      track = NULL;
+    }
+
+    if (track != NULL) {
+      // an object that kept jumping has really moved, follow it from here
+      if (!track_correct(tracker, track, block, snapshot->time) &&
+          track->rejects > TRACKER_MAX_REJECTS) {
+        track_start(tracker, track, block, snapshot->time);
+      }
+      continue;
+    }
+    for (uint8_t i = 0; i < TRACKER_MAX_TRACKS; i++) {
+      if (!tracker->tracks[i].active) {
+        track_start(tracker, &tracker->tracks[i], block, snapshot->time);
+        break;
+      }
+    }
+  }
+}
+
+const track_t* tracker_find(const tracker_t* tracker, uint8_t index) {
+  for (uint8_t i = 0; i < TRACKER_MAX_TRACKS; i++) {
+    const track_t* track = &tracker->tracks[i];
+    if (track->active && track->index == index) {
+      return track;
+    }
+  }
+  return NULL;
+}
+
+bool tracker_predict(const track_t* track, uint32_t time, track_estimate_t* estimate) {
+  int32_t dt_us = elapsed_us(track->time, time);
+
+  if (!track->active || dt_us > TRACKER_TIMEOUT_US) {
+    return false;
+  }
+  if (dt_us > TRACKER_MAX_PREDICT_US) {
+    dt_us = TRACKER_MAX_PREDICT_US;
+  } else if (dt_us < -TRACKER_MAX_PREDICT_US) {
+    dt_us = -TRACKER_MAX_PREDICT_US;
+  }
+
+  float dt = dt_us / 1e6f;
+  estimate->x = track->x.pos + track->x.vel * dt;
+  estimate->y = track->y.pos + track->y.vel * dt;
+  estimate->vx = track->x.vel;
+  estimate->vy = track->y.vel;
+  estimate->width = track->width;
+  estimate->height = track->height;
+  return true;
+}
@@ -0,0 +1,105 @@
+// Multi-object tracker for Pixy2 color connected components
+//
+// Follows blocks across camera frames by their Pixy tracking index and
+// filters each one with a constant velocity Kalman filter, so that the
+// position of a target can be predicted at any time between frames.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pixy2_spi.h"
+
+// Most objects tracked at once. Blocks beyond this are ignored until a slot
+// frees up.
+#define TRACKER_MAX_TRACKS 8
+
+// Drop a track once it has not been seen for this long (us)
+#define TRACKER_TIMEOUT_US 250000
+
+// Predictions are not extrapolated further than this past the last
+// measurement (us)
+#define TRACKER_MAX_PREDICT_US 100000
+
+// Uncertainty of the velocity of a new track, (pixels/s)^2
+#define TRACKER_INITIAL_VEL_VAR 90000.0f
+
+// Weight given to each new width and height measurement
+#define TRACKER_SIZE_GAIN 0.5f
+
+// A block further than this from its track's predicted position is rejected
+// as an outlier. The distance is the squared innovation over its variance,
+// summed over both axes.
+#define TRACKER_GATE 16.0f
+
+// After this many rejected blocks in a row the track restarts from the next
+// one, since the object really has moved
+#define TRACKER_MAX_REJECTS 3
+
+// Kalman filter for one axis, state is position and velocity
+typedef struct {
+  float pos;   // pixels
+  float vel;   // pixels/s
+  float p_pos; // covariance
+  float p_cov;
+  float p_vel;
+} tracker_axis_t;
+
+typedef struct {
+  bool active;
+  uint8_t index;      // Pixy tracking index
+  uint16_t signature;
+  uint8_t age;        // Pixy's age of the block at the last measurement
+  uint32_t time;      // time of the last measurement (us)
+  uint8_t rejects;    // outliers rejected in a row
+  tracker_axis_t x;
+  tracker_axis_t y;
+  float width;
+  float height;
+} track_t;
+
+// Filtered state of a track at a given time
+typedef struct {
+  float x;
+  float y;
+  float vx;
+  float vy;
+  float width;
+  float height;
+} track_estimate_t;
+
+typedef struct {
+  track_t tracks[TRACKER_MAX_TRACKS];
+  float accel_var; // process noise, (pixels/s^2)^2
+  float meas_var;  // measurement noise, pixels^2
+  uint32_t frame;  // last snapshot applied
+} tracker_t;
+
+// Initialize a tracker with no tracks
+//
+// accel_var - variance of the unmodelled acceleration of objects, (pixels/s^2)^2
+// meas_var - variance of the block positions reported by Pixy, pixels^2
+void tracker_init(tracker_t* tracker, float accel_var, float meas_var);
+
+// Update the tracks with the blocks of a new frame
+//
+// snapshot - as returned by pixy_blocks(), its time is used as the time of
+//  the measurements. A snapshot that was already applied is ignored.
+//
+// Blocks are matched to tracks by m_index. Tracks with no block in the frame
+// coast on their velocity until TRACKER_TIMEOUT_US passes without a match.
+// A block outside TRACKER_GATE of its track's prediction is ignored, unless
+// TRACKER_MAX_REJECTS were ignored before it.
+void tracker_update(tracker_t* tracker, const block_snapshot_t* snapshot);
+
+// Find the track following the block with the given Pixy index
+//
+// Returns NULL if there is no such track
+const track_t* tracker_find(const tracker_t* tracker, uint8_t index);
+
+// Predict the state of a track at time (us), which may be before or after
+// its last measurement
+//
+// Returns false if the track has timed out
+bool tracker_predict(const track_t* track, uint32_t time, track_estimate_t* estimate);
@@ -0,0 +1,20 @@
+// Host stand-in for the SDK's app_error.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_MODULE_ALREADY_INITIALIZED 133
+
+#define APP_ERROR_CHECK(err_code)                                        \
+  do {                                                                   \
+    if ((err_code) != NRF_SUCCESS) {                                     \
+      fprintf(stderr, "%s:%d: error %u\n", __FILE__, __LINE__, (unsigned)(err_code)); \
+      exit(1);                                                           \
+    }                                                                    \
+  } while (0)
@@ -0,0 +1,11 @@
+// Host stand-in for the SDK's app_util_platform.h
+//
+// The simulation runs interrupt handlers only between calls into the
+// library, so critical regions need do nothing.
+
+#pragma once
+
+#define APP_IRQ_PRIORITY_HIGH 2
+
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
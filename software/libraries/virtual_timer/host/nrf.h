@@ -0,0 +1,57 @@
+// Host stand-in for the SDK's nrf.h
+//
+// Just the RTC2 and TIMER4 registers the timer libraries use. Every use of
+// NRF_RTC2 or NRF_TIMER4 goes through the simulation in
+// virtual_timer_tool.c, which first acts on any task written since the last
+// use and brings the counters up to the simulated time, so the registers
+// behave in order as the hardware's do.
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t EVENTS_OVRFLW;
+  volatile uint32_t EVENTS_COMPARE[4];
+  volatile uint32_t INTENSET;
+  volatile uint32_t COUNTER;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[4];
+} NRF_RTC_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t TASKS_CAPTURE[6];
+  volatile uint32_t EVENTS_COMPARE[6];
+  volatile uint32_t INTENSET;
+  volatile uint32_t BITMODE;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[6];
+} NRF_TIMER_Type;
+
+#define RTC_INTENSET_OVRFLW_Msk (1UL << 1)
+#define RTC_INTENSET_COMPARE0_Msk (1UL << 16)
+#define TIMER_INTENSET_COMPARE0_Pos 16
+#define TIMER_INTENSET_COMPARE2_Pos 18
+
+typedef enum {
+  RTC2_IRQn,
+  TIMER4_IRQn,
+  SIM_IRQ_COUNT,
+} IRQn_Type;
+
+NRF_RTC_Type* sim_rtc2(void);
+NRF_TIMER_Type* sim_timer4(void);
+
+#define NRF_RTC2 (sim_rtc2())
+#define NRF_TIMER4 (sim_timer4())
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
@@ -0,0 +1,14 @@
+// Host stand-in for the SDK's nrf_drv_clock.h
+//
+// The simulated clocks are always running.
+
+#pragma once
+
+#include "app_error.h"
+
+static inline ret_code_t nrf_drv_clock_init(void) {
+  return NRF_SUCCESS;
+}
+
+static inline void nrf_drv_clock_lfclk_request(void* handler) {
+}
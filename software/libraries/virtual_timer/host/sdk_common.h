@@ -0,0 +1,10 @@
+// Host stand-in for the SDK's sdk_common.h
+//
+// The tool builds both timer libraries, as the board's app_config.h does.
+
+#pragma once
+
+#define NRF_MODULE_ENABLED(module) (module##_ENABLED)
+
+#define RTC_TIME_ENABLED 1
+#define VIRTUAL_TIMER_ENABLED 1
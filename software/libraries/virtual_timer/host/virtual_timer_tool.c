@@ -0,0 +1,717 @@
+// Host tool for virtual timers
+//
+// Builds on Linux from the same source as the robot, with RTC2 and TIMER4
+// simulated, to time the timer heap and to check the 64 bit timebase.
+//
+// usage: virtual_timer_tool bench
+//        virtual_timer_tool wrap
+//
+// bench times starting, cancelling and firing timers with 16 to 4000 of
+// them running, next to a sorted linked list like the lab's. wrap reads the
+// RTC as it overflows, then runs timers for 4400 simulated seconds, past
+// more overflows and the 32 bit wraps of the microsecond count and of
+// TIMER4, and checks that reads never go backwards and that no timer fires
+// early, late or not at all.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf.h"
+#include "rtc_time.h"
+#include "virtual_timer.h"
+
+void RTC2_IRQHandler(void);
+void TIMER4_IRQHandler(void);
+
+// Simulation
+
+// Simulated time is kept in units of 1/512 us, so that both a microsecond
+// and an RTC tick are a whole number of units
+#define UNITS_PER_US 512ULL
+#define UNITS_PER_TICK 15625ULL
+#define UNITS_PER_SECOND (1000000ULL * UNITS_PER_US)
+
+#define RTC_COUNTER_MASK 0xFFFFFFULL
+#define NEVER UINT64_MAX
+
+// time taken to enter an interrupt handler and return, so that a handler
+// waiting for the clock to move on sees it move
+#define UNITS_PER_IRQ UNITS_PER_US
+
+// a handler that keeps pending itself this often is a livelock
+#define MAX_IRQS_PER_RUN 100000
+
+static uint64_t now;
+// time that passes on each register access, to catch reads racing the clock
+static uint64_t access_step;
+
+static NRF_RTC_Type rtc;
+static bool rtc_running;
+static uint64_t rtc_base;  // time of tick 0 while running
+static uint64_t rtc_held;  // tick count while stopped
+static uint64_t rtc_seen;  // last tick events were raised for
+static uint32_t rtc_inten;
+static uint32_t rtc_cc;    // CC[0] as last seen
+static uint64_t rtc_cc_written;
+
+static NRF_TIMER_Type timer;
+static bool timer_running;
+static uint64_t timer_base;  // time of timer_held counts while running
+static uint64_t timer_held;
+static uint64_t timer_seen;
+static uint32_t timer_inten;
+
+static bool irq_enabled[SIM_IRQ_COUNT];
+static bool irq_pending[SIM_IRQ_COUNT];
+
+static uint64_t rtc_ticks_at(uint64_t t) {
+  return rtc_running ? (t - rtc_base) / UNITS_PER_TICK : rtc_held;
+}
+
+static uint64_t timer_count_at(uint64_t t) {
+  return timer_running ? timer_held + (t - timer_base) / UNITS_PER_US : timer_held;
+}
+
+// Writing N or N+1 to CC when the counter is N may not raise the compare
+// event, so the simulation never raises it
+static bool rtc_compare_suppressed(uint64_t tick) {
+  return tick == rtc_cc_written || tick == rtc_cc_written + 1;
+}
+
+static uint64_t rtc_next_event(void) {
+  if (!rtc_running) {
+    return NEVER;
+  }
+  uint64_t overflow = (rtc_seen | RTC_COUNTER_MASK) + 1;
+  uint64_t compare = (rtc_seen & ~RTC_COUNTER_MASK) | rtc_cc;
+  if (compare <= rtc_seen) {
+    compare += RTC_COUNTER_MASK + 1;
+  }
+  if (rtc_compare_suppressed(compare)) {
+    compare += RTC_COUNTER_MASK + 1;
+  }
+  uint64_t tick = overflow < compare ? overflow : compare;
+  return rtc_base + tick * UNITS_PER_TICK;
+}
+
+static uint64_t timer_next_event(void) {
+  if (!timer_running) {
+    return NEVER;
+  }
+  uint64_t next = NEVER;
+  for (uint8_t channel = 0; channel <= 2; channel += 2) {
+    uint64_t count = (timer_seen & ~0xFFFFFFFFULL) | timer.CC[channel];
+    if (count <= timer_seen) {
+      count += 1ULL << 32;
+    }
+    uint64_t t = timer_base + (count - timer_held) * UNITS_PER_US;
+    if (t < next) {
+      next = t;
+    }
+  }
+  return next;
+}
+
+// Interrupt lines stay asserted while an enabled event is set
+static void update_irqs(void) {
+  if ((rtc.EVENTS_OVRFLW && (rtc_inten & RTC_INTENSET_OVRFLW_Msk)) ||
+      (rtc.EVENTS_COMPARE[0] && (rtc_inten & RTC_INTENSET_COMPARE0_Msk))) {
+    irq_pending[RTC2_IRQn] = true;
+  }
+  if ((timer.EVENTS_COMPARE[0] && (timer_inten & (1 << TIMER_INTENSET_COMPARE0_Pos))) ||
+      (timer.EVENTS_COMPARE[2] && (timer_inten & (1 << TIMER_INTENSET_COMPARE2_Pos)))) {
+    irq_pending[TIMER4_IRQn] = true;
+  }
+}
+
+// Move time forward to t, raising events on the way but running no handlers
+static void sim_advance(uint64_t t) {
+  if (t < now) {
+    return;
+  }
+  while (true) {
+    uint64_t rtc_next = rtc_next_event();
+    uint64_t timer_next = timer_next_event();
+    uint64_t next = rtc_next < timer_next ? rtc_next : timer_next;
+    if (next > t) {
+      break;
+    }
+    now = next;
+
+    uint64_t tick = rtc_ticks_at(now);
+    if (rtc_running && tick > rtc_seen) {
+      rtc_seen = tick;
+      if ((tick & RTC_COUNTER_MASK) == 0) {
+        rtc.EVENTS_OVRFLW = 1;
+      }
+      if ((tick & RTC_COUNTER_MASK) == rtc_cc && !rtc_compare_suppressed(tick)) {
+        rtc.EVENTS_COMPARE[0] = 1;
+      }
+    }
+    uint64_t count = timer_count_at(now);
+    if (timer_running && count > timer_seen) {
+      timer_seen = count;
+      for (uint8_t channel = 0; channel <= 2; channel += 2) {
+        if ((uint32_t)count == timer.CC[channel]) {
+          timer.EVENTS_COMPARE[channel] = 1;
+        }
+      }
+    }
+    update_irqs();
+  }
+  now = t;
+  rtc_seen = rtc_ticks_at(now);
+  timer_seen = timer_count_at(now);
+}
+
+// Act on the registers written since the last access
+static void sim_sync(void) {
+  rtc_inten |= rtc.INTENSET;
+  if (rtc.TASKS_STOP) {
+    rtc.TASKS_STOP = 0;
+    rtc_held = rtc_ticks_at(now);
+    rtc_running = false;
+  }
+  if (rtc.TASKS_CLEAR) {
+    rtc.TASKS_CLEAR = 0;
+    rtc_held = 0;
+    rtc_base = now;
+    rtc_seen = 0;
+    rtc_cc_written = 0;
+  }
+  if (rtc.TASKS_START) {
+    rtc.TASKS_START = 0;
+    if (!rtc_running) {
+      rtc_base = now - rtc_held * UNITS_PER_TICK;
+      rtc_running = true;
+    }
+  }
+  if (rtc.CC[0] != rtc_cc) {
+    rtc_cc = rtc.CC[0] & RTC_COUNTER_MASK;
+    rtc_cc_written = rtc_ticks_at(now);
+  }
+  rtc.COUNTER = rtc_ticks_at(now) & RTC_COUNTER_MASK;
+
+  timer_inten |= timer.INTENSET;
+  if (timer.TASKS_STOP) {
+    timer.TASKS_STOP = 0;
+    timer_held = timer_count_at(now);
+    timer_running = false;
+  }
+  if (timer.TASKS_CLEAR) {
+    timer.TASKS_CLEAR = 0;
+    timer_held = 0;
+    timer_base = now;
+    timer_seen = 0;
+  }
+  if (timer.TASKS_START) {
+    timer.TASKS_START = 0;
+    if (!timer_running) {
+      timer_base = now;
+      timer_running = true;
+    }
+  }
+  if (timer.TASKS_CAPTURE[1]) {
+    timer.TASKS_CAPTURE[1] = 0;
+    timer.CC[1] = (uint32_t)timer_count_at(now);
+  }
+}
+
+static void sim_access(void) {
+  sim_sync();
+  if (access_step) {
+    sim_advance(now + access_step);
+    rtc.COUNTER = rtc_ticks_at(now) & RTC_COUNTER_MASK;
+  }
+}
+
+NRF_RTC_Type* sim_rtc2(void) {
+  sim_access();
+  return &rtc;
+}
+
+NRF_TIMER_Type* sim_timer4(void) {
+  sim_access();
+  return &timer;
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  irq_enabled[irq] = true;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+  irq_pending[irq] = true;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+  irq_pending[irq] = false;
+}
+
+// Run pending interrupt handlers until none are left
+static void sim_run_irqs(void) {
+  uint32_t runs = 0;
+  sim_sync();
+  while (true) {
+    // at equal priority the lower numbered interrupt, TIMER4, goes first
+    IRQn_Type irq;
+    if (irq_pending[TIMER4_IRQn] && irq_enabled[TIMER4_IRQn]) {
+      irq = TIMER4_IRQn;
+    } else if (irq_pending[RTC2_IRQn] && irq_enabled[RTC2_IRQn]) {
+      irq = RTC2_IRQn;
+    } else {
+      return;
+    }
+    if (++runs > MAX_IRQS_PER_RUN) {
+      fprintf(stderr, "interrupt livelock at %.6f s\n", (double)now / UNITS_PER_SECOND);
+      exit(1);
+    }
+    irq_pending[irq] = false;
+    sim_advance(now + UNITS_PER_IRQ);
+    if (irq == RTC2_IRQn) {
+      RTC2_IRQHandler();
+    } else {
+      TIMER4_IRQHandler();
+    }
+    sim_sync();
+    update_irqs();
+  }
+}
+
+// Run until time t, taking interrupts as they come
+static void sim_run_until(uint64_t t) {
+  while (true) {
+    sim_run_irqs();
+    uint64_t rtc_next = rtc_next_event();
+    uint64_t timer_next = timer_next_event();
+    uint64_t next = rtc_next < timer_next ? rtc_next : timer_next;
+    if (next > t) {
+      break;
+    }
+    sim_advance(next);
+  }
+  sim_advance(t);
+  sim_run_irqs();
+}
+
+// Bench
+
+// repeatable random numbers
+static uint64_t seed = 88172645463325252ULL;
+static uint32_t random_below(uint32_t limit) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (uint32_t)(seed % limit);
+}
+
+// The lab's sorted linked list, for comparison
+typedef struct list_node {
+  uint64_t deadline;
+  struct list_node* next;
+} list_node_t;
+
+static list_node_t* list_head;
+
+static list_node_t* list_insert_sorted(uint64_t deadline) {
+  list_node_t* node = malloc(sizeof(list_node_t));
+  node->deadline = deadline;
+  list_node_t** link = &list_head;
+  while (*link != NULL && (*link)->deadline <= deadline) {
+    link = &(*link)->next;
+  }
+  node->next = *link;
+  *link = node;
+  return node;
+}
+
+static void list_remove(list_node_t* node) {
+  list_node_t** link = &list_head;
+  while (*link != node) {
+    link = &(*link)->next;
+  }
+  *link = node->next;
+  free(node);
+}
+
+static double elapsed_ns(const struct timespec* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static uint32_t fired;
+static void count_fire(void) {
+  fired++;
+}
+
+static void nothing(void) {
+}
+
+#define BENCH_OPS 200000
+// timers longer than the bench, so none fire while it runs
+#define BENCH_MIN_US 1000000
+#define BENCH_SPAN_US 100000000
+
+static int bench(void) {
+  static const uint32_t sizes[] = {16, 256, 4000};
+  static uint32_t ids[4000];
+  static list_node_t* nodes[4000];
+
+  if (VIRTUAL_TIMER_POOL_SIZE < 4001) {
+    fprintf(stderr, "build with -DVIRTUAL_TIMER_POOL_SIZE=4096 to bench\n");
+    return 2;
+  }
+  virtual_timer_init();
+  sim_run_irqs();
+
+  printf("%6s  %22s  %22s  %10s\n", "timers", "start + cancel (ns)", "list insert + remove", "fire (ns)");
+  for (uint8_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    uint32_t n = sizes[s];
+
+    // n timers running, then starting and cancelling one more
+    for (uint32_t i = 0; i < n; i++) {
+      ids[i] = virtual_timer_start(BENCH_MIN_US + random_below(BENCH_SPAN_US), nothing);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+      uint32_t slot = random_below(n);
+      virtual_timer_cancel(ids[slot]);
+      ids[slot] = virtual_timer_start(BENCH_MIN_US + random_below(BENCH_SPAN_US), nothing);
+    }
+    double heap_ns = elapsed_ns(&start) / BENCH_OPS;
+    for (uint32_t i = 0; i < n; i++) {
+      virtual_timer_cancel(ids[i]);
+    }
+
+    // the same with the linked list
+    for (uint32_t i = 0; i < n; i++) {
+      nodes[i] = list_insert_sorted(BENCH_MIN_US + random_below(BENCH_SPAN_US));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+      uint32_t slot = random_below(n);
+      list_remove(nodes[slot]);
+      nodes[slot] = list_insert_sorted(BENCH_MIN_US + random_below(BENCH_SPAN_US));
+    }
+    double list_ns = elapsed_ns(&start) / BENCH_OPS;
+    for (uint32_t i = 0; i < n; i++) {
+      list_remove(nodes[i]);
+    }
+
+    // n timers due over the next second, run through the simulated RTC
+    fired = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      virtual_timer_start(BENCH_MIN_US / 1000 + random_below(BENCH_MIN_US), count_fire);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sim_run_until(now + 2 * UNITS_PER_SECOND);
+    double fire_ns = elapsed_ns(&start) / n;
+    if (fired != n) {
+      fprintf(stderr, "%u of %u timers fired\n", fired, n);
+      return 1;
+    }
+
+    printf("%6u  %22.0f  %22.0f  %10.0f\n", n, heap_ns, list_ns, fire_ns);
+  }
+  return 0;
+}
+
+// Wrap
+
+static uint32_t failures;
+
+static void expect(bool ok, const char* what) {
+  printf("  %-60s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+
+static uint64_t now_us(void) {
+  return now / UNITS_PER_US;
+}
+
+// RTC timers may fire up to a tick late, plus the time to enter the
+// interrupt handlers. Precise timers fire within a microsecond.
+#define COARSE_LATE_US 35
+#define PRECISE_EARLY_US 1
+#define PRECISE_LATE_US 3
+
+#define WRAP_RUN_US 4400000000ULL  // past 2^32 us and TIMER4's 2^32 counts
+
+static uint64_t last_read;
+static bool reads_monotonic = true;
+static bool reads_agree = true;
+static uint32_t early;
+static uint32_t late;
+static uint32_t max_late_us;
+
+// Every callback reads both clocks and checks them against the last read
+static uint64_t check_read(void) {
+  uint64_t read = read_timer64();
+  if (read < last_read) {
+    reads_monotonic = false;
+  }
+  if (read_timer() != (uint32_t)read) {
+    reads_agree = false;
+  }
+  last_read = read;
+  return read;
+}
+
+static void check_fire(int64_t late_us, int64_t early_limit_us, int64_t late_limit_us) {
+  if (late_us < -early_limit_us) {
+    early++;
+  }
+  if (late_us > late_limit_us) {
+    late++;
+  }
+  if (late_us > (int64_t)max_late_us) {
+    max_late_us = late_us;
+  }
+}
+
+// Repeated timers, checked against the deadlines they should keep to
+typedef struct {
+  const char* name;
+  uint32_t period_us;
+  uint64_t start;  // read_timer64() or, for precise timers, simulated time
+  uint64_t fires;
+} repeated_t;
+
+static repeated_t repeated[] = {
+  {"700 us, TIMER4", 700},
+  {"999 us, TIMER4", 999},
+  {"1000 us, RTC", 1000},
+  {"1 s, RTC", 1000000},
+  {"7.777777 s, RTC", 7777777},
+};
+
+static void fire_coarse(repeated_t* timer) {
+  uint64_t read = check_read();
+  timer->fires++;
+  check_fire((int64_t)(read - (timer->start + timer->fires * timer->period_us)), 0, COARSE_LATE_US);
+}
+
+static void fire_precise(repeated_t* timer) {
+  check_read();
+  timer->fires++;
+  uint64_t due = timer->start + timer->fires * timer->period_us * UNITS_PER_US;
+  check_fire(((int64_t)now - (int64_t)due) / (int64_t)UNITS_PER_US, PRECISE_EARLY_US, PRECISE_LATE_US);
+}
+
+static void fire_700(void) {
+  fire_precise(&repeated[0]);
+}
+
+static void fire_999(void) {
+  fire_precise(&repeated[1]);
+}
+
+static void fire_1000(void) {
+  fire_coarse(&repeated[2]);
+}
+
+static void fire_1s(void) {
+  fire_coarse(&repeated[3]);
+}
+
+static void fire_7s(void) {
+  fire_coarse(&repeated[4]);
+}
+
+static const virtual_timer_callback_t repeated_callbacks[] = {
+  fire_700, fire_999, fire_1000, fire_1s, fire_7s,
+};
+
+// One-shot timers due around each boundary, in the order they are due
+#define ONE_SHOTS 1024
+#define PRECISE_ONE_SHOT_US 500
+
+static const int32_t boundary_offsets_us[] = {-100, -31, -30, -1, 0, 1, 30, 31, 100};
+
+typedef struct {
+  uint64_t due[ONE_SHOTS];
+  uint32_t started;
+  uint32_t fired;
+} one_shots_t;
+
+static one_shots_t coarse_shots;
+static one_shots_t precise_shots;
+
+static void fire_coarse_shot(void) {
+  uint64_t read = check_read();
+  if (coarse_shots.fired < coarse_shots.started) {
+    check_fire((int64_t)(read - coarse_shots.due[coarse_shots.fired]), 0, COARSE_LATE_US);
+  }
+  coarse_shots.fired++;
+}
+
+static void fire_precise_shot(void) {
+  check_read();
+  if (precise_shots.fired < precise_shots.started) {
+    int64_t late_units = (int64_t)now - (int64_t)precise_shots.due[precise_shots.fired];
+    check_fire(late_units / (int64_t)UNITS_PER_US, PRECISE_EARLY_US, PRECISE_LATE_US);
+  }
+  precise_shots.fired++;
+}
+
+// Things to do part way through the run, in time order
+typedef struct {
+  uint64_t time;
+  uint64_t due_us;  // for coarse one-shots, when they are due
+} action_t;
+
+static action_t actions[ONE_SHOTS];
+static uint32_t action_count;
+
+static int by_time(const void* a, const void* b) {
+  const action_t* x = a;
+  const action_t* y = b;
+  return x->time < y->time ? -1 : x->time > y->time;
+}
+
+// Read the RTC at quarter ticks around an overflow with the clock moving a
+// third of a tick on every register access, so reads straddle the overflow
+// every way they can. With held set, the overflow interrupt waits until
+// the end, as it would behind a critical region or a higher priority
+// interrupt.
+static bool racing_reads(uint64_t overflow_tick, bool held) {
+  bool ok = true;
+  uint64_t previous = 0;
+  for (uint64_t t = (overflow_tick - 4) * UNITS_PER_TICK; t < (overflow_tick + 4) * UNITS_PER_TICK;
+       t += UNITS_PER_TICK / 4) {
+    if (held) {
+      sim_advance(t);
+    } else {
+      sim_run_until(t);
+    }
+    uint64_t before = rtc_ticks_at(now);
+    access_step = UNITS_PER_TICK / 3;
+    uint64_t ticks = rtc_time_ticks();
+    access_step = 0;
+    uint64_t after = rtc_ticks_at(now);
+    if (ticks < before || ticks > after || ticks < previous) {
+      printf("    read %llu between ticks %llu and %llu, after %llu\n", (unsigned long long)ticks,
+          (unsigned long long)before, (unsigned long long)after, (unsigned long long)previous);
+      ok = false;
+    }
+    previous = ticks;
+  }
+  sim_run_irqs();
+  return ok;
+}
+
+static int wrap(void) {
+  virtual_timer_init();
+  sim_run_irqs();
+
+  // reads racing the first two RTC overflows, before any timers start
+  printf("reads across RTC overflows\n");
+  expect(racing_reads(1ULL << 24, false), "race-free with the overflow interrupt taken");
+  expect(racing_reads(2ULL << 24, true), "race-free with the overflow interrupt held off");
+  expect(rtc_time_ticks() >> 24 == 2, "both overflows counted");
+
+  // repeated timers for the whole run
+  uint64_t start_us = now_us();
+  uint64_t end_us = start_us + WRAP_RUN_US;
+  for (uint8_t i = 0; i < sizeof(repeated) / sizeof(repeated[0]); i++) {
+    bool precise = repeated[i].period_us < VIRTUAL_TIMER_PRECISE_US;
+    repeated[i].start = precise ? now : read_timer64();
+    virtual_timer_start_repeated(repeated[i].period_us, repeated_callbacks[i]);
+    sim_run_irqs();
+  }
+  last_read = read_timer64();
+
+  // RTC one-shots due around each overflow and around 2^32 us, started 2 s
+  // ahead
+  uint64_t boundaries[16];
+  uint8_t boundary_count = 0;
+  for (uint64_t overflow = 3; overflow * 512000000 < end_us; overflow++) {
+    boundaries[boundary_count++] = overflow * 512000000;
+  }
+  boundaries[boundary_count++] = 1ULL << 32;
+  for (uint8_t b = 0; b < boundary_count; b++) {
+    for (uint8_t o = 0; o < sizeof(boundary_offsets_us) / sizeof(boundary_offsets_us[0]); o++) {
+      uint64_t due_us = boundaries[b] + boundary_offsets_us[o];
+      actions[action_count++] = (action_t){(due_us - 2000000) * UNITS_PER_US, due_us};
+    }
+  }
+  // TIMER4 one-shots every 37 us for a millisecond either side of the wrap
+  // of its count
+  uint64_t timer4_wrap = timer_base + ((1ULL << 32) - timer_held) * UNITS_PER_US;
+  for (uint64_t t = timer4_wrap - 1000 * UNITS_PER_US; t < timer4_wrap + 1000 * UNITS_PER_US; t += 37 * UNITS_PER_US) {
+    actions[action_count++] = (action_t){t, 0};
+  }
+  qsort(actions, action_count, sizeof(action_t), by_time);
+
+  printf("running %.0f simulated seconds\n", WRAP_RUN_US / 1e6);
+  for (uint32_t a = 0; a < action_count; a++) {
+    sim_run_until(actions[a].time);
+    if (actions[a].due_us) {
+      coarse_shots.due[coarse_shots.started++] = actions[a].due_us;
+      virtual_timer_start(actions[a].due_us - read_timer64(), fire_coarse_shot);
+    } else {
+      precise_shots.due[precise_shots.started++] = now + PRECISE_ONE_SHOT_US * UNITS_PER_US;
+      virtual_timer_start(PRECISE_ONE_SHOT_US, fire_precise_shot);
+    }
+    sim_run_irqs();
+  }
+  sim_run_until(end_us * UNITS_PER_US);
+  uint64_t end_read = read_timer64();
+
+  for (uint8_t i = 0; i < sizeof(repeated) / sizeof(repeated[0]); i++) {
+    bool precise = repeated[i].period_us < VIRTUAL_TIMER_PRECISE_US;
+    uint64_t elapsed_us = precise ? (now - repeated[i].start) / UNITS_PER_US : end_read - repeated[i].start;
+    uint64_t due = elapsed_us / repeated[i].period_us;
+    char what[64];
+    snprintf(what, sizeof(what), "%s fired %llu times", repeated[i].name, (unsigned long long)repeated[i].fires);
+    // the last may be due too recently to have fired
+    expect(repeated[i].fires == due || repeated[i].fires + 1 == due, what);
+  }
+  char what[64];
+  snprintf(what, sizeof(what), "%u one-shots around the boundaries each fired once", coarse_shots.started);
+  expect(coarse_shots.fired == coarse_shots.started, what);
+  snprintf(what, sizeof(what), "%u one-shots across the TIMER4 wrap each fired once", precise_shots.started);
+  expect(precise_shots.fired == precise_shots.started, what);
+  expect(early == 0, "no timer fired early");
+  snprintf(what, sizeof(what), "no timer fired late, latest by %u us", max_late_us);
+  expect(late == 0, what);
+  expect(reads_monotonic, "reads never went backwards");
+  expect(reads_agree, "read_timer() is the low half of read_timer64()");
+  expect(end_read > (1ULL << 32) && timer_seen > (1ULL << 32), "the run passed 2^32 us and 2^32 TIMER4 counts");
+
+  // TIMER4 only runs while precise timers do
+  virtual_timer_init();
+  sim_run_irqs();
+  expect(!timer_running, "TIMER4 stops with no precise timers");
+
+  printf("%u failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: virtual_timer_tool bench\n"
+                  "       virtual_timer_tool wrap\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return usage();
+  }
+  if (strcmp(argv[1], "bench") == 0) {
+    return bench();
+  }
+  if (strcmp(argv[1], "wrap") == 0) {
+    return wrap();
+  }
+  return usage();
+}
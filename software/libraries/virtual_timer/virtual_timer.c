@@ -0,0 +1,327 @@
+// Virtual timer implementation
+//
+// Each timer occupies a slot in a fixed pool. Running timers are kept in a
+// binary min-heap of slot numbers ordered by deadline, and every slot records
+// its position in the heap so it can be removed directly. Timer ids carry the
+// slot number and a generation count that changes whenever the slot is freed,
+// so a stale id can never cancel the timer that reused its slot.
+//
+// There are two heaps. Most timers go in the coarse heap, whose deadlines are
+// RTC microseconds and which fires from the RTC alarm, so waiting on them
+// keeps only the LFCLK running. Timers shorter than VIRTUAL_TIMER_PRECISE_US
+// go in the precise heap, which runs from TIMER4 at 1MHz. TIMER4 only runs
+// while the precise heap has timers in it. Its count is extended to 64 bits
+// each time it is read, and a compare event every half period makes sure it
+// is read often enough to never miss a wrap.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "sdk_common.h"
+
+#include "rtc_time.h"
+#include "virtual_timer.h"
+
+#if NRF_MODULE_ENABLED(VIRTUAL_TIMER)
+
+#if !NRF_MODULE_ENABLED(RTC_TIME)
+#error "virtual timers need RTC_TIME_ENABLED"
+#endif
+
+// heap position of a slot that isn't running
+#define NOT_QUEUED 0xFFFF
+
+// compare channel that keeps the extended TIMER4 count up to date
+#define WRAP_CHANNEL 2
+
+typedef struct {
+  uint64_t deadline;
+  uint32_t period; // 0 for one-shot timers
+  virtual_timer_callback_t callback;
+  uint16_t generation;
+  uint16_t position;
+  bool precise;
+} timer_slot_t;
+
+// min-heap of slot numbers
+typedef struct {
+  uint16_t items[VIRTUAL_TIMER_POOL_SIZE];
+  uint16_t size;
+} timer_heap_t;
+
+static timer_slot_t slots[VIRTUAL_TIMER_POOL_SIZE];
+
+static timer_heap_t coarse;
+static timer_heap_t precise;
+
+// stack of free slot numbers
+static uint16_t free_slots[VIRTUAL_TIMER_POOL_SIZE];
+static uint16_t free_count;
+
+// upper half of the 64 bit TIMER4 count, and the value it was last read with
+static uint32_t precise_high;
+static uint32_t precise_low;
+
+static bool earlier(uint16_t a, uint16_t b) {
+  return slots[a].deadline < slots[b].deadline;
+}
+
+static timer_heap_t* heap_of(uint16_t slot) {
+  return slots[slot].precise ? &precise : &coarse;
+}
+
+static void heap_set(timer_heap_t* heap, uint16_t position, uint16_t slot) {
+  heap->items[position] = slot;
+  slots[slot].position = position;
+}
+
+static void sift_up(timer_heap_t* heap, uint16_t position) {
+  uint16_t slot = heap->items[position];
+  while (position > 0) {
+    uint16_t parent = (position - 1) / 2;
+    if (!earlier(slot, heap->items[parent])) {
+      break;
+    }
+    heap_set(heap, position, heap->items[parent]);
+    position = parent;
+  }
+  heap_set(heap, position, slot);
+}
+
+static void sift_down(timer_heap_t* heap, uint16_t position) {
+  uint16_t slot = heap->items[position];
+  while (true) {
+    uint16_t child = 2 * position + 1;
+    if (child >= heap->size) {
+      break;
+    }
+    if (child + 1 < heap->size && earlier(heap->items[child + 1], heap->items[child])) {
+      child++;
+    }
+    if (!earlier(heap->items[child], slot)) {
+      break;
+    }
+    heap_set(heap, position, heap->items[child]);
+    position = child;
+  }
+  heap_set(heap, position, slot);
+}
+
+static void heap_push(timer_heap_t* heap, uint16_t slot) {
+  heap_set(heap, heap->size++, slot);
+  sift_up(heap, slots[slot].position);
+}
+
+static void heap_remove(timer_heap_t* heap, uint16_t position) {
+  uint16_t last = heap->items[--heap->size];
+  if (position < heap->size) {
+    heap_set(heap, position, last);
+    sift_up(heap, position);
+    sift_down(heap, slots[last].position);
+  }
+}
+
+static void slot_free(uint16_t slot) {
+  slots[slot].position = NOT_QUEUED;
+  // 0 is never a valid generation, so no id is ever VIRTUAL_TIMER_INVALID
+  if (++slots[slot].generation == 0) {
+    slots[slot].generation = 1;
+  }
+  free_slots[free_count++] = slot;
+}
+
+// Look up the slot of a running timer, or return NOT_QUEUED
+static uint16_t slot_find(uint32_t timer_id) {
+  uint16_t slot = timer_id & 0xFFFF;
+  if (slot >= VIRTUAL_TIMER_POOL_SIZE ||
+      slots[slot].generation != (timer_id >> 16) ||
+      slots[slot].position == NOT_QUEUED) {
+    return NOT_QUEUED;
+  }
+  return slot;
+}
+
+// TIMER4 count extended to 64 bits, call with interrupts disabled
+static uint64_t precise_now(void) {
+  NRF_TIMER4->TASKS_CAPTURE[1] = 1;
+  uint32_t low = NRF_TIMER4->CC[1];
+  if (low < precise_low) {
+    precise_high++;
+  }
+  precise_low = low;
+  return ((uint64_t)precise_high << 32) | low;
+}
+
+static uint64_t heap_now(const timer_heap_t* heap) {
+  return heap == &precise ? precise_now() : rtc_time_us();
+}
+
+static void dispatch(timer_heap_t* heap);
+
+static void coarse_alarm_handler(void) {
+  dispatch(&coarse);
+}
+
+// Arrange for the earliest deadline in a heap to be caught. An empty coarse
+// heap cancels the RTC alarm and an empty precise heap stops TIMER4.
+static void schedule(timer_heap_t* heap) {
+  if (heap == &coarse) {
+    if (heap->size == 0) {
+      rtc_time_cancel_alarm();
+    } else {
+      // round up to the next tick so the alarm is never early
+      uint64_t deadline = slots[heap->items[0]].deadline;
+      rtc_time_set_alarm(rtc_time_us_to_ticks(deadline), coarse_alarm_handler);
+    }
+    return;
+  }
+
+  if (heap->size == 0) {
+    NRF_TIMER4->TASKS_STOP = 1;
+    return;
+  }
+  // deadlines more than a counter period away match early, which just runs
+  // the handler once more to find nothing has expired. If the deadline has
+  // already gone by, the compare event would not happen until the counter
+  // wraps, so pend the interrupt instead.
+  uint64_t deadline = slots[heap->items[0]].deadline;
+  NRF_TIMER4->CC[0] = (uint32_t)deadline;
+  if (precise_now() >= deadline) {
+    NVIC_SetPendingIRQ(TIMER4_IRQn);
+  }
+}
+
+// Run the callbacks of every expired timer in a heap
+//
+// Expired timers are taken off the heap one at a time with interrupts
+// disabled, and their callbacks run with interrupts enabled, so a slow
+// callback doesn't hold off other interrupts and may itself start or cancel
+// timers.
+static void dispatch(timer_heap_t* heap) {
+  while (true) {
+    virtual_timer_callback_t callback = NULL;
+
+    CRITICAL_REGION_ENTER();
+    if (heap->size > 0 && heap_now(heap) >= slots[heap->items[0]].deadline) {
+      uint16_t slot = heap->items[0];
+      callback = slots[slot].callback;
+      if (slots[slot].period) {
+        slots[slot].deadline += slots[slot].period;
+        sift_down(heap, 0);
+      } else {
+        heap_remove(heap, 0);
+        slot_free(slot);
+      }
+    } else {
+      schedule(heap);
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (callback == NULL) {
+      break;
+    }
+    callback();
+  }
+}
+
+// This is the interrupt handler that fires on a compare event
+void TIMER4_IRQHandler(void) {
+  // This should always be the first line of the interrupt handler!
+  // It clears the event so that it doesn't happen again
+  NRF_TIMER4->EVENTS_COMPARE[0] = 0;
+
+  if (NRF_TIMER4->EVENTS_COMPARE[WRAP_CHANNEL]) {
+    NRF_TIMER4->EVENTS_COMPARE[WRAP_CHANNEL] = 0;
+    NRF_TIMER4->CC[WRAP_CHANNEL] ^= 0x80000000;
+    CRITICAL_REGION_ENTER();
+    precise_now();
+    CRITICAL_REGION_EXIT();
+  }
+
+  dispatch(&precise);
+}
+
+uint32_t read_timer(void) {
+  return (uint32_t)rtc_time_us();
+}
+
+uint64_t read_timer64(void) {
+  return rtc_time_us();
+}
+
+// Start the RTC timebase, set up TIMER4 as a 32 bit timer counting at 1MHz
+// for precise timers, and fill the free slot pool
+void virtual_timer_init(void) {
+  coarse.size = 0;
+  precise.size = 0;
+  free_count = 0;
+  for (uint16_t slot = VIRTUAL_TIMER_POOL_SIZE; slot > 0; slot--) {
+    slots[slot - 1].generation = 0;
+    slot_free(slot - 1);
+  }
+
+  ret_code_t error_code = rtc_time_init();
+  APP_ERROR_CHECK(error_code);
+
+  precise_high = 0;
+  precise_low = 0;
+  NRF_TIMER4->TASKS_STOP = 1;
+  NRF_TIMER4->PRESCALER = 4;
+  NRF_TIMER4->BITMODE = 3;
+  NRF_TIMER4->CC[WRAP_CHANNEL] = 0x80000000;
+  NRF_TIMER4->INTENSET = (1 << TIMER_INTENSET_COMPARE0_Pos) | (1 << TIMER_INTENSET_COMPARE2_Pos);
+  NRF_TIMER4->TASKS_CLEAR = 1;
+
+  NVIC_SetPriority(TIMER4_IRQn, APP_IRQ_PRIORITY_HIGH);
+  NVIC_EnableIRQ(TIMER4_IRQn);
+}
+
+// Start a timer. This function is called for both one-shot and repeated timers
+static uint32_t timer_start(uint32_t microseconds, virtual_timer_callback_t cb, bool repeated) {
+  uint32_t timer_id = VIRTUAL_TIMER_INVALID;
+
+  CRITICAL_REGION_ENTER();
+  if (free_count > 0) {
+    uint16_t slot = free_slots[--free_count];
+    slots[slot].precise = microseconds < VIRTUAL_TIMER_PRECISE_US;
+    timer_heap_t* heap = heap_of(slot);
+    if (heap == &precise && heap->size == 0) {
+      NRF_TIMER4->TASKS_START = 1;
+    }
+    slots[slot].deadline = heap_now(heap) + microseconds;
+    slots[slot].period = repeated ? microseconds : 0;
+    slots[slot].callback = cb;
+    heap_push(heap, slot);
+    schedule(heap);
+    timer_id = ((uint32_t)slots[slot].generation << 16) | slot;
+  }
+  CRITICAL_REGION_EXIT();
+
+  return timer_id;
+}
+
+uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, cb, false);
+}
+
+uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb) {
+  return timer_start(microseconds, cb, true);
+}
+
+void virtual_timer_cancel(uint32_t timer_id) {
+  CRITICAL_REGION_ENTER();
+  uint16_t slot = slot_find(timer_id);
+  if (slot != NOT_QUEUED) {
+    timer_heap_t* heap = heap_of(slot);
+    heap_remove(heap, slots[slot].position);
+    slot_free(slot);
+    schedule(heap);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+#endif // NRF_MODULE_ENABLED(VIRTUAL_TIMER)
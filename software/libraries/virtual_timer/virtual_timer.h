@@ -0,0 +1,66 @@
+// Virtual timers
+//
+// Provides many software timers from the low power RTC timebase (rtc_time).
+// Timers live in a fixed pool and are ordered in a binary min-heap, so
+// starting, cancelling and firing a timer are all O(log n) with no heap
+// allocation.
+//
+// RTC timers fire to within a 30.5 us tick. Timers with an interval below
+// VIRTUAL_TIMER_PRECISE_US run from TIMER4 at 1MHz instead, which keeps the
+// high frequency clock on only while such timers exist.
+//
+// Compiled in when VIRTUAL_TIMER_ENABLED is set in the board's app_config.h,
+// and needs RTC_TIME_ENABLED too. It defines TIMER4_IRQHandler. The
+// schedulers call it, so the board leaves it on.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Most timers running at once
+#ifndef VIRTUAL_TIMER_POOL_SIZE
+#define VIRTUAL_TIMER_POOL_SIZE 32
+#endif
+
+// Timers with a shorter interval than this use TIMER4 (us)
+#ifndef VIRTUAL_TIMER_PRECISE_US
+#define VIRTUAL_TIMER_PRECISE_US 1000
+#endif
+
+// Never returned as a timer id
+#define VIRTUAL_TIMER_INVALID 0
+
+// Type for the function pointer to call when the timer expires
+typedef void (*virtual_timer_callback_t)(void);
+
+// Read the microseconds since virtual_timer_init() as a 32 bit value, which
+// wraps every 71.6 minutes
+uint32_t read_timer(void);
+
+// Read the microseconds since virtual_timer_init() as a 64 bit value that
+// never wraps
+//
+// Safe to call from interrupt handlers and the main loop, and meant for
+// timestamping samples as well as timer deadlines. Reads come from the RTC,
+// so they step in 30.5 us ticks, while timers shorter than
+// VIRTUAL_TIMER_PRECISE_US still fire to the microsecond.
+uint64_t read_timer64(void);
+
+// Start the RTC timebase and set up TIMER4
+void virtual_timer_init(void);
+
+// Start a one-shot timer that calls <cb> <microseconds> in the future
+// Returns a unique timer_id, or VIRTUAL_TIMER_INVALID if the pool is full
+uint32_t virtual_timer_start(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Start timer that repeatedly calls <cb> <microseconds> in the future
+// Returns a unique timer_id, or VIRTUAL_TIMER_INVALID if the pool is full
+uint32_t virtual_timer_start_repeated(uint32_t microseconds, virtual_timer_callback_t cb);
+
+// Takes a timer_id and cancels that timer such that it stops firing
+//
+// Ids of timers that already fired or were cancelled are ignored, even if
+// their pool slot has since been reused
+void virtual_timer_cancel(uint32_t timer_id);